@@ -0,0 +1,82 @@
+#include <hayai.hpp>
+
+#include <symbolic.h>
+
+#include <memory>
+#include <string>
+
+// Construction + destruction cost of large derivate() outputs.
+// Build twice to compare the reference count policies:
+//      cmake -DSYM_ATOMIC_REFCOUNT=ON  ..   (thread safe)
+//      cmake -DSYM_ATOMIC_REFCOUNT=OFF ..   (single threaded graphs)
+// The SharedPtr benchmarks replicate the previous std::shared_ptr based nodes.
+
+// f = (x * (x * (x * ... (x + c))))
+static sym::Expr make_chain(int depth){
+    auto x = sym::make_var("x");
+    sym::Expr f = sym::add(x, sym::make_val(1));
+
+    for (int i = 0; i < depth; ++i){
+        f = sym::mult(x, sym::add(f, sym::make_val(i)));
+    }
+    return f;
+}
+
+class DerivateBench: public ::hayai::Fixture
+{
+public:
+    virtual void SetUp() {
+        f = make_chain(256);
+    }
+
+    virtual void TearDown(){
+        f = nullptr;
+    }
+
+    sym::Expr f;
+};
+
+BENCHMARK_F(DerivateBench, Derivate, 10, 100)
+{
+    sym::Expr d = f->derivate("x");
+}
+
+BENCHMARK_F(DerivateBench, DerivateTwice, 10, 20)
+{
+    sym::Expr d = f->derivate("x")->derivate("x");
+}
+
+
+// Same tree shape with std::shared_ptr nodes allocated one by one
+struct SharedNode{
+    SharedNode(std::shared_ptr<SharedNode> l, std::shared_ptr<SharedNode> r):
+        lhs(l), rhs(r)
+    {}
+
+    std::shared_ptr<SharedNode> lhs;
+    std::shared_ptr<SharedNode> rhs;
+};
+
+static std::shared_ptr<SharedNode> shared_tree(int depth){
+    if (depth == 0)
+        return std::shared_ptr<SharedNode>(new SharedNode(nullptr, nullptr));
+
+    return std::shared_ptr<SharedNode>(new SharedNode(shared_tree(depth - 1), shared_tree(depth - 1)));
+}
+
+static sym::Expr intrusive_tree(int depth){
+    if (depth == 0)
+        return sym::make_val(depth);
+
+    return sym::Add::make(intrusive_tree(depth - 1), intrusive_tree(depth - 1));
+}
+
+BENCHMARK(Tree, SharedPtr, 10, 100)
+{
+    shared_tree(14);
+}
+
+BENCHMARK(Tree, Intrusive, 10, 100)
+{
+    intrusive_tree(14);
+}
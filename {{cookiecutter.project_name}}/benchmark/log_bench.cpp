@@ -0,0 +1,133 @@
+#include <hayai.hpp>
+
+// Before logger.h, its macros would rename the spdlog methods
+#include <spdlog/spdlog.h>
+
+#include <logger.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Formatting cost of one log message.
+// Legacy replicates the previous path: the message and the prefix are formatted
+// separately into two std::string. SinglePass is the formatting done by sym::log.
+// Binary is a complete log call with deferred formatting, formatted later by log_decode.
+// Recorded is a call filtered out by the log level, only written to the flight recorder.
+// Suppressed is a call dropped by the rate limit of its site during a log storm.
+
+static const sym::CodeLocation location = LOC;
+
+static std::string legacy_format(sym::CodeLocation const& loc, const char* fmt, int a, double b, const char* c){
+    return fmt::format("{}:{} {} - {}",
+                       loc.filename,
+                       loc.line,
+                       loc.function_name,
+                       fmt::format(fmt, a, b, c));
+}
+
+BENCHMARK(Log, Legacy, 10, 100000)
+{
+    std::string msg = legacy_format(location, "frame {} took {} ms ({})", 42, 16.6, "swapchain");
+    (void) msg;
+}
+
+BENCHMARK(Log, SinglePass, 10, 100000)
+{
+    fmt::string_view msg = sym::format_log(location, "frame {} took {} ms ({})", fmt::make_format_args(42, 16.6, "swapchain"));
+    (void) msg;
+}
+
+class BinaryLog: public ::hayai::Fixture
+{
+public:
+    void SetUp() override {
+        sym::enable_binary_logging("log_bench.binlog");
+    }
+
+    void TearDown() override {
+        sym::disable_binary_logging();
+    }
+};
+
+BENCHMARK_F(BinaryLog, Binary, 10, 100000)
+{
+    info("frame {} took {} ms ({})", 42, 16.6, "swapchain");
+}
+
+class FlightRecorder: public ::hayai::Fixture
+{
+public:
+    void SetUp() override {
+        sym::set_log_level(sym::LogLevel::OFF);
+    }
+
+    void TearDown() override {
+        sym::set_log_level(sym::LogLevel::TRACE);
+    }
+};
+
+BENCHMARK_F(FlightRecorder, Recorded, 10, 100000)
+{
+    warn("frame {} took {} ms ({})", 42, 16.6, "swapchain");
+}
+
+BENCHMARK(Log, Suppressed, 10, 100000)
+{
+    SYM_LOG_PER_SECOND(WARN, 1, "frame {} took {} ms ({})", 42, 16.6, "swapchain");
+}
+
+// Scaling of the log path with the number of logging threads. The root logger is turned
+// off so only the logger lookup and the spdlog level check are measured.
+// SharedHandle replicates the previous root(): a static shared_ptr returned by value,
+// two atomic reference count updates per call on a cache line shared by every thread.
+// Root is sym::spdlog_log, which uses a raw pointer cached per thread.
+
+static std::shared_ptr<spdlog::logger> shared_handle(){
+    static std::shared_ptr<spdlog::logger> log = spdlog::get("root");
+    return log;
+}
+
+template<typename Fun>
+static void run_threads(int n, Fun fun){
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n; ++t){
+        threads.emplace_back([&fun](){
+            for (int i = 0; i < 100000; ++i){
+                fun();
+            }
+        });
+    }
+    for (auto& thread: threads){
+        thread.join();
+    }
+}
+
+class RootOff: public ::hayai::Fixture
+{
+public:
+    void SetUp() override {
+        sym::flush_log();   // creates the root logger
+        spdlog::get("root")->set_level(spdlog::level::off);
+    }
+
+    void TearDown() override {
+        spdlog::get("root")->set_level(spdlog::level::trace);
+    }
+};
+
+static void shared_handle_log(){
+    shared_handle()->log(spdlog::level::info, "frame");
+}
+
+static void root_log(){
+    sym::spdlog_log(sym::LogLevel::INFO, "frame");
+}
+
+BENCHMARK_F(RootOff, SharedHandle1Thread, 10, 1)  { run_threads(1, shared_handle_log); }
+BENCHMARK_F(RootOff, SharedHandle4Threads, 10, 1) { run_threads(4, shared_handle_log); }
+BENCHMARK_F(RootOff, SharedHandle8Threads, 10, 1) { run_threads(8, shared_handle_log); }
+BENCHMARK_F(RootOff, Root1Thread, 10, 1)          { run_threads(1, root_log); }
+BENCHMARK_F(RootOff, Root4Threads, 10, 1)         { run_threads(4, root_log); }
+BENCHMARK_F(RootOff, Root8Threads, 10, 1)         { run_threads(8, root_log); }
@@ -0,0 +1,52 @@
+
+
+#include <hayai.hpp>
+
+#include <symbolic.h>
+#include <printer.h>
+
+#include <sstream>
+#include <string>
+
+// Dump of a large expression: ABSExpr::gen through a std::stringstream
+// against sym::print into a reused buffer
+
+class PrintBench: public ::hayai::Fixture
+{
+public:
+    virtual void SetUp() {
+        auto x = sym::make_var("x");
+        auto y = sym::make_var("y");
+        f = sym::add(x, sym::make_val(0.1));
+
+        for (int i = 0; i < 2000; ++i){
+            f = sym::add(sym::mult(f, y), sym::make_val(i * 0.37));
+        }
+        buffer.reserve(1 << 16);
+    }
+
+    virtual void TearDown(){
+        f = nullptr;
+    }
+
+    sym::Expr f;
+    std::string buffer;
+};
+
+BENCHMARK_F(PrintBench, Gen, 10, 100)
+{
+    std::stringstream ss;
+    f->gen(ss);
+}
+
+BENCHMARK_F(PrintBench, Infix, 10, 100)
+{
+    buffer.clear();
+    sym::print(buffer, f);
+}
+
+BENCHMARK_F(PrintBench, C, 10, 100)
+{
+    buffer.clear();
+    sym::print(buffer, f, sym::PrintStyle::C);
+}
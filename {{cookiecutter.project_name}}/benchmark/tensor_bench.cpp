@@ -0,0 +1,80 @@
+
+
+#include <hayai.hpp>
+
+#include <symbolic.h>
+#include <tensor.h>
+
+// Dense 256 x 256 product:
+//  - Blocked:      sym::matmul kernel
+//  - Naive:        i, j, p loops, b is walked column wise
+//  - Scalarized:   the same product as one Add/Mult graph per output element
+
+static const std::size_t n = 256;
+
+class MatMulBench: public ::hayai::Fixture
+{
+public:
+    virtual void SetUp() {
+        a = sym::Tensor(n, n, 0.5);
+        b = sym::Tensor(n, n, 2.0);
+
+        ctx = {
+            {"A", sym::make_tensor(a)},
+            {"B", sym::make_tensor(b)}
+        };
+        f = sym::sum(sym::matmul(sym::make_tensor_var("A", n, n), sym::make_tensor_var("B", n, n)));
+    }
+
+    virtual void TearDown(){
+        f = nullptr;
+        ctx.clear();
+    }
+
+    sym::Tensor a;
+    sym::Tensor b;
+    sym::Context ctx;
+    sym::Expr f;
+};
+
+BENCHMARK_F(MatMulBench, Blocked, 10, 10)
+{
+    sym::Tensor c = sym::matmul(a, b);
+}
+
+BENCHMARK_F(MatMulBench, Naive, 10, 10)
+{
+    sym::Tensor c(n, n);
+    for (std::size_t i = 0; i < n; ++i){
+        for (std::size_t j = 0; j < n; ++j){
+            double acc = 0;
+            for (std::size_t p = 0; p < n; ++p){
+                acc += a(i, p) * b(p, j);
+            }
+            c(i, j) = acc;
+        }
+    }
+}
+
+BENCHMARK_F(MatMulBench, Expression, 10, 10)
+{
+    (void) f->full_eval(ctx);
+}
+
+// One row of the product as scalar nodes, n times smaller than the others
+BENCHMARK_F(MatMulBench, ScalarizedRow, 10, 10)
+{
+    sym::Context scalars;
+    for (std::size_t p = 0; p < n; ++p){
+        scalars["a" + std::to_string(p)] = sym::make_val(a(0, p));
+        scalars["b" + std::to_string(p)] = sym::make_val(b(p, 0));
+    }
+
+    for (std::size_t j = 0; j < n; ++j){
+        sym::Expr e = sym::make_val(0);
+        for (std::size_t p = 0; p < n; ++p){
+            e = sym::add(e, sym::mult(sym::make_var("a" + std::to_string(p)), sym::make_var("b" + std::to_string(p))));
+        }
+        (void) e->full_eval(scalars);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef PROJECT_TEST_TESTS_BACKTRACE_HEADER
+#define PROJECT_TEST_TESTS_BACKTRACE_HEADER
+
+#include <gtest/gtest.h>
+
+#include <backtrace.h>
+#include <logger.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <dlfcn.h>
+
+NEW_EXCEPTION(RetryError)
+
+__attribute__((noinline)) static sym::StackTrace capture_here(){
+    return sym::capture_stack_trace();
+}
+
+TEST(backtrace, capture_then_symbolize)
+{
+    sym::StackTrace trace = capture_here();
+    ASSERT_GT(trace.size, 2u);
+    ASSERT_LE(trace.size, sym::StackTrace::capacity);
+
+    std::string text = sym::format_stack_trace(trace);
+    EXPECT_EQ(0u, text.find("#0  0x")) << text;
+    EXPECT_NE(std::string::npos, text.find("libc.so")) << text;
+
+    // Resolved once
+    std::size_t cached = sym::symbol_cache_size();
+    EXPECT_EQ(text, sym::format_stack_trace(trace));
+    EXPECT_EQ(cached, sym::symbol_cache_size());
+}
+
+TEST(backtrace, symbolize_demangles)
+{
+    void* terminate = dlsym(RTLD_DEFAULT, "_ZSt9terminatev");
+    ASSERT_NE(nullptr, terminate);
+
+    std::string name = sym::symbolize(static_cast<char*>(terminate) + 4);
+    EXPECT_EQ(0u, name.find("std::terminate()+0x4 (libstdc++")) << name;
+}
+
+TEST(backtrace, line_info)
+{
+    if (std::system("addr2line --version > /dev/null 2>&1") != 0){
+        std::cout << "addr2line not found, line info is not tested" << std::endl;
+        return;
+    }
+
+    // Functions of the test executable are not exported, dladdr cannot name them
+    sym::enable_line_info(true);
+    sym::StackTrace trace = capture_here();
+    std::string name = sym::symbolize(trace.frames[0]);
+    sym::enable_line_info(false);
+
+    EXPECT_NE(std::string::npos, name.find("capture_here()")) << name;
+}
+
+TEST(backtrace, exception_owns_its_message)
+{
+    RetryError failure("attempt {} of {}", 3, "solve");
+    EXPECT_GT(failure.trace().size, 0u);
+
+    RetryError copy = failure;
+    EXPECT_STREQ("attempt 3 of solve", copy.what());
+
+    // The backtrace is shown by the first call only
+    testing::internal::CaptureStdout();
+    EXPECT_STREQ("attempt 3 of solve", failure.what());
+    EXPECT_STREQ("attempt 3 of solve", failure.what());
+    std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(std::string::npos, out.find("#0 "));
+    EXPECT_EQ(out.find("#0 "), out.rfind("#0 ")) << out;
+}
+
+#endif
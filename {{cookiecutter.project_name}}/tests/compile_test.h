@@ -0,0 +1,192 @@
+#ifndef PROJECT_TEST_TESTS_COMPILE_HEADER
+#define PROJECT_TEST_TESTS_COMPILE_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <compile.h>
+#include <dataset.h>
+#include <thread_pool.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "temp_path.h"
+
+TEST(compile, eval)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto s = sym::add(x, y);
+    auto f = sym::mult(sym::mult(s, s), sym::make_val(2));
+
+    auto prog = sym::compile(f, {"x", "y"});
+    double point[] = {2, 3};
+
+    sym::Context ctx = {{"x", sym::make_val(2)}, {"y", sym::make_val(3)}};
+    EXPECT_DOUBLE_EQ(f->full_eval(ctx), prog.eval(point));
+}
+
+TEST(compile, missing_input)
+{
+    auto f = sym::add(sym::make_var("x"), sym::make_var("z"));
+    EXPECT_THROW(sym::compile(f, {"x"}), std::out_of_range);
+}
+
+TEST(compile, batch)
+{
+    auto x = sym::make_var("x");
+    auto f = sym::add(sym::mult(x, x), sym::make_val(1));
+    auto prog = sym::compile(f, {"x"});
+
+    std::vector<double> xs(1000);
+    std::vector<double> out(1000);
+    for (std::size_t i = 0; i < xs.size(); ++i){
+        xs[i] = double(i) * 0.5;
+    }
+
+    const double* columns[] = {xs.data()};
+    prog.eval(columns, out.data(), xs.size());
+
+    for (std::size_t i = 0; i < xs.size(); ++i){
+        EXPECT_DOUBLE_EQ(xs[i] * xs[i] + 1, out[i]);
+    }
+}
+
+inline int count_op(sym::Program const& prog, sym::Program::Op op){
+    int n = 0;
+    for (auto& instr: prog.code()){
+        n += instr.op == op;
+    }
+    return n;
+}
+
+TEST(compile, fma_contraction)
+{
+    auto a = sym::make_var("a");
+    auto b = sym::make_var("b");
+    auto c = sym::make_var("c");
+
+    // a * b + (b * c + a)
+    auto f = sym::add(sym::mult(a, b), sym::add(sym::mult(b, c), a));
+
+    sym::CompileOptions options;
+    options.contract_fma = true;
+
+    auto prog = sym::compile(f, {"a", "b", "c"}, options);
+    EXPECT_EQ(2, count_op(prog, sym::Program::Op::Fma));
+    EXPECT_EQ(0, count_op(prog, sym::Program::Op::Mult));
+
+    double point[] = {0.1, 0.2, 0.3};
+    EXPECT_DOUBLE_EQ(0.1 * 0.2 + 0.2 * 0.3 + 0.1, prog.eval(point));
+
+    std::vector<double> as(300, 0.1), bs(300, 0.2), cs(300, 0.3), out(300);
+    const double* columns[] = {as.data(), bs.data(), cs.data()};
+    prog.eval(columns, out.data(), out.size());
+    EXPECT_EQ(prog.eval(point), out[299]);
+}
+
+TEST(compile, fma_shared_product_is_kept)
+{
+    auto a = sym::make_var("a");
+    auto p = sym::mult(a, a);
+    auto f = sym::mult(sym::add(p, a), p);
+
+    sym::CompileOptions options;
+    options.contract_fma = true;
+
+    auto prog = sym::compile(f, {"a"}, options);
+    EXPECT_EQ(0, count_op(prog, sym::Program::Op::Fma));
+}
+
+TEST(compile, fma_opt_out_is_bitwise_identical)
+{
+    auto a = sym::make_var("a");
+    auto b = sym::make_var("b");
+    auto f = sym::add(sym::mult(a, b), sym::make_val(-1));
+
+    sym::CompileOptions options;
+    options.contract_fma = false;
+
+    auto prog = sym::compile(f, {"a", "b"}, options);
+    EXPECT_EQ(0, count_op(prog, sym::Program::Op::Fma));
+
+    double point[] = {1.0 / 3.0, 3.0};
+    sym::Context ctx = {{"a", sym::make_val(point[0])}, {"b", sym::make_val(point[1])}};
+    EXPECT_EQ(f->full_eval(ctx), prog.eval(point));
+}
+
+TEST(eval_file, chunks)
+{
+    std::string in_path = temp_path("sym_eval_file_in.bin");
+    std::string out_path = temp_path("sym_eval_file_out.bin");
+
+    std::size_t rows = 10000;
+    std::vector<double> xs(rows), ys(rows);
+    for (std::size_t i = 0; i < rows; ++i){
+        xs[i] = double(i);
+        ys[i] = double(rows - i);
+    }
+    sym::write_columns(in_path, {"x", "y"}, {xs.data(), ys.data()}, rows);
+
+    auto f = sym::add(sym::mult(sym::make_var("x"), sym::make_val(2)), sym::make_var("y"));
+
+    sym::ThreadPool pool(3);
+    sym::EvalFileOptions options;
+    options.chunk_rows = 1000;
+    options.pool = &pool;
+
+    EXPECT_EQ(rows, sym::eval_file(f, in_path, out_path, options));
+
+    sym::ColumnFile result(out_path);
+    ASSERT_EQ(rows, result.rows());
+
+    const double* values = result.column("result");
+    for (std::size_t i = 0; i < rows; ++i){
+        EXPECT_DOUBLE_EQ(xs[i] * 2 + ys[i], values[i]);
+    }
+
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+TEST(eval_file, corrupted_header)
+{
+    std::string path = temp_path("sym_corrupted_columns.bin");
+    double xs[4] = {1, 2, 3, 4};
+    sym::write_columns(path, {"x"}, {xs}, 4);
+
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto rewrite = [&](std::string const& content){
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+    };
+
+    // Cut in the middle of the column names
+    rewrite(bytes.substr(0, 8 + 16 + 2));
+    EXPECT_THROW(sym::ColumnFile file(path), std::runtime_error);
+
+    // Name longer than the file
+    std::string long_name = bytes;
+    long_name[8 + 16 + 3] = char(0x7f);
+    rewrite(long_name);
+    EXPECT_THROW(sym::ColumnFile file(path), std::runtime_error);
+
+    // Row count whose data size overflows
+    std::string rows = bytes;
+    for (int i = 0; i < 8; ++i){
+        rows[8 + i] = char(0xff);
+    }
+    rewrite(rows);
+    EXPECT_THROW(sym::ColumnFile file(path), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef PROJECT_TEST_TESTS_CONTEXT_HEADER
+#define PROJECT_TEST_TESTS_CONTEXT_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <context.h>
+
+#include <string>
+
+TEST(PersistentContext, insert_does_not_modify_base)
+{
+    auto base = sym::PersistentContext().insert("x", sym::make_val(2));
+    auto extended = base.insert("y", sym::make_val(3));
+
+    EXPECT_EQ(1u, base.size());
+    EXPECT_EQ(2u, extended.size());
+    EXPECT_EQ(nullptr, base.find("y"));
+    EXPECT_NE(nullptr, extended.find("y"));
+}
+
+TEST(PersistentContext, lookup_does_not_intern)
+{
+    auto ctx = sym::PersistentContext().insert("x", sym::make_val(2));
+
+    EXPECT_EQ(nullptr, ctx.find("context_test_unknown_name"));
+    EXPECT_EQ(sym::no_symbol, sym::try_intern("context_test_unknown_name"));
+    EXPECT_EQ(sym::intern("x"), sym::try_intern("x"));
+}
+
+TEST(PersistentContext, overwrite)
+{
+    auto ctx = sym::PersistentContext()
+        .insert("x", sym::make_val(2))
+        .insert("x", sym::make_val(5));
+
+    EXPECT_EQ(1u, ctx.size());
+    EXPECT_DOUBLE_EQ(5, sym::make_var("x")->full_eval(ctx));
+}
+
+TEST(PersistentContext, many_bindings)
+{
+    sym::PersistentContext ctx;
+    for (int i = 0; i < 2000; ++i){
+        ctx = ctx.insert("v" + std::to_string(i), sym::make_val(i));
+    }
+
+    EXPECT_EQ(2000u, ctx.size());
+    for (int i = 0; i < 2000; ++i){
+        EXPECT_DOUBLE_EQ(i, ctx.find("v" + std::to_string(i))->full_eval(ctx));
+    }
+}
+
+TEST(PersistentContext, staged_partial_eval)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto f = sym::add(sym::mult(x, y), sym::make_val(2));
+
+    auto stage1 = sym::PersistentContext().insert("x", sym::make_val(3));
+    auto g = f->partial_eval(stage1);
+
+    auto stage2 = stage1.insert("y", sym::make_val(4));
+    EXPECT_DOUBLE_EQ(3 * 4 + 2, g->full_eval(stage2));
+    EXPECT_THROW(g->full_eval(stage1), std::out_of_range);
+}
+
+#endif
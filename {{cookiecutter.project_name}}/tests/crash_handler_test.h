@@ -0,0 +1,128 @@
+#ifndef PROJECT_TEST_TESTS_CRASH_HANDLER_HEADER
+#define PROJECT_TEST_TESTS_CRASH_HANDLER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <crash_handler.h>
+#include <logger.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "temp_path.h"
+
+static std::string crash_report_path(){
+    return temp_path("crash_handler_test.txt");
+}
+
+static std::string read_crash_report(){
+    std::ifstream in(crash_report_path());
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+__attribute__((noinline)) static void crash_null_store(){
+    volatile int* volatile ptr = nullptr;
+    *ptr = 1;
+}
+
+// Recorded by the flight recorder, not logged
+static void crash_after_logging(){
+    sym::set_log_level(sym::LogLevel::OFF);
+    warn("last step {} before the {}", 17, "crash");
+    crash_null_store();
+}
+
+static volatile int crash_overflow_limit = 1 << 30;
+
+__attribute__((noinline)) static int crash_overflow(int depth){
+    volatile char frame[1024];
+    frame[0] = char(depth);
+    if (depth > crash_overflow_limit){
+        return 0;
+    }
+    return crash_overflow(depth + 1) + frame[0];
+}
+
+TEST(crash_handler, segfault_report)
+{
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    std::remove(crash_report_path().c_str());
+
+    EXPECT_EXIT({
+        sym::install_crash_handler({crash_report_path()});
+        crash_after_logging();
+    }, testing::KilledBySignal(SIGSEGV), "Fatal signal SIGSEGV, crash report written to");
+
+    std::string report = read_crash_report();
+    EXPECT_EQ(0u, report.find("*** sym crash report ***\nsignal 11 SIGSEGV code 1 address 0x0\n")) << report;
+    EXPECT_NE(std::string::npos, report.find("\nregisters\n"));
+    EXPECT_NE(std::string::npos, report.find("\nframes\n #0 0x"));
+    EXPECT_NE(std::string::npos, report.find("libc.so"));
+    EXPECT_NE(std::string::npos, report.find("last step {} before the {}\n"));
+    EXPECT_EQ(report.size() - 4, report.find("end\n"));
+
+    // The flight recorder events are formatted without addr2line
+    {
+        std::istringstream in(report);
+        std::ostringstream out;
+        sym::symbolize_crash_report(in, out);
+
+        std::string text = out.str();
+        std::size_t events = text.find("\nevents\n");
+        EXPECT_NE(std::string::npos, text.find(" [W] [", events)) << text.substr(events, 400);
+        EXPECT_NE(std::string::npos, text.find("crash_after_logging - last step 17 before the crash\n", events)) << text.substr(events, 400);
+    }
+
+    if (std::system("addr2line --version > /dev/null 2>&1") == 0){
+        std::istringstream in(report);
+        std::ostringstream out;
+        sym::symbolize_crash_report(in, out);
+
+        // The faulting instruction is the first frame
+        std::string text = out.str();
+        std::size_t frames = text.find("\nframes\n");
+        EXPECT_NE(std::string::npos, text.find("crash_null_store()", frames)) << text.substr(frames, 400);
+
+        // Its callers come from the frame pointer chain, tail calls leave no frame
+        EXPECT_NE(std::string::npos, text.find("segfault_report_Test::TestBody()", frames)) << text.substr(frames, 400);
+    }
+}
+
+TEST(crash_handler, stack_overflow_uses_the_alternate_stack)
+{
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    std::remove(crash_report_path().c_str());
+
+    EXPECT_EXIT({
+        sym::install_crash_handler({crash_report_path()});
+        crash_overflow(0);
+    }, testing::KilledBySignal(SIGSEGV), "Fatal signal SIGSEGV");
+
+    std::string report = read_crash_report();
+    EXPECT_EQ(0u, report.find("*** sym crash report ***\nsignal 11 SIGSEGV"));
+
+    // The walk is bounded by the frames kept in the report
+    EXPECT_NE(std::string::npos, report.find("\n #63 0x")) << report.substr(0, 2000);
+}
+
+TEST(crash_handler, abort_report)
+{
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    std::remove(crash_report_path().c_str());
+
+    EXPECT_EXIT({
+        sym::install_crash_handler({crash_report_path()});
+        std::abort();
+    }, testing::KilledBySignal(SIGABRT), "Fatal signal SIGABRT");
+
+    std::string report = read_crash_report();
+    EXPECT_NE(std::string::npos, report.find("signal 6 SIGABRT"));
+    EXPECT_NE(std::string::npos, report.find("\nmaps\n"));
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef PROJECT_TEST_TESTS_EXPR_POOL_HEADER
+#define PROJECT_TEST_TESTS_EXPR_POOL_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <expr_pool.h>
+
+#include <stdexcept>
+
+TEST(ExprPool, handles)
+{
+    static_assert(sizeof(sym::ExprHandle) == 4, "handles are 32 bits");
+
+    sym::ExprPool pool;
+    auto x = sym::make_var("x");
+    auto f = sym::add(x, sym::make_val(1));
+
+    sym::ExprHandle hf = pool.insert(f);
+    sym::ExprHandle hx = pool.insert(x);
+
+    EXPECT_TRUE(hf);
+    EXPECT_EQ(hf, pool.insert(f));
+    EXPECT_EQ(hx, pool.find(x));
+    EXPECT_EQ(f, pool.get(hf));
+    EXPECT_EQ(2u, pool.size());
+
+    EXPECT_EQ(nullptr, pool.get(sym::ExprHandle()));
+    EXPECT_THROW(pool.at(sym::ExprHandle()), std::out_of_range);
+}
+
+TEST(ExprPool, collect_unreachable)
+{
+    sym::ExprPool pool;
+    auto x = sym::make_var("x");
+
+    sym::ExprHandle root = pool.insert(sym::mult(x, x));
+    sym::ExprHandle leaf = pool.insert(x);
+    sym::ExprHandle garbage = pool.insert(sym::add(sym::make_var("y"), sym::make_val(2)));
+
+    // The pool owns the only reference of `garbage`
+    EXPECT_EQ(2u, pool.get(garbage).use_count());     // pool + temporary
+
+    EXPECT_EQ(1u, pool.collect(std::vector<sym::ExprHandle>{root}));
+    EXPECT_TRUE(pool.alive(root));
+    EXPECT_TRUE(pool.alive(leaf));     // reachable from root
+    EXPECT_FALSE(pool.alive(garbage));
+    EXPECT_THROW(pool.at(garbage), std::out_of_range);
+
+    // The slot is reused with a new generation, the stale handle stays invalid
+    sym::ExprHandle reused = pool.insert(sym::make_val(3));
+    EXPECT_EQ(garbage.index(), reused.index());
+    EXPECT_NE(garbage, reused);
+    EXPECT_FALSE(pool.alive(garbage));
+    EXPECT_EQ(3u, pool.capacity());
+}
+
+TEST(ExprPool, bounded_capacity)
+{
+    sym::ExprPool pool;
+    auto x = sym::make_var("x");
+
+    for (int round = 0; round < 1000; ++round){
+        for (int i = 0; i < 8; ++i){
+            pool.insert(sym::mult(x, sym::make_val(i)));
+        }
+        pool.collect(std::vector<sym::Expr>{});
+    }
+
+    // Every slot wrapped its generation around, 0 is skipped
+    EXPECT_EQ(0u, pool.size());
+    EXPECT_EQ(8u, pool.capacity());
+    EXPECT_NE(0u, pool.insert(x).generation());
+}
+
+TEST(ExprPool, partial_eval_shares_leaves)
+{
+    auto x = sym::make_var("x");
+    auto c = sym::make_val(2);
+
+    EXPECT_EQ(x, x->partial_eval(sym::Context()));
+    EXPECT_EQ(c, c->partial_eval(sym::Context()));
+}
+
+#endif
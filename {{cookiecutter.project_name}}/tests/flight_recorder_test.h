@@ -0,0 +1,148 @@
+#ifndef PROJECT_TEST_TESTS_FLIGHT_RECORDER_HEADER
+#define PROJECT_TEST_TESTS_FLIGHT_RECORDER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <flight_recorder.h>
+#include <logger.h>
+
+#include <spdlog/details/os.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Events of the calling thread
+static std::vector<sym::FlightEvent> thread_flight_events(){
+    std::vector<sym::FlightEvent> events;
+    for (auto& event: sym::flight_recorder_events()){
+        if (event.thread == spdlog::details::os::thread_id()){
+            events.push_back(std::move(event));
+        }
+    }
+    return events;
+}
+
+TEST(flight_recorder, records_filtered_calls)
+{
+    sym::clear_flight_recorder();
+    sym::set_log_level(sym::LogLevel::ERROR);
+    warn("step {} of {} dt={:.2f}", 3, "solve", 0.125);
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    auto events = thread_flight_events();
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ(sym::LogLevel::WARN, events[0].level);
+    EXPECT_EQ("step 3 of solve dt=0.12", events[0].text);
+    EXPECT_STREQ("TestBody", events[0].loc->function_name);
+}
+
+TEST(flight_recorder, keeps_the_last_events)
+{
+    sym::clear_flight_recorder();
+    sym::set_log_level(sym::LogLevel::ERROR);
+    for (std::size_t i = 0; i < sym::flight_recorder_capacity + 44; ++i){
+        warn("event {}", i);
+    }
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    auto events = thread_flight_events();
+    ASSERT_EQ(sym::flight_recorder_capacity, events.size());
+    EXPECT_EQ("event 44", events.front().text);
+    EXPECT_EQ("event 299", events.back().text);
+}
+
+TEST(flight_recorder, long_arguments_are_dropped)
+{
+    sym::clear_flight_recorder();
+    std::string large(200, 'x');
+    sym::set_log_level(sym::LogLevel::ERROR);
+    warn("{} {} {}", 1, large, 2);
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    auto events = thread_flight_events();
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ("1 {} {}", events[0].text);
+}
+
+TEST(flight_recorder, level)
+{
+    sym::clear_flight_recorder();
+    sym::set_flight_recorder_level(sym::LogLevel::OFF);
+    sym::set_log_level(sym::LogLevel::OFF);
+    warn("not recorded");
+    sym::set_log_level(sym::LogLevel::TRACE);
+    sym::set_flight_recorder_level(sym::LogLevel::WARN);
+
+    EXPECT_TRUE(thread_flight_events().empty());
+}
+
+TEST(flight_recorder, threads_have_their_own_ring)
+{
+    sym::clear_flight_recorder();
+    sym::set_log_level(sym::LogLevel::ERROR);
+    std::thread worker([](){
+        warn("from the worker");
+    });
+    worker.join();
+    warn("from the main thread");
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    auto events = sym::flight_recorder_events();
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ("from the worker", events[0].text);
+    EXPECT_EQ("from the main thread", events[1].text);
+    EXPECT_NE(events[0].thread, events[1].thread);
+    EXPECT_LE(events[0].time, events[1].time);
+}
+
+// Logs when the thread exits, after the recorder of the thread if built before it
+struct LogOnExit{
+    ~LogOnExit(){
+        warn("from a thread_local destructor");
+    }
+};
+
+TEST(flight_recorder, exiting_thread_stops_recording)
+{
+    sym::clear_flight_recorder();
+    sym::set_log_level(sym::LogLevel::ERROR);
+    std::thread worker([](){
+        thread_local LogOnExit log_on_exit;
+        (void) log_on_exit;
+        warn("from the worker");
+    });
+    worker.join();
+
+    // The ring of the worker is free again, the next thread takes it
+    std::thread next([](){
+        warn("from the next thread");
+    });
+    next.join();
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    auto events = sym::flight_recorder_events();
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ("from the worker", events[0].text);
+    EXPECT_EQ("from the next thread", events[1].text);
+}
+
+TEST(flight_recorder, show_log_backtrace)
+{
+    sym::clear_flight_recorder();
+    sym::set_log_level(sym::LogLevel::ERROR);
+    warn("hidden {}", 42);
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    testing::internal::CaptureStdout();
+    sym::show_log_backtrace();
+    std::string out = testing::internal::GetCapturedStdout();
+
+    std::size_t start = out.find("Backtrace Start");
+    std::size_t event = out.find("[W]");
+    EXPECT_LT(start, event) << out;
+    EXPECT_NE(std::string::npos, out.find("flight_recorder_test.h:", event)) << out;
+    EXPECT_LT(out.find("TestBody - hidden 42", event), out.find("Backtrace End")) << out;
+}
+
+#endif
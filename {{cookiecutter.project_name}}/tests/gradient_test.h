@@ -0,0 +1,63 @@
+#ifndef PROJECT_TEST_TESTS_GRADIENT_HEADER
+#define PROJECT_TEST_TESTS_GRADIENT_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <gradient.h>
+#include <profiler.h>
+
+#include <string>
+
+TEST(symbolic_gradient, matches_derivate)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+
+    // (x * y + x * x) * (y + 3)
+    auto f = sym::mult(sym::add(sym::mult(x, y), sym::mult(x, x)), sym::add(y, sym::make_val(3)));
+    auto grad = sym::symbolic_gradient(f, {"x", "y", "z"});
+
+    sym::Context ctx = {
+        {"x", sym::make_val(1.5)},
+        {"y", sym::make_val(-2)},
+        {"z", sym::make_val(4)}
+    };
+
+    ASSERT_EQ(3u, grad.size());
+    EXPECT_DOUBLE_EQ(f->derivate("x")->full_eval(ctx), grad[0]->full_eval(ctx));
+    EXPECT_DOUBLE_EQ(f->derivate("y")->full_eval(ctx), grad[1]->full_eval(ctx));
+    EXPECT_DOUBLE_EQ(0, grad[2]->full_eval(ctx));
+}
+
+TEST(symbolic_gradient, shared_dag)
+{
+    // x0 * x1 * ... * x63
+    int n = 64;
+    std::vector<std::string> vars;
+    sym::Expr f = sym::make_val(1);
+
+    for (int i = 0; i < n; ++i){
+        vars.push_back("x" + std::to_string(i));
+        f = sym::mult(f, sym::make_var(vars.back()));
+    }
+
+    auto grad = sym::symbolic_gradient(f, vars);
+
+    // join every output to count the unique nodes of the whole gradient
+    sym::Expr all = grad[0];
+    for (int i = 1; i < n; ++i){
+        all = sym::add(all, grad[std::size_t(i)]);
+    }
+
+    auto stats = sym::graph_stats(all);
+    EXPECT_LT(stats.unique_nodes, std::size_t(6 * n));
+
+    sym::Context ctx;
+    for (int i = 0; i < n; ++i){
+        ctx[vars[std::size_t(i)]] = sym::make_val(i % 2 ? 1.0 : -1.0);
+    }
+    EXPECT_DOUBLE_EQ(f->derivate("x5")->full_eval(ctx), grad[5]->full_eval(ctx));
+}
+
+#endif
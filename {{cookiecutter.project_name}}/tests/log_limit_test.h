@@ -0,0 +1,122 @@
+#ifndef PROJECT_TEST_TESTS_LOG_LIMIT_HEADER
+#define PROJECT_TEST_TESTS_LOG_LIMIT_HEADER
+
+#include <gtest/gtest.h>
+
+#include <log_limit.h>
+#include <logger.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int count_call(std::atomic<int>& count){
+    return ++count;
+}
+
+TEST(log_limit, first_n_then_summary)
+{
+    std::atomic<int> count{0};
+
+    testing::internal::CaptureStdout();
+    for (int i = 0; i < 10; ++i){
+        SYM_LOG_FIRST_N(INFO, 3, "first {}", count_call(count));
+    }
+    sym::report_suppressed_logs();
+    std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(3, count.load());
+    EXPECT_NE(std::string::npos, out.find("first 3")) << out;
+    EXPECT_EQ(std::string::npos, out.find("first 4")) << out;
+    EXPECT_NE(std::string::npos, out.find("TestBody - 7 similar messages suppressed")) << out;
+
+    // Reported once
+    testing::internal::CaptureStdout();
+    sym::report_suppressed_logs();
+    EXPECT_EQ(std::string::npos, testing::internal::GetCapturedStdout().find("similar messages"));
+}
+
+TEST(log_limit, every_n)
+{
+    std::atomic<int> count{0};
+
+    testing::internal::CaptureStdout();
+    for (int i = 0; i < 10; ++i){
+        SYM_LOG_EVERY_N(INFO, 4, "sample {} {}", i, count_call(count));
+    }
+    std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(3, count.load());
+    std::size_t suppressed = out.find("3 similar messages suppressed");
+    EXPECT_LT(out.find("sample 0 1"), suppressed) << out;
+    EXPECT_LT(suppressed, out.find("sample 4 2")) << out;
+    EXPECT_NE(std::string::npos, out.find("sample 8 3")) << out;
+}
+
+TEST(log_limit, per_second)
+{
+    std::atomic<int> count{0};
+
+    testing::internal::CaptureStdout();
+    for (int i = 0; i < 1000; ++i){
+        SYM_LOG_PER_SECOND(INFO, 5, "storm {}", count_call(count));
+    }
+    testing::internal::GetCapturedStdout();
+
+    // The loop can cross a second
+    EXPECT_GE(count.load(), 5);
+    EXPECT_LE(count.load(), 10);
+}
+
+TEST(log_limit, per_second_zero_admits_nothing)
+{
+    std::atomic<int> count{0};
+
+    testing::internal::CaptureStdout();
+    for (int i = 0; i < 10; ++i){
+        SYM_LOG_PER_SECOND(INFO, 0, "never {}", count_call(count));
+    }
+    testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(0, count.load());
+}
+
+TEST(log_limit, compiled_out_below_the_min_level)
+{
+    std::atomic<int> count{0};
+
+    // Compiled out in Release builds, whatever the runtime level
+    for (int i = 0; i < 10; ++i){
+        SYM_LOG_FIRST_N(DEBUG, 3, "debug {}", count_call(count));
+    }
+
+#if SYM_LOG_MIN_LEVEL <= 1
+    EXPECT_EQ(3, count.load());
+#else
+    EXPECT_EQ(0, count.load());
+#endif
+}
+
+TEST(log_limit, threads_share_the_site_limit)
+{
+    std::atomic<int> count{0};
+
+    sym::set_log_level(sym::LogLevel::OFF);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t){
+        threads.emplace_back([&count](){
+            for (int i = 0; i < 1000; ++i){
+                SYM_LOG_FIRST_N(WARN, 50, "{}", count_call(count));
+            }
+        });
+    }
+    for (auto& thread: threads){
+        thread.join();
+    }
+    sym::set_log_level(sym::LogLevel::TRACE);
+
+    EXPECT_EQ(50, count.load());
+}
+
+#endif
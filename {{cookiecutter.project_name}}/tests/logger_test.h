@@ -0,0 +1,235 @@
+#ifndef PROJECT_TEST_TESTS_LOGGER_HEADER
+#define PROJECT_TEST_TESTS_LOGGER_HEADER
+
+#include <gtest/gtest.h>
+
+// spdlog.h before logger.h, see symbolic_test.cpp
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/base_sink.h>
+
+#include <logger.h>
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "temp_path.h"
+
+TEST(logger, call_site_is_static)
+{
+    static_assert(std::is_trivially_destructible<sym::CodeLocation>::value, "no owned strings");
+
+    constexpr sym::CodeLocation loc = LOC;
+    EXPECT_EQ(__LINE__ - 1, loc.line);
+    EXPECT_NE(nullptr, std::strstr(loc.filename, "logger_test.h"));
+    EXPECT_STREQ("TestBody", loc.function_name);
+
+    for (int i = 0; i < 3; ++i){
+        debug("iteration {}", i);
+    }
+    EXPECT_TRUE(sym::log_enabled(sym::LogLevel::DEBUG));
+}
+
+TEST(logger, single_pass_format)
+{
+    static constexpr sym::CodeLocation loc{"render.cpp", "draw", 12, "void draw()"};
+
+    auto msg = sym::format_log(loc, "frame {} took {} ms", fmt::make_format_args(42, 16.5));
+    EXPECT_EQ("render.cpp:12 draw - frame 42 took 16.5 ms", std::string(msg.data(), msg.size()));
+
+    // The buffer is reused by the next message of the thread
+    const char* data = msg.data();
+    msg = sym::format_log(loc, "{}", fmt::make_format_args("again"));
+    EXPECT_EQ("render.cpp:12 draw - again", std::string(msg.data(), msg.size()));
+    EXPECT_EQ(data, msg.data());
+}
+
+TEST(logger, message_is_not_reformatted)
+{
+    testing::internal::CaptureStdout();
+    info("{} {}", "{braces}", "{{escaped}}");
+    std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(std::string::npos, out.find("{braces} {{escaped}}")) << out;
+}
+
+static int touch(int& count){
+    return ++count;
+}
+
+TEST(logger, filtered_arguments_are_not_evaluated)
+{
+    int count = 0;
+
+    sym::set_log_level(sym::LogLevel::WARN);
+    EXPECT_EQ(sym::LogLevel::WARN, sym::log_level());
+    EXPECT_FALSE(sym::log_enabled(sym::LogLevel::INFO));
+    info("{}", touch(count));
+    EXPECT_EQ(0, count);
+
+    sym::set_log_level(sym::LogLevel::TRACE);
+    info("{}", touch(count));
+    EXPECT_EQ(1, count);
+
+    // What calls below SYM_LOG_MIN_LEVEL expand to
+    SYM_LOG_DISABLED(sym::LogLevel::ERROR, "{}", touch(count));
+    EXPECT_EQ(1, count);
+}
+
+static std::size_t count_lines(std::string const& out, std::string const& marker){
+    std::size_t n = 0;
+    for (std::size_t pos = out.find(marker); pos != std::string::npos; pos = out.find(marker, pos + 1)){
+        n += 1;
+    }
+    return n;
+}
+
+TEST(logger, async_keeps_every_message_in_order)
+{
+    sym::enable_async_logging();
+
+    testing::internal::CaptureStdout();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t){
+        threads.emplace_back([t](){
+            for (int i = 0; i < 500; ++i){
+                info("async {} {}", t, i);
+            }
+        });
+    }
+    for (auto& t: threads){
+        t.join();
+    }
+    sym::flush_log();
+    std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(2000u, count_lines(out, "async "));
+    EXPECT_LT(out.find("async 2 0\n"), out.find("async 2 499\n"));
+
+    sym::disable_async_logging();
+}
+
+TEST(logger, async_overflow_accounts_for_every_message)
+{
+    for (auto policy: {sym::OverflowPolicy::Drop, sym::OverflowPolicy::DropOldest}){
+        sym::AsyncLogOptions options;
+        options.overflow = policy;
+        sym::enable_async_logging(options);
+
+        std::size_t dropped = sym::dropped_log_messages();
+
+        testing::internal::CaptureStdout();
+        for (int i = 0; i < 20000; ++i){
+            info("overflow {}", i);
+        }
+        sym::flush_log();
+        std::string out = testing::internal::GetCapturedStdout();
+
+        EXPECT_EQ(20000u, count_lines(out, "overflow ") + sym::dropped_log_messages() - dropped);
+        sym::disable_async_logging();
+    }
+}
+
+// Sink of a full disk
+class ThrowingSink: public spdlog::sinks::base_sink<std::mutex>
+{
+protected:
+    void sink_it_(spdlog::details::log_msg const&) override { throw std::runtime_error("disk full"); }
+    void flush_() override { throw std::runtime_error("disk full"); }
+};
+
+TEST(logger, async_survives_a_throwing_sink)
+{
+    sym::enable_async_logging();
+    sym::flush_log();
+
+    // Idle writer: the sinks are only read after a message is popped
+    auto root = spdlog::get("root");
+    root->sinks().push_back(std::make_shared<ThrowingSink>());
+
+    testing::internal::CaptureStderr();
+    testing::internal::CaptureStdout();
+    info("before {}", "the broken sink");
+    info("after {}", "the broken sink");
+    sym::flush_log();
+    std::string out = testing::internal::GetCapturedStdout();
+    std::string err = testing::internal::GetCapturedStderr();
+
+    root->sinks().pop_back();
+    sym::disable_async_logging();
+
+    // The other sinks got both messages
+    EXPECT_NE(std::string::npos, out.find("before the broken sink")) << out;
+    EXPECT_NE(std::string::npos, out.find("after the broken sink")) << out;
+    EXPECT_NE(std::string::npos, err.find("[root] {disk full}")) << err;
+}
+
+enum class Color{ Red, Green };
+
+TEST(logger, binary_log_round_trip)
+{
+    std::string path = temp_path("logger_test.binlog");
+    sym::enable_binary_logging(path, 4096);
+
+    const char* name = "tensor";
+    std::string shape = "3x4";
+    void* ptr = nullptr;
+
+    info("{} {} of {} has {:.2f} {} {}", name, shape, 'c', 3.14159, true, Color::Green);
+    warn("{1} before {0}, {{literal}} {0:>4}", 1, 2u);
+    info("{}", ptr);
+
+    // Enough messages to wrap the thread buffers
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t){
+        threads.emplace_back([t](){
+            for (int i = 0; i < 1000; ++i){
+                info("binary {} {}", t, i);
+            }
+        });
+    }
+    for (auto& t: threads){
+        t.join();
+    }
+    sym::disable_binary_logging();
+    EXPECT_EQ(0u, sym::dropped_binary_messages());
+
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    sym::decode_binary_log(in, text);
+    std::string out = text.str();
+
+    EXPECT_NE(std::string::npos, out.find("logger_test.h:")) << out.substr(0, 200);
+    EXPECT_NE(std::string::npos, out.find("TestBody - tensor 3x4 of c has 3.14 true 1\n"));
+    EXPECT_NE(std::string::npos, out.find("[W] ["));
+    EXPECT_NE(std::string::npos, out.find(" - 2 before 1, {literal}    1\n"));
+    EXPECT_NE(std::string::npos, out.find(" - 0x0\n"));
+    EXPECT_EQ(2000u, count_lines(out, "binary "));
+    EXPECT_LT(out.find("binary 1 0\n"), out.find("binary 1 999\n"));
+
+    // Format strings and locations are stored once
+    in.clear();
+    in.seekg(0, std::ios::end);
+    EXPECT_LT(std::size_t(in.tellg()) * 5, out.size());
+
+    // Back to text logging
+    testing::internal::CaptureStdout();
+    info("text again");
+    EXPECT_NE(std::string::npos, testing::internal::GetCapturedStdout().find("text again"));
+}
+
+TEST(logger, binary_log_rejects_text)
+{
+    std::stringstream in("[I] not a binary log");
+    std::stringstream out;
+    EXPECT_THROW(sym::decode_binary_log(in, out), std::runtime_error);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef PROJECT_TEST_TESTS_ODE_HEADER
+#define PROJECT_TEST_TESTS_ODE_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <ode.h>
+
+#include <cmath>
+#include <vector>
+
+TEST(ode, decay_parameter_sweep)
+{
+    auto x = sym::make_var("x");
+    auto k = sym::make_var("k");
+
+    // dx/dt = -k x
+    sym::OdeSystem system({sym::mult(sym::mult(sym::make_val(-1), k), x)}, {"x"}, {"k"});
+
+    std::size_t n = 600;
+    std::vector<double> initial(n, 1.0);
+    std::vector<double> params(n);
+    for (std::size_t i = 0; i < n; ++i){
+        params[i] = double(i) / 100;
+    }
+
+    for (auto method: {sym::OdeMethod::RK4, sym::OdeMethod::RK45}){
+        sym::OdeOptions options;
+        options.method = method;
+
+        auto result = system.integrate(initial, params, n, options);
+
+        for (std::size_t i = 0; i < n; ++i){
+            ASSERT_TRUE(result.success[i]);
+            EXPECT_NEAR(std::exp(-params[i]), result.x[i], 1e-6);
+        }
+    }
+}
+
+TEST(ode, oscillator_and_time)
+{
+    auto x = sym::make_var("x");
+    auto v = sym::make_var("v");
+    auto t = sym::make_var("t");
+
+    // x'' = -x, and y' = t
+    sym::OdeSystem system({v, sym::mult(sym::make_val(-1), x), t}, {"x", "v", "y"});
+
+    sym::OdeOptions options;
+    options.rtol = 1e-10;
+    options.atol = 1e-12;
+
+    auto result = system.integrate({1, 0, 0}, {}, 1, options);
+
+    ASSERT_TRUE(result.success[0]);
+    EXPECT_NEAR(std::cos(1.0), result.x[0], 1e-8);
+    EXPECT_NEAR(-std::sin(1.0), result.x[1], 1e-8);
+    EXPECT_NEAR(0.5, result.x[2], 1e-8);
+    EXPECT_GT(result.steps[0], 1u);
+}
+
+TEST(ode, stiff_bdf)
+{
+    auto x = sym::make_var("x");
+
+    // dx/dt = -1000 (x - 1), explicit methods are unstable with dt = 0.01
+    sym::OdeSystem system({sym::mult(sym::make_val(-1000), sym::add(x, sym::make_val(-1)))}, {"x"});
+
+    sym::OdeOptions options;
+    options.method = sym::OdeMethod::BDF;
+
+    auto result = system.integrate({0}, {}, 1, options);
+
+    ASSERT_TRUE(result.success[0]);
+    EXPECT_EQ(100u, result.steps[0]);
+    EXPECT_NEAR(1, result.x[0], 1e-6);
+
+    options.method = sym::OdeMethod::RK4;
+    result = system.integrate({0}, {}, 1, options);
+    EXPECT_GT(std::abs(result.x[0] - 1), 1);
+}
+
+TEST(ode, rk45_last_step_rounding)
+{
+    // dx/dt = 0, the step grows until the last one is t1 - t: t + (t1 - t) lands one ulp
+    // short of t1 and the remainder is below the step floor
+    sym::OdeSystem system({sym::make_val(0)}, {"x"});
+
+    sym::OdeOptions options;
+    options.t0 = 0.2;
+    options.t1 = 1000.1;
+    options.dt = 0.1;
+
+    auto result = system.integrate({3}, {}, 1, options);
+
+    ASSERT_TRUE(result.success[0]);
+    EXPECT_EQ(3, result.x[0]);
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef PROJECT_TEST_TESTS_OPTIMIZE_HEADER
+#define PROJECT_TEST_TESTS_OPTIMIZE_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <egraph.h>
+
+inline int count_kind(sym::Expr const& e, sym::NodeKind kind){
+    int n = e->kind() == kind;
+    for (std::size_t i = 0; i < e->arity(); ++i){
+        n += count_kind(e->child(i), kind);
+    }
+    return n;
+}
+
+TEST(optimize, factor)
+{
+    auto a = sym::make_var("a");
+    auto b = sym::make_var("b");
+    auto c = sym::make_var("c");
+
+    // a * b + a * c => a * (b + c)
+    auto f = sym::add(sym::mult(a, b), sym::mult(c, a));
+    auto g = sym::optimize(f);
+
+    EXPECT_EQ(1, count_kind(g, sym::NodeKind::Mult));
+
+    sym::Context ctx = {
+        {"a", sym::make_val(2)},
+        {"b", sym::make_val(3)},
+        {"c", sym::make_val(5)}
+    };
+    EXPECT_DOUBLE_EQ(f->full_eval(ctx), g->full_eval(ctx));
+}
+
+TEST(optimize, constant_folding)
+{
+    auto x = sym::make_var("x");
+    auto f = sym::mult(sym::add(x, sym::make_val(0)), sym::mult(sym::make_val(2), sym::make_val(3)));
+    auto g = sym::optimize(f);
+
+    EXPECT_EQ(1, count_kind(g, sym::NodeKind::Mult));
+    EXPECT_EQ(0, count_kind(g, sym::NodeKind::Add));
+
+    sym::Context ctx = {{"x", sym::make_val(7)}};
+    EXPECT_DOUBLE_EQ(42, g->full_eval(ctx));
+}
+
+TEST(optimize, budget_is_respected)
+{
+    auto f = sym::make_var("x0");
+    for (int i = 1; i < 24; ++i){
+        f = sym::add(sym::mult(f, sym::make_var("x" + std::to_string(i))), sym::make_var("y"));
+    }
+
+    sym::OptimizeBudget budget;
+    budget.max_nodes = 2000;
+
+    auto g = sym::optimize(f, budget);
+
+    sym::Context ctx;
+    for (int i = 0; i < 24; ++i){
+        ctx["x" + std::to_string(i)] = sym::make_val(1 + i % 3);
+    }
+    ctx["y"] = sym::make_val(0.5);
+
+    EXPECT_DOUBLE_EQ(f->full_eval(ctx), g->full_eval(ctx));
+}
+
+TEST(optimize, deep_expression)
+{
+    auto x = sym::make_var("x");
+    sym::Expr f = x;
+    for (int i = 0; i < 200000; ++i){
+        f = sym::add(sym::make_val(1 + i % 7), f);
+    }
+
+    // Only the insertion and the extraction run, both walk the whole chain
+    sym::OptimizeBudget budget;
+    budget.max_nodes = 1;
+
+    auto g = sym::optimize(f, budget);
+
+    int adds = 0;
+    for (sym::ABSExpr* node: sym::topological_order(g)){
+        adds += node->kind() == sym::NodeKind::Add;
+    }
+    EXPECT_EQ(200000, adds);
+}
+
+#endif
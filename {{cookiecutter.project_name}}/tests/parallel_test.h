@@ -0,0 +1,79 @@
+#ifndef PROJECT_TEST_TESTS_PARALLEL_HEADER
+#define PROJECT_TEST_TESTS_PARALLEL_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <parallel.h>
+#include <compile.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Sum of `width` independent chains of `depth` shared squares, plenty of nodes per level
+static sym::Expr parallel_model(std::size_t width, std::size_t depth){
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    sym::Expr total = sym::make_val(0);
+
+    for (std::size_t i = 0; i < width; ++i){
+        sym::Expr e = sym::add(sym::mult(x, sym::make_val(1.0 / double(i + 1))), y);
+        for (std::size_t d = 0; d < depth; ++d){
+            // e * e + e: e is shared, the tree is exponential
+            e = sym::add(sym::mult(e, e), sym::mult(sym::make_val(0.5), e));
+        }
+        total = sym::add(total, e);
+    }
+    return total;
+}
+
+TEST(parallel, derivate_matches_sequential)
+{
+    sym::ThreadPool pool(4);
+    auto f = parallel_model(8, 3);
+
+    sym::Context ctx = {{"x", sym::make_val(0.3)}, {"y", sym::make_val(-0.2)}};
+
+    for (const char* name: {"x", "y", "z"}){
+        auto expected = f->derivate(name)->full_eval(ctx);
+        EXPECT_NEAR(expected, sym::parallel_derivate(f, name, &pool)->full_eval(ctx), 1e-12 * (1 + std::abs(expected)));
+    }
+}
+
+TEST(parallel, sharing_is_preserved)
+{
+    sym::ThreadPool pool(4);
+
+    // 1500 nodes per level, the recursive derivate would visit 2^12 paths per chain
+    auto f = parallel_model(1500, 12);
+    auto df = sym::parallel_derivate(f, "x", &pool);
+
+    std::size_t nodes = sym::topological_order(f).size();
+    EXPECT_LT(sym::topological_order(df).size(), 4 * nodes);
+
+    // Without bindings nothing is copied
+    EXPECT_EQ(f, sym::parallel_partial_eval(f, sym::Context(), &pool));
+
+    sym::Context ctx = {{"y", sym::make_val(0.1)}};
+    auto g = sym::parallel_partial_eval(f, ctx, &pool);
+    EXPECT_LE(sym::topological_order(g).size(), nodes);
+
+    // full_eval would walk every path too, programs evaluate the DAG
+    double point[] = {-0.05, 0.1};
+    double expected = sym::compile(f, {"x", "y"}).eval(point);
+    EXPECT_DOUBLE_EQ(expected, sym::compile(g, {"x"}).eval(point));
+
+    ctx["x"] = sym::make_val(-0.05);
+    auto h = sym::parallel_partial_eval(f, sym::PersistentContext::from(ctx), &pool);
+    EXPECT_DOUBLE_EQ(expected, sym::compile(h, {}).eval(nullptr));
+}
+
+TEST(parallel, scalar_nodes_only)
+{
+    auto f = sym::sum(sym::make_tensor_var("W", 2, 2));
+    EXPECT_THROW(sym::parallel_derivate(f, "x"), std::invalid_argument);
+    EXPECT_THROW(sym::parallel_partial_eval(f, sym::Context()), std::invalid_argument);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PROJECT_TEST_TESTS_PRINTER_HEADER
+#define PROJECT_TEST_TESTS_PRINTER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <printer.h>
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+TEST(printer, styles)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto f = sym::mult(x, sym::add(y, sym::make_val(2)));
+
+    EXPECT_EQ("x * (y + 2)", sym::to_string(f));
+    EXPECT_EQ("(* x (+ y 2))", sym::to_string(f, sym::PrintStyle::Prefix));
+    EXPECT_EQ("x * (y + 2.0)", sym::to_string(f, sym::PrintStyle::C));
+    EXPECT_EQ("x * (y + 2.0)", sym::to_string(f, sym::PrintStyle::GLSL));
+
+    auto inf = sym::add(x, sym::make_val(std::numeric_limits<double>::infinity()));
+    EXPECT_EQ("x + INFINITY", sym::to_string(inf, sym::PrintStyle::C));
+    EXPECT_EQ("x + (1.0 / 0.0)", sym::to_string(inf, sym::PrintStyle::GLSL));
+}
+
+TEST(printer, grouping_is_preserved)
+{
+    auto a = sym::make_var("a");
+    auto b = sym::make_var("b");
+    auto c = sym::make_var("c");
+
+    EXPECT_EQ("a + b + c", sym::to_string(sym::add(sym::add(a, b), c)));
+    EXPECT_EQ("a + (b + c)", sym::to_string(sym::add(a, sym::add(b, c))));
+    EXPECT_EQ("a * b + c", sym::to_string(sym::add(sym::mult(a, b), c)));
+    EXPECT_EQ("(a + b) * c", sym::to_string(sym::mult(sym::add(a, b), c)));
+}
+
+TEST(printer, shortest_round_trip_numbers)
+{
+    for (double v: {0.1, 0.1 + 0.2, 1.0 / 3, 1e-300, 6.02214076e23, -2.5}){
+        std::string out;
+        sym::print_number(out, v);
+        EXPECT_EQ(v, std::stod(out)) << out;
+    }
+
+    std::string out;
+    sym::print_number(out, 0.1 + 0.2);
+    EXPECT_EQ("0.30000000000000004", out);
+}
+
+TEST(printer, deep_and_tensor_expressions)
+{
+    auto x = sym::make_var("x");
+    sym::Expr f = x;
+    for (int i = 0; i < 20000; ++i){
+        f = sym::add(x, f);
+    }
+
+    std::string out;
+    sym::print(out, f);
+    EXPECT_EQ(20001u + 3 * 20000u + 2 * 19999u, out.size());    // x, " + ", parentheses
+
+    auto W = sym::make_tensor_var("W", 2, 2);
+    auto g = sym::sum(sym::matmul(W, sym::make_tensor(sym::Tensor(2, 1, {1, 0.5}))));
+    EXPECT_EQ("sum(matmul(W, [[1], [0.5]]))", sym::to_string(g));
+    EXPECT_EQ("(sum (matmul W [[1], [0.5]]))", sym::to_string(g, sym::PrintStyle::Prefix));
+    EXPECT_THROW(sym::to_string(g, sym::PrintStyle::C), std::invalid_argument);
+}
+
+#endif
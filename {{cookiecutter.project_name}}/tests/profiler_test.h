@@ -0,0 +1,75 @@
+#ifndef PROJECT_TEST_TESTS_PROFILER_HEADER
+#define PROJECT_TEST_TESTS_PROFILER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <profiler.h>
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+TEST(Profiler, graph_stats)
+{
+    auto x = sym::make_var("x");
+    auto s = sym::add(x, x);
+    auto f = sym::mult(s, s);
+
+    auto stats = sym::graph_stats(f);
+
+    EXPECT_EQ(3u, stats.unique_nodes);
+    EXPECT_DOUBLE_EQ(7, stats.tree_nodes);
+    EXPECT_EQ(1u, stats.by_kind[sym::NodeKind::Placeholder]);
+}
+
+TEST(Profiler, json_is_valid)
+{
+    sym::ProfileReport report;
+    report.total_seconds = std::numeric_limits<double>::infinity();
+    report.graph.sharing_ratio = std::nan("");
+
+    sym::ProfileReport::Subtree subtree;
+    subtree.preview = "tab\there \"quoted\"\x01";
+    subtree.kind = sym::NodeKind::Placeholder;
+    report.hottest.push_back(subtree);
+
+    std::stringstream ss;
+    report.to_json(ss);
+    std::string json = ss.str();
+
+    EXPECT_EQ(0u, json.find("{\"total_seconds\": null,")) << json;
+    EXPECT_NE(std::string::npos, json.find("\"sharing_ratio\": null,")) << json;
+    EXPECT_NE(std::string::npos, json.find("\"expr\": \"tab\\u0009here \\\"quoted\\\"\\u0001\"")) << json;
+}
+
+#if SYM_PROFILE
+TEST(Profiler, records_evaluation)
+{
+    auto x = sym::make_var("x");
+    auto f = sym::mult(sym::add(x, sym::make_val(1)), x);
+    sym::Context ctx = {{"x", sym::make_val(2)}};
+
+    sym::Profiler profiler;
+    f->full_eval(ctx);
+    f->derivate("x");
+
+    auto report = profiler.report(f);
+
+    std::uint64_t calls = 0;
+    for (auto& c: report.counters){
+        calls += c.calls;
+    }
+
+    EXPECT_GT(calls, 0u);
+    EXPECT_GT(report.allocations, 0u);
+    EXPECT_FALSE(report.hottest.empty());
+
+    std::stringstream ss;
+    report.to_json(ss);
+    EXPECT_EQ('{', ss.str().front());
+}
+#endif
+
+#endif
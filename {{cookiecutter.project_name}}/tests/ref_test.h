@@ -0,0 +1,30 @@
+#ifndef PROJECT_TEST_TESTS_REF_HEADER
+#define PROJECT_TEST_TESTS_REF_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+
+TEST(Ref, counts)
+{
+    auto x = sym::make_var("x");
+    EXPECT_EQ(1u, x.use_count());
+
+    {
+        auto f = sym::add(x, x);
+        EXPECT_EQ(3u, x.use_count());
+    }
+
+    EXPECT_EQ(1u, x.use_count());
+}
+
+TEST(Ref, rewrap_raw_pointer)
+{
+    auto x = sym::make_var("x");
+    sym::Expr y(x.get());
+
+    EXPECT_EQ(x, y);
+    EXPECT_EQ(2u, x.use_count());
+}
+
+#endif
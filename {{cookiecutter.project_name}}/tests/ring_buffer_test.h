@@ -0,0 +1,75 @@
+#ifndef PROJECT_TEST_TESTS_RING_BUFFER_HEADER
+#define PROJECT_TEST_TESTS_RING_BUFFER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <ring_buffer.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(RingBuffer, bounded_fifo)
+{
+    sym::RingBuffer<std::string> ring(3);
+    EXPECT_EQ(4u, ring.capacity());
+    EXPECT_TRUE(ring.empty());
+
+    for (int i = 0; i < 4; ++i){
+        EXPECT_TRUE(ring.try_push([&](std::string& s){ s = std::to_string(i); }));
+    }
+    EXPECT_FALSE(ring.try_push([](std::string&){}));
+
+    std::string out;
+    EXPECT_TRUE(ring.try_pop([&](std::string& s){ out = s; }));
+    EXPECT_EQ("0", out);
+    EXPECT_TRUE(ring.try_push([](std::string& s){ s = "4"; }));
+
+    for (const char* expected: {"1", "2", "3", "4"}){
+        EXPECT_TRUE(ring.try_pop([&](std::string& s){ out = s; }));
+        EXPECT_EQ(expected, out);
+    }
+    EXPECT_FALSE(ring.try_pop([](std::string&){}));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(RingBuffer, multiple_producers)
+{
+    struct Item{ int producer; int value; };
+
+    sym::RingBuffer<Item> ring(64);
+    const int producers = 4;
+    const int count = 20000;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p){
+        threads.emplace_back([&, p](){
+            for (int i = 0; i < count; ++i){
+                while (!ring.try_push([&](Item& item){ item = {p, i}; })){
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Values of each producer arrive in order
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    while (received < producers * count){
+        Item item{};
+        if (ring.try_pop([&](Item& i){ item = i; })){
+            ASSERT_EQ(next[item.producer], item.value);
+            next[item.producer] += 1;
+            received += 1;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef PROJECT_TEST_TESTS_SHARED_CONTEXT_HEADER
+#define PROJECT_TEST_TESTS_SHARED_CONTEXT_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <shared_context.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(SharedContext, set_and_read)
+{
+    auto x = sym::make_var("x");
+    auto f = sym::mult(x, sym::make_val(2));
+
+    sym::SharedContext ctx(sym::PersistentContext().insert("x", sym::make_val(3)));
+    EXPECT_DOUBLE_EQ(6, ctx.full_eval(f));
+
+    sym::PersistentContext before = ctx.snapshot();
+    ctx.set("x", sym::make_val(5));
+
+    EXPECT_DOUBLE_EQ(10, ctx.full_eval(f));
+    EXPECT_DOUBLE_EQ(6, f->full_eval(before));
+}
+
+TEST(SharedContext, reclamation_waits_for_readers)
+{
+    sym::SharedContext ctx(sym::PersistentContext().insert("x", sym::make_val(1)));
+
+    {
+        auto reader = ctx.read();
+        ctx.set("x", sym::make_val(2));
+        ctx.set("x", sym::make_val(3));
+
+        // The pinned snapshot is still alive
+        EXPECT_DOUBLE_EQ(1, reader->at(sym::intern("x"))->full_eval(*reader));
+        EXPECT_EQ(2u, ctx.retired());
+    }
+
+    ctx.collect();
+    EXPECT_EQ(0u, ctx.retired());
+}
+
+TEST(SharedContext, concurrent_updates_are_atomic)
+{
+    auto a = sym::make_var("a");
+    auto b = sym::make_var("b");
+    auto f = sym::add(a, b);
+
+    sym::SharedContext ctx(sym::PersistentContext()
+        .insert("a", sym::make_val(0))
+        .insert("b", sym::make_val(0)));
+
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::vector<std::thread> readers;
+
+    for (int t = 0; t < 4; ++t){
+        readers.emplace_back([&](){
+            while (!done.load()){
+                if (ctx.full_eval(f) != 0){
+                    torn += 1;
+                }
+            }
+        });
+    }
+
+    for (int i = 1; i <= 2000; ++i){
+        ctx.update([i](sym::PersistentContext const& c){
+            return c.insert("a", sym::make_val(i)).insert("b", sym::make_val(-i));
+        });
+    }
+
+    done = true;
+    for (auto& t: readers){
+        t.join();
+    }
+
+    EXPECT_EQ(0, torn.load());
+    ctx.collect();
+    EXPECT_EQ(0u, ctx.retired());
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef PROJECT_TEST_TESTS_SOLVER_HEADER
+#define PROJECT_TEST_TESTS_SOLVER_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <solver.h>
+
+#include <cmath>
+#include <vector>
+
+TEST(solver, newton_batched_sqrt)
+{
+    auto x = sym::make_var("x");
+    auto a = sym::make_var("a");
+
+    // x * x - a = 0
+    sym::Solver solver({sym::add(sym::mult(x, x), sym::mult(sym::make_val(-1), a))}, {"x"}, {"a"});
+
+    std::size_t n = 1000;
+    std::vector<double> starts(n, 1.0);
+    std::vector<double> params(n);
+    for (std::size_t i = 0; i < n; ++i){
+        params[i] = 1.0 + double(i);
+    }
+
+    auto result = solver.solve(starts, params, n);
+
+    for (std::size_t i = 0; i < n; ++i){
+        EXPECT_TRUE(result.converged[i]);
+        EXPECT_NEAR(std::sqrt(params[i]), result.x[i], 1e-10);
+    }
+}
+
+TEST(solver, newton_system)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto minus_one = sym::make_val(-1);
+
+    // x * x + y * y - 4 = 0, x - y = 0
+    sym::Solver solver({
+        sym::add(sym::add(sym::mult(x, x), sym::mult(y, y)), sym::make_val(-4)),
+        sym::add(x, sym::mult(minus_one, y))
+    }, {"x", "y"});
+
+    auto result = solver.solve({1, 2, -1, -3}, {}, 2);
+
+    ASSERT_TRUE(result.converged[0]);
+    ASSERT_TRUE(result.converged[1]);
+    EXPECT_NEAR(std::sqrt(2.0), result.x[0], 1e-10);
+    EXPECT_NEAR(std::sqrt(2.0), result.x[1], 1e-10);
+    EXPECT_NEAR(-std::sqrt(2.0), result.x[2], 1e-10);
+    EXPECT_NEAR(-std::sqrt(2.0), result.x[3], 1e-10);
+}
+
+TEST(solver, levenberg_marquardt_least_squares)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+
+    // x - 1, y - 2, x * y - 2: consistent, the minimum is a root
+    sym::Solver solver({
+        sym::add(x, sym::make_val(-1)),
+        sym::add(y, sym::make_val(-2)),
+        sym::add(sym::mult(x, y), sym::make_val(-2))
+    }, {"x", "y"});
+
+    sym::SolverOptions options;
+    options.method = sym::SolverMethod::LevenbergMarquardt;
+    options.max_iterations = 200;
+
+    auto result = solver.solve({5, -3}, {}, 1, options);
+
+    ASSERT_TRUE(result.converged[0]);
+    EXPECT_NEAR(1, result.x[0], 1e-8);
+    EXPECT_NEAR(2, result.x[1], 1e-8);
+
+    // Newton is only defined for square systems
+    EXPECT_THROW(solver.solve({5, -3}, {}, 1), std::invalid_argument);
+}
+
+#endif
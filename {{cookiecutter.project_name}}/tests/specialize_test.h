@@ -0,0 +1,98 @@
+#ifndef PROJECT_TEST_TESTS_SPECIALIZE_HEADER
+#define PROJECT_TEST_TESTS_SPECIALIZE_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <specialize.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+TEST(specialize, matches_full_eval)
+{
+    auto x = sym::make_var("x");
+    auto w = sym::make_var("w");
+    auto b = sym::make_var("b");
+
+    // (w * w + 1) * x + b
+    auto f = sym::add(sym::mult(sym::add(sym::mult(w, w), sym::make_val(1)), x), b);
+    auto spec = sym::specialize(f, {"w", "b"}, {false});
+
+    EXPECT_EQ((std::vector<std::string>{"b", "w"}), spec.bound());
+    EXPECT_EQ((std::vector<std::string>{"x"}), spec.inputs());
+    EXPECT_EQ(2u, spec.hoisted_count());     // w * w + 1 and b
+
+    EXPECT_TRUE(std::isnan(spec.eval(std::vector<double>{1}.data())));
+
+    for (double wv: {0.5, 2.0, -3.0}){
+        for (double bv: {0.0, 1.5}){
+            spec.bind({bv, wv});
+
+            for (double xv: {-1.0, 0.25, 4.0}){
+                sym::Context ctx = {{"x", sym::make_val(xv)}, {"w", sym::make_val(wv)}, {"b", sym::make_val(bv)}};
+                EXPECT_EQ(f->full_eval(ctx), spec.eval(&xv));
+            }
+        }
+    }
+
+    EXPECT_THROW(spec.bind({1.0}), std::invalid_argument);
+}
+
+TEST(specialize, plans_are_cached)
+{
+    sym::clear_specialization_cache();
+
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto f = sym::mult(sym::add(x, y), y);
+
+    auto a = sym::specialize(f, {"y"});
+    auto b = sym::specialize(f, {"y", "y"});
+    EXPECT_EQ(1u, sym::specialization_cache_size());
+
+    // Same plan, independent bindings
+    a.bind({2});
+    b.bind({3});
+    double xv = 1;
+    EXPECT_EQ(6, a.eval(&xv));
+    EXPECT_EQ(12, b.eval(&xv));
+
+    sym::specialize(f, {"x"});
+    sym::specialize(sym::mult(sym::add(x, y), y), {"y"});   // another expression
+    EXPECT_EQ(3u, sym::specialization_cache_size());
+
+    sym::clear_specialization_cache();
+    EXPECT_EQ(0u, sym::specialization_cache_size());
+    EXPECT_EQ(6, a.eval(&xv));
+}
+
+TEST(specialize, fully_bound_and_free)
+{
+    auto x = sym::make_var("x");
+    auto y = sym::make_var("y");
+    auto f = sym::add(sym::mult(x, y), sym::make_val(2));
+
+    auto bound = sym::specialize(f, {"x", "y"});
+    EXPECT_TRUE(bound.inputs().empty());
+    bound.bind({3, 4});
+    EXPECT_EQ(14, bound.eval(nullptr));
+
+    auto free = sym::specialize(f, {});
+    EXPECT_EQ(0u, free.hoisted_count());
+    double point[] = {3, 4};
+    EXPECT_EQ(14, free.eval(point));
+
+    auto columns_f = sym::specialize(f, {"y"});
+    columns_f.bind({10});
+    std::vector<double> xs(1000), out(1000);
+    for (std::size_t i = 0; i < xs.size(); ++i) xs[i] = double(i);
+    const double* columns[] = {xs.data()};
+    columns_f.eval(columns, out.data(), xs.size());
+    for (std::size_t i = 0; i < xs.size(); ++i){
+        EXPECT_EQ(10 * xs[i] + 2, out[i]);
+    }
+}
+
+#endif
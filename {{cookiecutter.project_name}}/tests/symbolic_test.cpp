@@ -1,5 +1,28 @@
+// Before logger.h, its macros would rename the spdlog methods used by logger_test.h
+#include <spdlog/spdlog.h>
+
 #include "mult_test.h"
 #include "add_test.h"
+#include "context_test.h"
+#include "ref_test.h"
+#include "optimize_test.h"
+#include "profiler_test.h"
+#include "compile_test.h"
+#include "gradient_test.h"
+#include "solver_test.h"
+#include "ode_test.h"
+#include "tensor_test.h"
+#include "shared_context_test.h"
+#include "expr_pool_test.h"
+#include "printer_test.h"
+#include "specialize_test.h"
+#include "parallel_test.h"
+#include "ring_buffer_test.h"
+#include "backtrace_test.h"
+#include "crash_handler_test.h"
+#include "flight_recorder_test.h"
+#include "log_limit_test.h"
+#include "logger_test.h"
 
 
 int main(int argc, char **argv)
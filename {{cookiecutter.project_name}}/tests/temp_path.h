@@ -0,0 +1,17 @@
+#ifndef PROJECT_TEST_TESTS_TEMP_PATH_HEADER
+#define PROJECT_TEST_TESTS_TEMP_PATH_HEADER
+
+#include <cstdlib>
+#include <string>
+
+// Path of a scratch file in $TMPDIR, or /tmp when it is not set
+inline std::string temp_path(std::string const& name){
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = dir && *dir ? dir : "/tmp";
+    if (path.back() != '/'){
+        path += '/';
+    }
+    return path + name;
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef PROJECT_TEST_TESTS_TENSOR_HEADER
+#define PROJECT_TEST_TESTS_TENSOR_HEADER
+
+#include <gtest/gtest.h>
+
+#include <symbolic.h>
+#include <tensor.h>
+#include <compile.h>
+
+#include <stdexcept>
+
+static sym::Tensor test_tensor(std::size_t rows, std::size_t cols, double seed){
+    sym::Tensor t(rows, cols);
+    for (std::size_t i = 0; i < rows; ++i){
+        for (std::size_t j = 0; j < cols; ++j){
+            t(i, j) = seed + double((i * 7 + j * 3) % 11) / 4 - double(i % 3);
+        }
+    }
+    return t;
+}
+
+TEST(tensor, blocked_kernels)
+{
+    // Odd sizes that do not fall on block boundaries
+    auto a = test_tensor(131, 67, 0.5);
+    auto b = test_tensor(67, 301, -1);
+    auto c = sym::matmul(a, b);
+
+    ASSERT_EQ(131u, c.rows());
+    ASSERT_EQ(301u, c.cols());
+
+    for (std::size_t i = 0; i < c.rows(); i += 13){
+        for (std::size_t j = 0; j < c.cols(); j += 7){
+            double expected = 0;
+            for (std::size_t p = 0; p < a.cols(); ++p){
+                expected += a(i, p) * b(p, j);
+            }
+            EXPECT_NEAR(expected, c(i, j), 1e-9);
+        }
+    }
+
+    auto t = sym::transpose(a);
+    EXPECT_EQ(a(100, 3), t(3, 100));
+
+    double total = 0;
+    for (std::size_t i = 0; i < a.size(); ++i){
+        total += a.data()[i];
+    }
+    EXPECT_NEAR(total, sym::sum(a), 1e-9);
+}
+
+TEST(tensor, eval_and_gradient)
+{
+    auto W = sym::make_tensor_var("W", 3, 2);
+    auto x = sym::make_tensor_var("x", 2);
+    auto y = sym::make_tensor_var("y", 3);
+
+    // ||W x - y||^2
+    auto r = sym::add(sym::matmul(W, x), sym::mult(sym::make_val(-1), y));
+    auto loss = sym::sum(sym::mult(r, r));
+
+    sym::Tensor w(3, 2, {1, 2, 3, 4, 5, 6});
+    sym::Tensor xv(2, 1, {1, -1});
+    sym::Tensor yv(3, 1, {0, 1, 2});
+
+    sym::Context ctx = {
+        {"W", sym::make_tensor(w)},
+        {"x", sym::make_tensor(xv)},
+        {"y", sym::make_tensor(yv)}
+    };
+
+    // W x - y = (-1, -2, -3)
+    EXPECT_DOUBLE_EQ(14, loss->full_eval(ctx));
+    EXPECT_EQ((sym::Shape{3, 1}), r->shape());
+    EXPECT_THROW(r->full_eval(ctx), std::invalid_argument);
+
+    // d/dW = 2 (W x - y) x'
+    auto grad = loss->derivate("W")->tensor_eval(ctx);
+    ASSERT_EQ((sym::Shape{3, 2}), grad.shape());
+    double residual[] = {-1, -2, -3};
+    for (std::size_t i = 0; i < 3; ++i){
+        for (std::size_t j = 0; j < 2; ++j){
+            EXPECT_DOUBLE_EQ(2 * residual[i] * xv(j, 0), grad(i, j));
+        }
+    }
+
+    // d/dx = 2 W' (W x - y)
+    auto gx = loss->derivate("x")->tensor_eval(ctx);
+    ASSERT_EQ((sym::Shape{2, 1}), gx.shape());
+    EXPECT_DOUBLE_EQ(2 * (1 * -1 + 3 * -2 + 5 * -3), gx(0, 0));
+    EXPECT_DOUBLE_EQ(2 * (2 * -1 + 4 * -2 + 6 * -3), gx(1, 0));
+
+    // Mixed with scalar expressions
+    auto s = sym::make_var("s");
+    auto f = sym::mult(s, loss);
+    ctx["s"] = sym::make_val(3);
+    EXPECT_DOUBLE_EQ(42, f->full_eval(ctx));
+    EXPECT_DOUBLE_EQ(14, f->derivate("s")->full_eval(ctx));
+    EXPECT_DOUBLE_EQ(3 * grad(2, 1), f->derivate("W")->tensor_eval(ctx)(2, 1));
+}
+
+TEST(tensor, elementwise_derivative)
+{
+    auto W = sym::make_tensor_var("W", 2, 2);
+    auto s = sym::make_var("s");
+
+    // d/ds sum(s * s * W) = 2 s sum(W)
+    auto f = sym::sum(sym::mult(sym::mult(s, s), W));
+    sym::Context ctx = {
+        {"W", sym::make_tensor(sym::Tensor(2, 2, {1, 2, 3, 4}))},
+        {"s", sym::make_val(0.5)}
+    };
+
+    EXPECT_DOUBLE_EQ(10, f->derivate("s")->full_eval(ctx));
+    EXPECT_EQ((sym::Shape{2, 2}), sym::mult(s, W)->derivate("s")->shape());
+}
+
+TEST(tensor, errors)
+{
+    auto A = sym::make_tensor_var("A", 3, 2);
+    auto B = sym::make_tensor_var("B", 3, 2);
+
+    EXPECT_THROW(sym::matmul(A, B), std::invalid_argument);
+    EXPECT_THROW(sym::add(A, sym::transpose(B)), std::invalid_argument);
+    EXPECT_THROW(sym::add(A, B)->derivate("A"), std::invalid_argument);
+
+    sym::Context ctx = {{"A", sym::make_tensor(sym::Tensor(2, 3))}};
+    EXPECT_THROW(A->tensor_eval(ctx), std::invalid_argument);
+
+    // Tensor nodes are not lowered to scalar programs
+    EXPECT_THROW(sym::compile(sym::sum(A), {"A"}), std::invalid_argument);
+}
+
+#endif
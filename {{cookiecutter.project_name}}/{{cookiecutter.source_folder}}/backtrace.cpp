@@ -0,0 +1,179 @@
+#include "backtrace.h"
+
+#include <spdlog/fmt/bundled/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <elf.h>
+#include <link.h>
+#endif
+
+namespace sym{
+
+namespace {
+std::mutex symbol_lock;
+std::unordered_map<void*, std::string> symbol_cache;
+bool line_info = false;
+}
+
+#ifdef __linux__
+namespace {
+// The first call of backtrace() loads libgcc and allocates, do it before it matters
+[[maybe_unused]] const int backtrace_ready = [](){
+    void* frames[1];
+    return backtrace(frames, 1);
+}();
+
+std::string demangle(const char* name){
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || !demangled){
+        return name;
+    }
+    std::string result(demangled);
+    std::free(demangled);
+    return result;
+}
+
+const char* basename(const char* path){
+    const char* slash = std::strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+std::string resolve(void* address, bool lines){
+    Dl_info info;
+    if (!dladdr(address, &info) || !info.dli_fname){
+        return "??";
+    }
+
+    std::uintptr_t pc = reinterpret_cast<std::uintptr_t>(address);
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(info.dli_fbase);
+    std::string function;
+    std::string location;
+
+    if (info.dli_sname){
+        function = fmt::format("{}+0x{:x}", demangle(info.dli_sname), pc - reinterpret_cast<std::uintptr_t>(info.dli_saddr));
+    }
+
+    if (lines){
+        // Shared objects and PIE are looked up by offset, plain executables by address.
+        // The return address is after the call, step back into it for the line
+        auto header = static_cast<const ElfW(Ehdr)*>(info.dli_fbase);
+        std::uintptr_t lookup = (header->e_type == ET_EXEC ? pc : pc - base) - 1;
+
+        auto [name, line] = addr2line(info.dli_fname, lookup);
+        if (function.empty() && !name.empty()){
+            function = name;
+        }
+        location = line;
+    }
+
+    if (function.empty()){
+        function = fmt::format("{}+0x{:x}", basename(info.dli_fname), pc - base);
+    }
+    if (!location.empty()){
+        return fmt::format("{} at {} ({})", function, location, basename(info.dli_fname));
+    }
+    return fmt::format("{} ({})", function, basename(info.dli_fname));
+}
+}
+
+std::pair<std::string, std::string> addr2line(const char* module, std::uintptr_t address){
+    std::string command = fmt::format("addr2line -C -f -e '{}' 0x{:x} 2>/dev/null", module, address);
+    std::FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe){
+        return {};
+    }
+
+    char function[1024] = {0};
+    char location[1024] = {0};
+    bool ok = std::fgets(function, sizeof(function), pipe) && std::fgets(location, sizeof(location), pipe);
+    pclose(pipe);
+    if (!ok){
+        return {};
+    }
+
+    function[std::strcspn(function, "\n")] = '\0';
+    location[std::strcspn(location, "\n")] = '\0';
+
+    std::pair<std::string, std::string> result;
+    if (std::strcmp(function, "??") != 0){
+        result.first = function;
+    }
+    if (std::strncmp(location, "??", 2) != 0){
+        result.second = location;
+    }
+    return result;
+}
+
+// Not inlined so the frame of capture_stack_trace itself is always the first one
+__attribute__((noinline)) StackTrace capture_stack_trace(std::size_t skip){
+    constexpr std::size_t max_skip = 8;
+    skip = std::min(skip, max_skip) + 1;
+
+    void* frames[StackTrace::capacity + max_skip + 1];
+    std::size_t n = std::size_t(backtrace(frames, int(StackTrace::capacity + skip)));
+
+    StackTrace trace;
+    if (n > skip){
+        trace.size = n - skip;
+        std::copy(frames + skip, frames + n, trace.frames);
+    }
+    return trace;
+}
+#else
+StackTrace capture_stack_trace(std::size_t){
+    return StackTrace();
+}
+
+std::pair<std::string, std::string> addr2line(const char*, std::uintptr_t){
+    return {};
+}
+
+namespace {
+std::string resolve(void*, bool){
+    return "??";
+}
+}
+#endif
+
+std::string symbolize(void* address){
+    std::lock_guard<std::mutex> guard(symbol_lock);
+    auto it = symbol_cache.find(address);
+    if (it == symbol_cache.end()){
+        it = symbol_cache.emplace(address, resolve(address, line_info)).first;
+    }
+    return it->second;
+}
+
+std::string format_stack_trace(StackTrace const& trace){
+    std::string text;
+    for (std::size_t i = 0; i < trace.size; ++i){
+        text += fmt::format("#{:<2} {} {}\n", i, trace.frames[i], symbolize(trace.frames[i]));
+    }
+    return text;
+}
+
+void enable_line_info(bool enabled){
+    std::lock_guard<std::mutex> guard(symbol_lock);
+    if (line_info != enabled){
+        line_info = enabled;
+        symbol_cache.clear();
+    }
+}
+
+std::size_t symbol_cache_size(){
+    std::lock_guard<std::mutex> guard(symbol_lock);
+    return symbol_cache.size();
+}
+}
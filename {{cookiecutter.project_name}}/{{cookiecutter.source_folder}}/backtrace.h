@@ -0,0 +1,55 @@
+#ifndef PROJECT_TEST_SRC_BACKTRACE_HEADER
+#define PROJECT_TEST_SRC_BACKTRACE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace sym
+{
+
+/*!
+ * \brief Return addresses of a thread, captured in fixed storage.
+ *
+ * Capturing only walks the stack: nothing is allocated and no symbol is resolved,
+ * it costs a few microseconds. Names are resolved later by symbolize(), which keeps
+ * every address it has resolved in a process wide cache.
+ *
+ * \code
+ *  StackTrace trace = capture_stack_trace();
+ *  ...
+ *  std::string text = format_stack_trace(trace);  // only when it is shown
+ * \endcode
+ */
+struct StackTrace{
+    static constexpr std::size_t capacity = 32;
+
+    void* frames[capacity];
+    std::size_t size = 0;
+};
+
+// Return addresses of the caller, innermost first, the `skip` innermost frames are dropped
+StackTrace capture_stack_trace(std::size_t skip = 0);
+
+// "function+0x1c (module)" of a return address, with " at file:line" when line info is
+// enabled. Uses dladdr and the demangler, the result is cached
+std::string symbolize(void* address);
+
+// One "#i 0xaddress symbol" line per frame
+std::string format_stack_trace(StackTrace const& trace);
+
+// Resolve files and lines by running addr2line on the module of the frames, off by default.
+// Also names the functions dladdr cannot see (static functions, executables without -rdynamic)
+void enable_line_info(bool enabled);
+
+// Function and "file:line" of `address` in `module` using addr2line, empty when unknown.
+// `address` is an offset from the load address for shared objects and PIE
+std::pair<std::string, std::string> addr2line(const char* module, std::uintptr_t address);
+
+// Addresses resolved so far
+std::size_t symbol_cache_size();
+
+}
+
+#endif
@@ -0,0 +1,685 @@
+#include <spdlog/details/os.h>
+
+#include "binary_log.h"
+#include "crash_handler.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sym{
+
+// Call sites
+// --------------------------------------------
+// Shared by every binary log so an id stays valid when logging is enabled again.
+// Stored in fixed chunks that never move, they can be read without the lock
+namespace {
+constexpr std::size_t site_chunk_size = 256;
+constexpr std::size_t site_chunk_count = 1024;
+
+std::mutex site_lock;
+std::atomic<LogSiteInfo*> site_chunks[site_chunk_count];
+std::atomic<std::uint32_t> site_count{0};
+}
+
+std::uint32_t log_site_id(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt){
+    std::uint32_t id = site.id.load(std::memory_order_acquire);
+    if (id != 0){
+        return id;
+    }
+
+    std::lock_guard<std::mutex> guard(site_lock);
+    id = site.id.load(std::memory_order_relaxed);
+    if (id != 0){
+        return id;
+    }
+
+    std::uint32_t index = site_count.load(std::memory_order_relaxed);
+    if (index >= site_chunk_size * site_chunk_count){
+        throw std::length_error("too many log call sites");
+    }
+
+    std::atomic<LogSiteInfo*>& chunk = site_chunks[index / site_chunk_size];
+    if (!chunk.load(std::memory_order_relaxed)){
+        chunk.store(new LogSiteInfo[site_chunk_size], std::memory_order_release);
+    }
+    chunk.load(std::memory_order_relaxed)[index % site_chunk_size] = {level, &loc, fmt};
+
+    id = index + 1;
+    site_count.store(id, std::memory_order_release);
+    site.id.store(id, std::memory_order_release);
+    return id;
+}
+
+LogSiteInfo const* find_log_site(std::uint32_t id){
+    if (id == 0 || id > site_count.load(std::memory_order_acquire)){
+        return nullptr;
+    }
+    std::uint32_t index = id - 1;
+    return site_chunks[index / site_chunk_size].load(std::memory_order_acquire) + index % site_chunk_size;
+}
+
+std::uint32_t log_site_count(){
+    return site_count.load(std::memory_order_acquire);
+}
+
+// File layout
+// --------------------------------------------
+//  magic "SYMBLOG1", uint64 steady clock (ns), uint64 wall clock (ns since epoch)
+//  then entries:
+//      Site:   uint32 id, uint8 level, uint32 line, string file, string function, string format
+//      Chunk:  uint64 thread, uint32 size, messages logged by the thread
+//  message: varint site, varint time, tagged arguments, LogArg::End
+//
+// The time of a message is (ns since the previous message of the thread buffer) << 1,
+// or (steady clock in ns) << 1 | 1 for the first message of a buffer
+//
+// A site entry is always written before the chunks using it
+namespace {
+constexpr char binary_magic[8] = {'S', 'Y', 'M', 'B', 'L', 'O', 'G', '1'};
+
+enum class Entry: std::uint8_t{
+    Site = 1,
+    Chunk = 2
+};
+
+std::uint64_t steady_ns(){
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::uint64_t wall_ns(){
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+template<typename T>
+void put(std::string& out, T value){
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void put_string(std::string& out, std::string_view str){
+    put(out, std::uint32_t(str.size()));
+    out.append(str.data(), str.size());
+}
+
+// Messages of one thread, the thread writes at head and the writer reads at tail
+struct ThreadBuffer{
+    ThreadBuffer(std::size_t capacity, std::uint64_t thread):
+        data(new char[capacity]), capacity(capacity), thread(thread)
+    {}
+
+    std::unique_ptr<char[]> data;
+    const std::size_t capacity;
+    const std::uint64_t thread;
+
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    std::atomic<bool> retired{false};       // the thread will not write anymore
+};
+
+class BinaryLog
+{
+public:
+    BinaryLog(const std::string& path, std::size_t thread_buffer):
+        _file(std::fopen(path.c_str(), "wb")),
+        _thread_buffer(std::clamp<std::size_t>(thread_buffer, 4096, std::size_t(1) << 30))
+    {
+        if (!_file){
+            throw std::runtime_error("cannot open binary log " + path);
+        }
+
+        std::string header(binary_magic, sizeof(binary_magic));
+        put(header, steady_ns());
+        put(header, wall_ns());
+        std::fwrite(header.data(), 1, header.size(), _file);
+
+        _writer = std::thread([this](){ run(); });
+    }
+
+    ~BinaryLog(){
+        close();
+    }
+
+    void close(){
+        if (_closed.exchange(true)){
+            return;
+        }
+        wake();
+        _writer.join();
+
+        drain();
+        std::lock_guard<std::mutex> guard(_drain_lock);
+        std::fclose(_file);
+        _file = nullptr;
+    }
+
+    ThreadBuffer* attach(){
+        auto buffer = std::make_unique<ThreadBuffer>(_thread_buffer, spdlog::details::os::thread_id());
+        ThreadBuffer* ptr = buffer.get();
+
+        std::lock_guard<std::mutex> guard(_lock);
+        _buffers.push_back(std::move(buffer));
+        return ptr;
+    }
+
+    bool commit(ThreadBuffer& buffer, std::string const& record){
+        std::size_t n = record.size();
+        if (n > buffer.capacity){
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Wait for the writer when the buffer is full
+        std::size_t head = buffer.head.load(std::memory_order_relaxed);
+        while (buffer.capacity - (head - buffer.tail.load(std::memory_order_acquire)) < n){
+            if (_closed.load(std::memory_order_relaxed)){
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wake();
+            std::this_thread::yield();
+        }
+
+        std::size_t at = head % buffer.capacity;
+        std::size_t first = std::min(n, buffer.capacity - at);
+        std::memcpy(buffer.data.get() + at, record.data(), first);
+        std::memcpy(buffer.data.get(), record.data() + first, n - first);
+        buffer.head.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    // Move the content of the thread buffers to the file
+    void drain(){
+        std::lock_guard<std::mutex> drain_guard(_drain_lock);
+        if (!_file){
+            return;
+        }
+
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (auto& buffer: _buffers){
+                buffers.push_back(buffer.get());
+            }
+        }
+
+        _chunks.clear();
+        for (ThreadBuffer* buffer: buffers){
+            std::size_t head = buffer->head.load(std::memory_order_acquire);
+            std::size_t tail = buffer->tail.load(std::memory_order_relaxed);
+            if (head == tail){
+                continue;
+            }
+
+            std::size_t n = head - tail;
+            std::size_t at = tail % buffer->capacity;
+            std::size_t first = std::min(n, buffer->capacity - at);
+
+            _chunks.push_back(char(Entry::Chunk));
+            put(_chunks, buffer->thread);
+            put(_chunks, std::uint32_t(n));
+            _chunks.append(buffer->data.get() + at, first);
+            _chunks.append(buffer->data.get(), n - first);
+
+            buffer->tail.store(head, std::memory_order_release);
+        }
+
+        // The sites are read after the chunks, every message copied above has its site registered
+        std::string header;
+        for (std::uint32_t count = log_site_count(); _sites_written < count; ++_sites_written){
+            LogSiteInfo const& site = *find_log_site(std::uint32_t(_sites_written + 1));
+            header.push_back(char(Entry::Site));
+            put(header, std::uint32_t(_sites_written + 1));
+            put(header, std::uint8_t(site.level));
+            put(header, std::uint32_t(site.loc->line));
+            put_string(header, site.loc->filename);
+            put_string(header, site.loc->function_name);
+            put_string(header, site.format);
+        }
+
+        std::fwrite(header.data(), 1, header.size(), _file);
+        std::fwrite(_chunks.data(), 1, _chunks.size(), _file);
+        std::fflush(_file);
+
+        // Forget the buffers of the threads that exited
+        std::lock_guard<std::mutex> guard(_lock);
+        _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(), [](auto& buffer){
+            return buffer->retired.load(std::memory_order_acquire) &&
+                   buffer->head.load(std::memory_order_acquire) == buffer->tail.load(std::memory_order_relaxed);
+        }), _buffers.end());
+    }
+
+    std::size_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void wake(){
+        std::lock_guard<std::mutex> guard(_wake_lock);
+        _pending = true;
+        _wake.notify_one();
+    }
+
+    void run(){
+        // A crash of the writer is reported by the crash handler
+        enable_crash_stack();
+
+        for (;;){
+            {
+                std::unique_lock<std::mutex> guard(_wake_lock);
+                _wake.wait_for(guard, std::chrono::milliseconds(10), [&](){ return _pending; });
+                _pending = false;
+            }
+            if (_closed.load()){
+                return;
+            }
+            drain();
+        }
+    }
+
+    std::FILE* _file;
+    const std::size_t _thread_buffer;
+    std::atomic<std::size_t> _dropped{0};
+    std::atomic<bool> _closed{false};
+
+    std::mutex _lock;                   // _buffers
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+
+    std::mutex _drain_lock;             // the file and everything below
+    std::size_t _sites_written = 0;
+    std::string _chunks;
+
+    std::mutex _wake_lock;
+    std::condition_variable _wake;
+    bool _pending = false;
+    std::thread _writer;
+};
+
+// Logs are kept until exit, a thread racing with disable_binary_logging() can still write to its buffer
+std::mutex binary_lock;
+std::vector<std::unique_ptr<BinaryLog>> binary_logs;
+std::atomic<BinaryLog*> binary_current{nullptr};
+
+struct ThreadState{
+    BinaryLog* log = nullptr;
+    ThreadBuffer* buffer = nullptr;
+    std::string scratch;                // reused by every message of the thread
+    std::uint64_t last_time = 0;        // of the last message in `buffer`, 0 before the first
+    std::uint64_t time = 0;             // of the message being written
+
+    ~ThreadState(){
+        if (buffer){
+            buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadState thread_state;
+}
+
+void enable_binary_logging(const std::string& path, std::size_t thread_buffer){
+    std::lock_guard<std::mutex> guard(binary_lock);
+    BinaryLog* previous = binary_current.exchange(nullptr);
+    if (previous){
+        previous->close();
+    }
+
+    binary_logs.push_back(std::make_unique<BinaryLog>(path, thread_buffer));
+    binary_current.store(binary_logs.back().get(), std::memory_order_release);
+    binary_logging.store(true, std::memory_order_release);
+}
+
+void disable_binary_logging(){
+    std::lock_guard<std::mutex> guard(binary_lock);
+    binary_logging.store(false, std::memory_order_release);
+    BinaryLog* log = binary_current.exchange(nullptr);
+    if (log){
+        log->close();
+    }
+}
+
+void flush_binary_log(){
+    BinaryLog* log = binary_current.load(std::memory_order_acquire);
+    if (log){
+        log->drain();
+    }
+}
+
+std::size_t dropped_binary_messages(){
+    std::lock_guard<std::mutex> guard(binary_lock);
+    std::size_t dropped = 0;
+    for (auto& log: binary_logs){
+        dropped += log->dropped();
+    }
+    return dropped;
+}
+
+std::string& begin_binary_record(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt){
+    std::uint32_t id = log_site_id(site, level, loc, fmt);
+
+    ThreadState& state = thread_state;
+    BinaryLog* log = binary_current.load(std::memory_order_acquire);
+    if (log && state.log != log){
+        if (state.buffer){
+            state.buffer->retired.store(true, std::memory_order_release);
+        }
+        state.buffer = log->attach();
+        state.log = log;
+        state.last_time = 0;
+    }
+
+    state.time = steady_ns();
+    std::string& out = state.scratch;
+    out.clear();
+    put_log_varint(out, id);
+    if (state.last_time == 0){
+        put_log_varint(out, (state.time << 1) | 1);
+    } else {
+        put_log_varint(out, (state.time - state.last_time) << 1);
+    }
+    return out;
+}
+
+void commit_binary_record(std::string const& record){
+    ThreadState& state = thread_state;
+    if (state.buffer && state.log->commit(*state.buffer, record)){
+        state.last_time = state.time;
+    }
+}
+
+// Decoder
+// --------------------------------------------
+namespace {
+class ByteReader
+{
+public:
+    ByteReader(const char* begin, const char* end):
+        _pos(begin), _end(end)
+    {}
+
+    bool done() const { return _pos == _end; }
+
+    template<typename T>
+    T read(){
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::uint64_t read_varint(){
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7){
+            std::uint8_t byte = read<std::uint8_t>();
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)){
+                return value;
+            }
+        }
+        throw std::runtime_error("corrupted varint in binary log");
+    }
+
+    std::string_view read_string(){
+        std::uint32_t n = read<std::uint32_t>();
+        return std::string_view(take(n), n);
+    }
+
+    std::string_view read_arg_string(){
+        std::size_t n = read_varint();
+        return std::string_view(take(n), n);
+    }
+
+    ByteReader sub(std::size_t n){
+        const char* begin = take(n);
+        return ByteReader(begin, begin + n);
+    }
+
+private:
+    const char* take(std::size_t n){
+        if (std::size_t(_end - _pos) < n){
+            throw std::runtime_error("truncated binary log");
+        }
+        const char* begin = _pos;
+        _pos += n;
+        return begin;
+    }
+
+    const char* _pos;
+    const char* _end;
+};
+
+struct DecodedSite{
+    LogLevel level;
+    std::uint32_t line;
+    std::string_view file;
+    std::string_view function;
+    std::string_view format;
+};
+
+struct DecodedArg{
+    LogArg tag;
+    std::int64_t i = 0;
+    std::uint64_t u = 0;
+    double d = 0;
+    std::string_view s;
+};
+
+struct DecodedMessage{
+    std::uint64_t time;
+    std::string text;
+};
+
+constexpr char level_letter[] = {'T', 'D', 'I', 'W', 'E', 'C', 'O'};
+
+std::string format_arg(std::string const& spec, DecodedArg const& arg){
+    try {
+        switch (arg.tag){
+        case LogArg::Int:       return fmt::format(spec, arg.i);
+        case LogArg::UInt:      return fmt::format(spec, arg.u);
+        case LogArg::Double:    return fmt::format(spec, arg.d);
+        case LogArg::Bool:      return fmt::format(spec, arg.u != 0);
+        case LogArg::Char:      return fmt::format(spec, char(arg.i));
+        case LogArg::String:    return fmt::format(spec, fmt::string_view(arg.s.data(), arg.s.size()));
+        case LogArg::Pointer:   return fmt::format(spec, reinterpret_cast<const void*>(std::uintptr_t(arg.u)));
+        case LogArg::End:       break;
+        }
+    } catch (fmt::format_error const&){
+    }
+    return spec;
+}
+
+// Replacement fields are "{}", "{index}" and "{index:spec}", nested fields are not supported
+void format_message(std::string& out, std::string_view format, std::vector<DecodedArg> const& args){
+    std::size_t next = 0;
+
+    for (std::size_t i = 0; i < format.size(); ++i){
+        char c = format[i];
+        bool doubled = i + 1 < format.size() && format[i + 1] == c;
+
+        if ((c == '{' || c == '}') && doubled){
+            out.push_back(c);
+            i += 1;
+            continue;
+        }
+
+        std::size_t end = format.find('}', i);
+        if (c != '{' || end == std::string_view::npos){
+            out.push_back(c);
+            continue;
+        }
+
+        std::string_view field = format.substr(i + 1, end - i - 1);
+        std::size_t colon = std::min(field.find(':'), field.size());
+
+        std::size_t k = next++;
+        if (colon > 0){
+            std::from_chars(field.data(), field.data() + colon, k);
+        }
+
+        std::string spec = "{" + std::string(field.substr(colon)) + "}";
+        out += k < args.size() ? format_arg(spec, args[k]) : spec;
+        i = end;
+    }
+}
+
+// Arguments up to End, or up to the end of the reader for a record cut at an argument boundary
+void read_args(ByteReader& reader, std::vector<DecodedArg>& args){
+    while (!reader.done()){
+        LogArg tag = LogArg(reader.read<std::uint8_t>());
+        if (tag == LogArg::End){
+            return;
+        }
+
+        DecodedArg arg;
+        arg.tag = tag;
+
+        switch (tag){
+        case LogArg::Int: {
+            std::uint64_t v = reader.read_varint();
+            arg.i = std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+            break;
+        }
+        case LogArg::UInt:      arg.u = reader.read_varint(); break;
+        case LogArg::Double:    arg.d = reader.read<double>(); break;
+        case LogArg::Bool:      arg.u = reader.read<std::uint8_t>(); break;
+        case LogArg::Char:      arg.i = reader.read<char>(); break;
+        case LogArg::String:    arg.s = reader.read_arg_string(); break;
+        case LogArg::Pointer:   arg.u = reader.read_varint(); break;
+        default:
+            throw std::runtime_error("unknown argument type in binary log");
+        }
+        args.push_back(arg);
+    }
+}
+
+// Same pattern as the text logs
+void format_line(std::string& out, LogLevel level, std::uint64_t wall_ns, std::uint64_t thread,
+                 std::string_view file, std::uint32_t line, std::string_view function,
+                 std::string_view format, std::vector<DecodedArg> const& args){
+    std::time_t seconds = std::time_t(wall_ns / 1000000000ull);
+    std::tm tm;
+    localtime_r(&seconds, &tm);
+
+    char date[32];
+    std::strftime(date, sizeof(date), "%d-%m-%Y %H:%M:%S", &tm);
+
+    out += fmt::format("[{}] [{}.{:03}] [{}] {}:{} {} - ",
+        level_letter[std::min(int(level), int(LogLevel::OFF))], date, (wall_ns / 1000000ull) % 1000, thread,
+        file, line, function);
+    format_message(out, format, args);
+}
+
+void decode_chunk(ByteReader chunk, std::uint64_t thread, std::uint64_t& steady, std::uint64_t steady0, std::uint64_t wall0,
+                  std::vector<DecodedSite> const& sites, std::vector<DecodedMessage>& messages){
+    std::vector<DecodedArg> args;
+
+    while (!chunk.done()){
+        std::uint64_t id = chunk.read_varint();
+        std::uint64_t delta = chunk.read_varint();
+        steady = (delta & 1) ? (delta >> 1) : steady + (delta >> 1);
+        std::uint64_t time = wall0 + std::uint64_t(std::int64_t(steady - steady0));
+
+        if (id == 0 || id > sites.size()){
+            throw std::runtime_error("binary log message from an unknown call site");
+        }
+        DecodedSite const& site = sites[id - 1];
+
+        args.clear();
+        read_args(chunk, args);
+
+        DecodedMessage message{time, {}};
+        format_line(message.text, site.level, time, thread, site.file, site.line, site.function, site.format, args);
+        messages.push_back(std::move(message));
+    }
+}
+}
+
+std::string format_log_args(std::string_view format, std::string_view args){
+    ByteReader reader(args.data(), args.data() + args.size());
+    std::vector<DecodedArg> decoded;
+    read_args(reader, decoded);
+
+    std::string out;
+    format_message(out, format, decoded);
+    return out;
+}
+
+std::string format_log_line(LogLevel level, std::uint64_t wall_ns, std::uint64_t thread,
+                            std::string_view file, std::uint32_t line, std::string_view function,
+                            std::string_view format, std::string_view args){
+    ByteReader reader(args.data(), args.data() + args.size());
+    std::vector<DecodedArg> decoded;
+    read_args(reader, decoded);
+
+    std::string out;
+    format_line(out, level, wall_ns, thread, file, line, function, format, decoded);
+    return out;
+}
+
+void decode_binary_log(std::istream& in, std::ostream& out){
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(binary_magic) || std::memcmp(data.data(), binary_magic, sizeof(binary_magic)) != 0){
+        throw std::runtime_error("not a binary log");
+    }
+
+    ByteReader reader(data.data() + sizeof(binary_magic), data.data() + data.size());
+    std::uint64_t steady0 = reader.read<std::uint64_t>();
+    std::uint64_t wall0 = reader.read<std::uint64_t>();
+
+    std::vector<DecodedSite> sites;
+    std::vector<DecodedMessage> messages;
+    std::unordered_map<std::uint64_t, std::uint64_t> thread_time;  // steady clock of the last message
+
+    while (!reader.done()){
+        switch (Entry(reader.read<std::uint8_t>())){
+        case Entry::Site: {
+            std::uint32_t id = reader.read<std::uint32_t>();
+            DecodedSite site;
+            site.level = LogLevel(std::min<int>(reader.read<std::uint8_t>(), int(LogLevel::OFF)));
+            site.line = reader.read<std::uint32_t>();
+            site.file = reader.read_string();
+            site.function = reader.read_string();
+            site.format = reader.read_string();
+
+            if (id != sites.size() + 1){
+                throw std::runtime_error("binary log call sites out of order");
+            }
+            sites.push_back(site);
+            break;
+        }
+        case Entry::Chunk: {
+            std::uint64_t thread = reader.read<std::uint64_t>();
+            std::uint32_t size = reader.read<std::uint32_t>();
+            decode_chunk(reader.sub(size), thread, thread_time[thread], steady0, wall0, sites, messages);
+            break;
+        }
+        default:
+            throw std::runtime_error("corrupted binary log");
+        }
+    }
+
+    // Chunks of different threads overlap in time
+    std::stable_sort(messages.begin(), messages.end(), [](auto const& a, auto const& b){
+        return a.time < b.time;
+    });
+
+    for (auto const& message: messages){
+        out << message.text << '\n';
+    }
+}
+}
@@ -0,0 +1,181 @@
+#ifndef PROJECT_TEST_SRC_BINARY_LOG_HEADER
+#define PROJECT_TEST_SRC_BINARY_LOG_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <type_traits>
+// Do not include spdlog directly
+// only use the fmt header
+#include <spdlog/fmt/bundled/core.h>
+
+namespace sym
+{
+
+struct CodeLocation;
+enum class LogLevel;
+
+/*!
+ * \brief Deferred formatting log, the messages are formatted by an offline decoder.
+ *
+ * A log call only writes the id of its call site, a timestamp and the raw bytes of its
+ * arguments in a buffer owned by the thread. The level, location and format string of a
+ * call site are written once to the file, when the site logs for the first time.
+ * A background thread moves the thread buffers to the file in chunks.
+ *
+ * Arithmetic values, enums, pointers and strings are stored in binary, integers and times
+ * as variable length integers, other types are formatted with "{}" by the log call.
+ * Doubles use the byte order of the machine that wrote the file.
+ *
+ * \code
+ *  enable_binary_logging("run.binlog");
+ *  info("x = {:.3f}", x);                  // ~ tens of ns
+ *  disable_binary_logging();
+ *
+ *  $ log_decode run.binlog
+ * \endcode
+ */
+
+// Id of a call site in the binary log, one per log macro in static storage.
+// The format string must be the same at every call of a site
+struct LogSite{
+    std::atomic<std::uint32_t> id{0};       // 0 until registered
+};
+
+// Tag written before each argument, integers are stored as variable length integers
+enum class LogArg: std::uint8_t{
+    End,
+    Int,        // zigzag varint
+    UInt,       // varint
+    Double,     // 8 bytes
+    Bool,       // 1 byte
+    Char,       // 1 byte
+    String,     // varint size + bytes
+    Pointer     // varint
+};
+
+// What the log files record of a call site
+struct LogSiteInfo{
+    LogLevel level;
+    CodeLocation const* loc;
+    const char* format;
+};
+
+// Id of `site`, registered on first use. Ids start at 1 and are never reused
+std::uint32_t log_site_id(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt);
+
+// Call site of `id`, null if unknown. Lock free and async-signal-safe
+LogSiteInfo const* find_log_site(std::uint32_t id);
+
+// Call sites registered so far, their ids are 1 to log_site_count()
+std::uint32_t log_site_count();
+
+// True between enable_binary_logging() and disable_binary_logging()
+inline std::atomic<bool> binary_logging{false};
+
+// Send the log macros to `path` instead of the spdlog sinks,
+// `thread_buffer` is the size in bytes of the buffer of each logging thread
+void enable_binary_logging(const std::string& path, std::size_t thread_buffer = std::size_t(1) << 20);
+
+// Write the buffered messages, close the file and go back to text logging
+void disable_binary_logging();
+
+// Write the messages logged before the call to the file
+void flush_binary_log();
+
+// Messages too large for a thread buffer
+std::size_t dropped_binary_messages();
+
+// Rebuild the text of a binary log, one line per message sorted by time.
+// Throws std::runtime_error if `in` is not a binary log
+void decode_binary_log(std::istream& in, std::ostream& out);
+
+// Text of a message from its format string and encoded arguments. The arguments can
+// stop before End, the missing fields are left as they are in the format string
+std::string format_log_args(std::string_view format, std::string_view args);
+
+// Same line as the text logs: "[L] [date.ms] [thread] file:line function - message"
+std::string format_log_line(LogLevel level, std::uint64_t wall_ns, std::uint64_t thread,
+                            std::string_view file, std::uint32_t line, std::string_view function,
+                            std::string_view format, std::string_view args);
+
+// Start a record in the scratch buffer of the thread: site id and time since the
+// previous message of the thread. Registers the site on first use
+std::string& begin_binary_record(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt);
+
+// Copy a finished record to the thread buffer
+void commit_binary_record(std::string const& record);
+
+// 7 bits per byte, the high bit is set on every byte but the last
+inline void put_log_varint(std::string& out, std::uint64_t value){
+    char bytes[10];
+    std::size_t n = 0;
+    while (value >= 0x80){
+        bytes[n++] = char(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = char(value);
+    out.append(bytes, n);
+}
+
+template<typename T>
+void put_log_value(std::string& out, LogArg tag, T value){
+    out.push_back(char(tag));
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void put_log_string(std::string& out, std::string_view str){
+    out.push_back(char(LogArg::String));
+    put_log_varint(out, str.size());
+    out.append(str.data(), str.size());
+}
+
+template<typename T>
+void encode_log_arg(std::string& out, T const& value){
+    using U = std::decay_t<T>;
+
+    if constexpr (std::is_same_v<U, bool>){
+        put_log_value(out, LogArg::Bool, std::uint8_t(value));
+    } else if constexpr (std::is_same_v<U, char>){
+        put_log_value(out, LogArg::Char, value);
+    } else if constexpr (std::is_enum_v<U>){
+        encode_log_arg(out, std::underlying_type_t<U>(value));
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>){
+        std::int64_t v = value;
+        out.push_back(char(LogArg::Int));
+        put_log_varint(out, (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63));
+    } else if constexpr (std::is_integral_v<U>){
+        out.push_back(char(LogArg::UInt));
+        put_log_varint(out, value);
+    } else if constexpr (std::is_floating_point_v<U>){
+        put_log_value(out, LogArg::Double, double(value));
+    } else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_extent_t<T>, char>){
+        put_log_string(out, std::string_view(value));
+    } else if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>){
+        put_log_string(out, value ? std::string_view(value) : std::string_view("(null)"));
+    } else if constexpr (std::is_convertible_v<T const&, std::string_view>){
+        put_log_string(out, std::string_view(value));
+    } else if constexpr (std::is_same_v<U, fmt::string_view>){
+        put_log_string(out, std::string_view(value.data(), value.size()));
+    } else if constexpr (std::is_pointer_v<U>){
+        out.push_back(char(LogArg::Pointer));
+        put_log_varint(out, reinterpret_cast<std::uintptr_t>(value));
+    } else {
+        put_log_string(out, fmt::format("{}", value));
+    }
+}
+
+template<typename ... Args>
+void binary_log(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt, const Args& ... args){
+    std::string& out = begin_binary_record(site, level, loc, fmt);
+    (encode_log_arg(out, args), ...);
+    out.push_back(char(LogArg::End));
+    commit_binary_record(out);
+}
+
+}
+
+#endif
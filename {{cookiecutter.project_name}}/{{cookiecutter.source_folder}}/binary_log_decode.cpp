@@ -0,0 +1,27 @@
+#include "binary_log.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Print the text of a binary log written with sym::enable_binary_logging
+int main(int argc, const char* argv[]){
+    if (argc != 2){
+        std::cerr << "usage: " << argv[0] << " <file.binlog>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in){
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    try {
+        sym::decode_binary_log(in, std::cout);
+    } catch (std::exception const& e){
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,294 @@
+#include "compile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace sym{
+
+std::vector<std::string> placeholders(Expr const& f){
+    std::vector<std::string> names;
+    std::unordered_set<SymbolId> seen;
+
+    for (ABSExpr* node: topological_order(f)){
+        if (node->kind() == NodeKind::Placeholder){
+            auto* p = static_cast<Placeholder*>(node);
+            if (seen.insert(p->id()).second){
+                names.push_back(p->name());
+            }
+        }
+    }
+    return names;
+}
+
+static bool is_binary(Program::Op op){
+    return op == Program::Op::Add || op == Program::Op::Mult || op == Program::Op::Fma;
+}
+
+// Rewrite `Add(Mult(a, b), c)` into `Fma(a, b, c)` when the product is not used anywhere else
+static void contract_fma(std::vector<Program::Instr>& values, std::vector<bool>& dead, std::vector<bool> const& is_output){
+    using Op = Program::Op;
+
+    std::vector<std::uint32_t> uses(values.size(), 0);
+    for (auto& instr: values){
+        if (is_binary(instr.op)){
+            uses[instr.a] += 1;
+            uses[instr.b] += 1;
+        }
+    }
+
+    auto fusable = [&](std::uint32_t v){
+        return values[v].op == Op::Mult && uses[v] == 1 && !is_output[v] && !dead[v];
+    };
+
+    for (auto& instr: values){
+        if (instr.op != Op::Add){
+            continue;
+        }
+
+        std::uint32_t product = instr.a;
+        std::uint32_t addend = instr.b;
+
+        if (!fusable(product)){
+            std::swap(product, addend);
+            if (!fusable(product)){
+                continue;
+            }
+        }
+
+        instr.op = Op::Fma;
+        instr.a = values[product].a;
+        instr.b = values[product].b;
+        instr.c = addend;
+        dead[product] = true;
+    }
+}
+
+Program compile(Expr const& f, std::vector<std::string> const& inputs, CompileOptions const& options){
+    return compile(std::vector<Expr>{f}, inputs, options);
+}
+
+Program compile(std::vector<Expr> const& outputs, std::vector<std::string> const& inputs, CompileOptions const& options){
+    using Op = Program::Op;
+
+    Program prog;
+    prog._inputs = inputs;
+
+    std::unordered_map<std::string, std::uint32_t> input_index;
+    for (std::uint32_t i = 0; i < inputs.size(); ++i){
+        input_index.emplace(inputs[i], i);
+    }
+
+    // SSA values in topological order, a placeholder is loaded once per input
+    std::vector<Program::Instr> values;
+    std::unordered_map<ABSExpr*, std::uint32_t> value_of;
+    std::unordered_map<std::uint32_t, std::uint32_t> input_value;
+
+    for (ABSExpr* node: topological_order(outputs)){
+        Program::Instr instr{Op::Const, 0, 0, 0, 0, 0};
+
+        switch (node->kind()){
+        case NodeKind::Placeholder: {
+            auto* p = static_cast<Placeholder*>(node);
+            auto it = input_index.find(p->name());
+            if (it == input_index.end()){
+                throw std::out_of_range(p->name());
+            }
+
+            auto loaded = input_value.find(it->second);
+            if (loaded != input_value.end()){
+                value_of[node] = loaded->second;
+                continue;
+            }
+
+            instr.op = Op::Input;
+            instr.a = it->second;
+            input_value[it->second] = std::uint32_t(values.size());
+            break;
+        }
+        case NodeKind::Scalar:
+            instr.value = static_cast<Scalar*>(node)->value();
+            break;
+        case NodeKind::Add:
+        case NodeKind::Mult:
+            instr.op = node->kind() == NodeKind::Add ? Op::Add : Op::Mult;
+            instr.a = value_of.at(node->child(0).get());
+            instr.b = value_of.at(node->child(1).get());
+            break;
+        default:
+            throw std::invalid_argument(std::string("cannot compile node ") + to_string(node->kind()));
+        }
+
+        value_of[node] = std::uint32_t(values.size());
+        values.push_back(instr);
+    }
+
+    std::vector<std::uint32_t> results;
+    std::vector<bool> is_output(values.size(), false);
+    for (auto& output: outputs){
+        results.push_back(value_of.at(output.get()));
+        is_output[results.back()] = true;
+    }
+
+    std::vector<bool> dead(values.size(), false);
+
+    if (options.contract_fma){
+        contract_fma(values, dead, is_output);
+    }
+
+    // Register allocation: a register is released right after the last read of its value
+    constexpr std::uint32_t never = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> last_use(values.size(), 0);
+    for (std::uint32_t i = 0; i < values.size(); ++i){
+        if (dead[i] || !is_binary(values[i].op)){
+            continue;
+        }
+
+        last_use[values[i].a] = i;
+        last_use[values[i].b] = i;
+        if (values[i].op == Op::Fma){
+            last_use[values[i].c] = i;
+        }
+    }
+    for (std::uint32_t result: results){
+        last_use[result] = never;
+    }
+
+    std::vector<std::uint32_t> reg(values.size());
+    std::vector<std::uint32_t> free_regs;
+    std::uint32_t reg_count = 0;
+
+    auto release = [&](std::uint32_t v, std::uint32_t i){
+        if (last_use[v] == i){
+            free_regs.push_back(reg[v]);
+            last_use[v] = never - 1;    // release once even if a == b
+        }
+    };
+
+    for (std::uint32_t i = 0; i < values.size(); ++i){
+        if (dead[i]){
+            continue;
+        }
+
+        Program::Instr instr = values[i];
+
+        if (is_binary(instr.op)){
+            std::uint32_t va = instr.a;
+            std::uint32_t vb = instr.b;
+            std::uint32_t vc = instr.c;
+            instr.a = reg[va];
+            instr.b = reg[vb];
+            release(va, i);
+            release(vb, i);
+
+            if (instr.op == Op::Fma){
+                instr.c = reg[vc];
+                release(vc, i);
+            }
+        }
+
+        if (free_regs.empty()){
+            reg[i] = reg_count++;
+        } else {
+            reg[i] = free_regs.back();
+            free_regs.pop_back();
+        }
+
+        instr.dest = reg[i];
+        prog._code.push_back(instr);
+    }
+
+    for (std::uint32_t result: results){
+        prog._results.push_back(reg[result]);
+    }
+    prog._registers = reg_count;
+    return prog;
+}
+
+double Program::eval(const double* inputs) const {
+    double out = 0;
+    eval_all(inputs, &out);
+    return out;
+}
+
+void Program::eval_all(const double* inputs, double* outputs) const {
+    std::vector<double> regs(_registers);
+
+    for (auto& instr: _code){
+        switch (instr.op){
+        case Op::Input: regs[instr.dest] = inputs[instr.a]; break;
+        case Op::Const: regs[instr.dest] = instr.value; break;
+        case Op::Add:   regs[instr.dest] = regs[instr.a] + regs[instr.b]; break;
+        case Op::Mult:  regs[instr.dest] = regs[instr.a] * regs[instr.b]; break;
+        case Op::Fma:   regs[instr.dest] = std::fma(regs[instr.a], regs[instr.b], regs[instr.c]); break;
+        }
+    }
+
+    for (std::size_t k = 0; k < _results.size(); ++k){
+        outputs[k] = regs[_results[k]];
+    }
+}
+
+void Program::eval_block(const double* const* columns, std::size_t offset, double* const* outputs, std::size_t n, double* scratch) const {
+    // Registers are rows of `block_size` values, the switch runs once per row.
+    // dest can be the register of an operand: each value is read before being written
+    // and rows never partially overlap, so the iterations are independent (omp simd,
+    // enabled by -fopenmp-simd). Fma only vectorizes with hardware FMA (SYM_NATIVE_ARCH)
+    for (auto& instr: _code){
+        double* dest = scratch + instr.dest * block_size;
+        const double* a = scratch + instr.a * block_size;
+        const double* b = scratch + instr.b * block_size;
+        const double* c = scratch + instr.c * block_size;
+
+        switch (instr.op){
+        case Op::Input:
+            std::copy_n(columns[instr.a] + offset, n, dest);
+            break;
+        case Op::Const:
+            std::fill_n(dest, n, instr.value);
+            break;
+        case Op::Add:
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) dest[i] = a[i] + b[i];
+            break;
+        case Op::Mult:
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) dest[i] = a[i] * b[i];
+            break;
+        case Op::Fma:
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) dest[i] = std::fma(a[i], b[i], c[i]);
+            break;
+        }
+    }
+
+    for (std::size_t k = 0; k < _results.size(); ++k){
+        std::copy_n(scratch + _results[k] * block_size, n, outputs[k] + offset);
+    }
+}
+
+void Program::eval(const double* const* columns, double* out, std::size_t n) const {
+    // Only the first output is written, the others go to a throw away buffer
+    if (_results.size() == 1){
+        eval_all(columns, &out, n);
+        return;
+    }
+
+    std::vector<double> ignored(n);
+    std::vector<double*> outputs(_results.size(), ignored.data());
+    outputs[0] = out;
+    eval_all(columns, outputs.data(), n);
+}
+
+void Program::eval_all(const double* const* columns, double* const* outputs, std::size_t n) const {
+    std::vector<double> scratch(_registers * block_size);
+
+    for (std::size_t offset = 0; offset < n; offset += block_size){
+        std::size_t count = std::min(block_size, n - offset);
+        eval_block(columns, offset, outputs, count, scratch.data());
+    }
+}
+}
@@ -0,0 +1,110 @@
+#ifndef PROJECT_TEST_SRC_COMPILE_HEADER
+#define PROJECT_TEST_SRC_COMPILE_HEADER
+
+#include "symbolic.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+// Only contract by default when the target has fused multiply add instructions,
+// otherwise std::fma is emulated in software
+#ifdef FP_FAST_FMA
+constexpr bool has_hardware_fma = true;
+#else
+constexpr bool has_hardware_fma = false;
+#endif
+
+struct CompileOptions{
+    // Emit `Add(Mult(a, b), c)` as a single fused multiply add.
+    // FMA rounds once so results can differ from full_eval in the last bit,
+    // disable it when results must be bitwise identical to full_eval
+    bool contract_fma = has_hardware_fma;
+};
+
+/*!
+ * \brief Expressions lowered to a flat list of register instructions.
+ *
+ * Shared sub expressions are evaluated once and registers are reused as soon as a
+ * value is dead. Evaluation does not touch any Context, inputs are given by position
+ * following the order of `inputs()`. A program can compute several outputs at once,
+ * the single output functions return the first one.
+ *
+ * \code
+ *  auto prog = sym::compile(f, {"x", "y"});
+ *  double point[] = {2.0, 3.0};
+ *  double v = prog.eval(point);
+ *  prog.eval(columns, out, n);    // columns[0] = x values, columns[1] = y values
+ * \endcode
+ */
+class Program
+{
+public:
+    enum class Op: std::uint8_t{
+        Input,      // dest = inputs[a]
+        Const,      // dest = value
+        Add,        // dest = a + b
+        Mult,       // dest = a * b
+        Fma         // dest = a * b + c, rounded once
+    };
+
+    struct Instr{
+        Op op;
+        std::uint32_t dest;
+        std::uint32_t a;
+        std::uint32_t b;
+        std::uint32_t c;
+        double value;
+    };
+
+    // Number of rows evaluated together by the batch evaluation
+    static constexpr std::size_t block_size = 256;
+
+    Program() = default;
+
+    // Evaluate one point, `inputs` holds one value per input
+    double eval(const double* inputs) const;
+
+    // Evaluate `n` points, `columns[i]` holds the `n` values of input i
+    void eval(const double* const* columns, double* out, std::size_t n) const;
+
+    // Same as above for every output, `outputs[k]` receives the values of output k
+    void eval_all(const double* inputs, double* outputs) const;
+    void eval_all(const double* const* columns, double* const* outputs, std::size_t n) const;
+
+    const std::vector<std::string>& inputs() const  { return _inputs; }
+    const std::vector<Instr>& code() const          { return _code; }
+    std::size_t output_count() const                { return _results.size(); }
+    std::size_t register_count() const              { return _registers; }
+
+private:
+    friend Program compile(std::vector<Expr> const&, std::vector<std::string> const&, CompileOptions const&);
+    friend class Specialized;
+
+    void eval_block(const double* const* columns, std::size_t offset, double* const* outputs, std::size_t n, double* scratch) const;
+
+    std::vector<std::string> _inputs;
+    std::vector<Instr> _code;
+    std::vector<std::uint32_t> _results;
+    std::size_t _registers = 0;
+};
+
+// Lower `f` to a program reading its placeholders from `inputs`.
+// Throws std::out_of_range if a placeholder is not listed in `inputs`
+// and std::invalid_argument for nodes that cannot be compiled
+Program compile(Expr const& f, std::vector<std::string> const& inputs, CompileOptions const& options = CompileOptions());
+
+// Lower several expressions to a single program, sub expressions shared between outputs are computed once
+Program compile(std::vector<Expr> const& outputs, std::vector<std::string> const& inputs, CompileOptions const& options = CompileOptions());
+
+// Names of the placeholders used by `f` in order of first appearance
+std::vector<std::string> placeholders(Expr const& f);
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "context.h"
+
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sym{
+
+// Symbol interning
+// --------------------------------------------
+struct SymbolTable{
+    std::mutex lock;
+    std::unordered_map<std::string, SymbolId> ids;
+    std::deque<std::string> names;      // deque: references stay valid on push_back
+};
+
+static SymbolTable& symbol_table(){
+    static SymbolTable table;
+    return table;
+}
+
+SymbolId intern(const std::string& name){
+    SymbolTable& table = symbol_table();
+    std::lock_guard<std::mutex> guard(table.lock);
+
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()){
+        return it->second;
+    }
+
+    SymbolId id = SymbolId(table.names.size());
+    table.names.push_back(name);
+    table.ids.emplace(name, id);
+    return id;
+}
+
+SymbolId try_intern(const std::string& name){
+    SymbolTable& table = symbol_table();
+    std::lock_guard<std::mutex> guard(table.lock);
+
+    auto it = table.ids.find(name);
+    return it != table.ids.end() ? it->second : no_symbol;
+}
+
+const std::string& symbol_name(SymbolId id){
+    SymbolTable& table = symbol_table();
+    std::lock_guard<std::mutex> guard(table.lock);
+    return table.names.at(id);
+}
+
+// Hash Array Mapped Trie
+// --------------------------------------------
+//  Each level consumes 5 bits of the hash, nodes store their entries
+//  compressed and use a 32 bits bitmap to know which slots are used.
+//  The hash is a bijection of the id so two different ids never fully collide.
+
+static constexpr std::uint32_t bits_per_level = 5;
+static constexpr std::uint32_t level_mask = (1u << bits_per_level) - 1;
+
+struct PersistentContext::Node{
+    struct Entry{
+        SymbolId id = 0;                        // valid for leaves only
+        Expr value;
+        std::shared_ptr<const Node> child;      // non null for sub tries
+    };
+
+    std::uint32_t bitmap = 0;
+    std::vector<Entry> entries;
+};
+
+using Node = PersistentContext::Node;
+using NodePtr = std::shared_ptr<const Node>;
+
+static std::uint32_t symbol_hash(SymbolId id)           { return id * 0x9E3779B1u; }
+static std::uint32_t slot_bit(std::uint32_t h, std::uint32_t shift) { return 1u << ((h >> shift) & level_mask); }
+static std::size_t slot_index(std::uint32_t bitmap, std::uint32_t bit) { return std::size_t(std::popcount(bitmap & (bit - 1))); }
+
+// Make a node holding two leaves whose hashes share the prefix up to `shift`
+static NodePtr merge_leaves(Node::Entry a, Node::Entry b, std::uint32_t shift){
+    auto node = std::make_shared<Node>();
+    std::uint32_t abit = slot_bit(symbol_hash(a.id), shift);
+    std::uint32_t bbit = slot_bit(symbol_hash(b.id), shift);
+
+    if (abit == bbit){
+        node->bitmap = abit;
+        node->entries.push_back({0, nullptr, merge_leaves(std::move(a), std::move(b), shift + bits_per_level)});
+        return node;
+    }
+
+    node->bitmap = abit | bbit;
+    if (abit < bbit){
+        node->entries.push_back(std::move(a));
+        node->entries.push_back(std::move(b));
+    } else {
+        node->entries.push_back(std::move(b));
+        node->entries.push_back(std::move(a));
+    }
+    return node;
+}
+
+// Path copying insert, only the nodes from the root to the leaf are copied
+static NodePtr insert_node(NodePtr const& node, std::uint32_t shift, SymbolId id, Expr value, bool& added){
+    std::uint32_t bit = slot_bit(symbol_hash(id), shift);
+
+    if (node == nullptr){
+        auto leaf = std::make_shared<Node>();
+        leaf->bitmap = bit;
+        leaf->entries.push_back({id, std::move(value), nullptr});
+        added = true;
+        return leaf;
+    }
+
+    std::size_t idx = slot_index(node->bitmap, bit);
+    auto copy = std::make_shared<Node>(*node);
+
+    if ((node->bitmap & bit) == 0){
+        copy->bitmap |= bit;
+        copy->entries.insert(copy->entries.begin() + std::ptrdiff_t(idx), {id, std::move(value), nullptr});
+        added = true;
+        return copy;
+    }
+
+    Node::Entry& entry = copy->entries[idx];
+
+    if (entry.child){
+        entry.child = insert_node(entry.child, shift + bits_per_level, id, std::move(value), added);
+    } else if (entry.id == id){
+        entry.value = std::move(value);
+    } else {
+        entry.child = merge_leaves(entry, {id, std::move(value), nullptr}, shift + bits_per_level);
+        entry.value = nullptr;
+        added = true;
+    }
+    return copy;
+}
+
+PersistentContext PersistentContext::insert(SymbolId id, Expr value) const {
+    bool added = false;
+    NodePtr root = insert_node(_root, 0, id, std::move(value), added);
+    return PersistentContext(std::move(root), _size + (added ? 1 : 0));
+}
+
+PersistentContext PersistentContext::insert(const std::string& name, Expr value) const {
+    return insert(intern(name), std::move(value));
+}
+
+const Expr* PersistentContext::lookup(SymbolId id) const {
+    std::uint32_t h = symbol_hash(id);
+    const Node* node = _root.get();
+
+    for (std::uint32_t shift = 0; node != nullptr; shift += bits_per_level){
+        std::uint32_t bit = slot_bit(h, shift);
+
+        if ((node->bitmap & bit) == 0){
+            return nullptr;
+        }
+
+        const Node::Entry& entry = node->entries[slot_index(node->bitmap, bit)];
+        if (!entry.child){
+            return entry.id == id ? &entry.value : nullptr;
+        }
+        node = entry.child.get();
+    }
+    return nullptr;
+}
+
+Expr PersistentContext::find(SymbolId id) const {
+    const Expr* value = lookup(id);
+    return value ? *value : nullptr;
+}
+
+Expr PersistentContext::find(const std::string& name) const {
+    // A name never interned cannot be bound, the lookup must not intern it
+    SymbolId id = try_intern(name);
+    return id != no_symbol ? find(id) : nullptr;
+}
+
+Expr const& PersistentContext::at(SymbolId id) const {
+    const Expr* value = lookup(id);
+    if (!value){
+        throw std::out_of_range(symbol_name(id));
+    }
+    return *value;
+}
+
+PersistentContext PersistentContext::from(const Context& ctx){
+    PersistentContext result;
+    for (auto& item: ctx){
+        result = result.insert(item.first, item.second);
+    }
+    return result;
+}
+}
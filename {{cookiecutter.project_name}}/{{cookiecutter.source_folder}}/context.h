@@ -0,0 +1,81 @@
+#ifndef PROJECT_TEST_SRC_CONTEXT_HEADER
+#define PROJECT_TEST_SRC_CONTEXT_HEADER
+
+#include "symbolic.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+using SymbolId = std::uint32_t;
+
+// Return the unique id of a symbol name, allocating one on first use.
+// Ids are dense, never recycled and safe to share between threads.
+SymbolId intern(const std::string& name);
+
+// Id returned by try_intern() for a name that was never interned
+constexpr SymbolId no_symbol = ~SymbolId(0);
+
+// Id of an already interned name or no_symbol, never allocates an id
+SymbolId try_intern(const std::string& name);
+
+// Name of an interned symbol
+const std::string& symbol_name(SymbolId id);
+
+
+/*!
+ * \brief Immutable context implemented as a hash array mapped trie over interned symbol ids.
+ *
+ * Extending a context returns a new context that shares every untouched node with the
+ * original one, so building contexts in stages costs O(log n) per binding instead of a copy
+ * of the whole map. Contexts are never mutated after construction, a base context can be
+ * shared between threads without locking (as long as SYM_ATOMIC_REFCOUNT is enabled).
+ *
+ * \code
+ *  auto base = sym::PersistentContext().insert("x", sym::make_val(2));
+ *  auto stage1 = base.insert("y", sym::make_val(3));   // base is left untouched
+ *  auto g = f->partial_eval(stage1);
+ * \endcode
+ */
+class PersistentContext
+{
+public:
+    PersistentContext() = default;
+
+    // Return a new context with `name` bound to `value`, replacing any previous binding
+    PersistentContext insert(const std::string& name, Expr value) const;
+    PersistentContext insert(SymbolId id, Expr value) const;
+
+    // Return the bound expression or nullptr when the symbol is not bound
+    Expr find(const std::string& name) const;
+    Expr find(SymbolId id) const;
+
+    // Throw std::out_of_range when the symbol is not bound (same as Context::at).
+    // The reference is valid as long as the context, evaluation does not touch reference counts
+    Expr const& at(SymbolId id) const;
+
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    static PersistentContext from(const Context& ctx);
+
+    struct Node;
+
+private:
+    const Expr* lookup(SymbolId id) const;
+
+    PersistentContext(std::shared_ptr<const Node> root, std::size_t size):
+        _root(std::move(root)), _size(size)
+    {}
+
+    std::shared_ptr<const Node> _root;
+    std::size_t _size = 0;
+};
+
+}
+
+#endif
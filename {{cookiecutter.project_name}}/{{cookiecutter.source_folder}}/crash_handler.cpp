@@ -0,0 +1,657 @@
+#include "crash_handler.h"
+#include "backtrace.h"
+#include "flight_recorder.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <elf.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace sym{
+
+#ifdef __linux__
+// Signal handler
+// --------------------------------------------
+// What crash_handler() reaches: no allocation, no lock, no stdio
+namespace {
+constexpr int crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+constexpr std::size_t crash_stack_size = 64 * 1024;
+constexpr int max_frames = 64;
+
+char crash_path[PATH_MAX] = "crash.txt";
+char report_buffer[16 * 1024];
+std::atomic<long> crashing_thread{0};
+bool installed = false;
+
+// Stack of the thread, set by enable_crash_stack(), bounds the frame pointer walk.
+// Initial exec TLS is a plain load from the thread pointer, safe in the handler
+struct StackBounds{
+    std::uintptr_t low = 0;
+    std::uintptr_t high = 0;
+};
+thread_local StackBounds thread_stack __attribute__((tls_model("initial-exec")));
+
+const char* signal_name(int sig){
+    switch (sig){
+    case SIGSEGV: return "SIGSEGV";
+    case SIGBUS:  return "SIGBUS";
+    case SIGFPE:  return "SIGFPE";
+    case SIGILL:  return "SIGILL";
+    case SIGABRT: return "SIGABRT";
+    default:      return "?";
+    }
+}
+
+// Buffered writes to a file descriptor through report_buffer
+class ReportWriter
+{
+public:
+    explicit ReportWriter(int fd):
+        _fd(fd)
+    {}
+
+    ~ReportWriter(){
+        flush();
+    }
+
+    ReportWriter& str(const char* s){
+        while (*s){
+            put(*s++);
+        }
+        return *this;
+    }
+
+    ReportWriter& hex(std::uint64_t value){
+        char digits[16];
+        int n = 0;
+        do {
+            digits[n++] = "0123456789abcdef"[value & 15];
+            value >>= 4;
+        } while (value);
+
+        str("0x");
+        while (n > 0){
+            put(digits[--n]);
+        }
+        return *this;
+    }
+
+    ReportWriter& dec(long value){
+        char digits[24];
+        int n = 0;
+        std::uint64_t magnitude = value < 0 ? 0 - std::uint64_t(value) : std::uint64_t(value);
+        do {
+            digits[n++] = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+
+        if (value < 0){
+            put('-');
+        }
+        while (n > 0){
+            put(digits[--n]);
+        }
+        return *this;
+    }
+
+    // Two hex digits per byte
+    ReportWriter& bytes(const char* data, std::size_t size){
+        for (std::size_t i = 0; i < size; ++i){
+            std::uint8_t byte = std::uint8_t(data[i]);
+            put("0123456789abcdef"[byte >> 4]);
+            put("0123456789abcdef"[byte & 15]);
+        }
+        return *this;
+    }
+
+    // Backslashes and line breaks escaped so the string stays on one line
+    ReportWriter& escaped(const char* s){
+        for (; *s; ++s){
+            if (*s == '\\'){
+                str("\\\\");
+            } else if (*s == '\n'){
+                str("\\n");
+            } else {
+                put(*s);
+            }
+        }
+        return *this;
+    }
+
+    // Append the content of a file, used for /proc/self/maps
+    ReportWriter& file(const char* path){
+        flush();
+        int in = open(path, O_RDONLY | O_CLOEXEC);
+        if (in < 0){
+            return str("unavailable\n");
+        }
+
+        ssize_t n;
+        while ((n = read(in, report_buffer, sizeof(report_buffer))) > 0 || (n < 0 && errno == EINTR)){
+            if (n > 0){
+                _size = std::size_t(n);
+                flush();
+            }
+        }
+        close(in);
+        return *this;
+    }
+
+    void flush(){
+        std::size_t done = 0;
+        while (done < _size){
+            ssize_t n = write(_fd, report_buffer + done, _size - done);
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n <= 0){
+                break;
+            }
+            done += std::size_t(n);
+        }
+        _size = 0;
+    }
+
+private:
+    void put(char c){
+        if (_size == sizeof(report_buffer)){
+            flush();
+        }
+        report_buffer[_size++] = c;
+    }
+
+    int _fd;
+    std::size_t _size = 0;
+};
+
+std::uintptr_t fault_pc(void* context){
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    return std::uintptr_t(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    return std::uintptr_t(uc->uc_mcontext.pc);
+#else
+    (void) uc;
+    return 0;
+#endif
+}
+
+std::uintptr_t fault_frame_pointer(void* context){
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    return std::uintptr_t(uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+    return std::uintptr_t(uc->uc_mcontext.regs[29]);
+#else
+    (void) uc;
+    return 0;
+#endif
+}
+
+std::uintptr_t fault_stack_pointer(void* context){
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    return std::uintptr_t(uc->uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+    return std::uintptr_t(uc->uc_mcontext.sp);
+#else
+    (void) uc;
+    return 0;
+#endif
+}
+
+// Return addresses of the frame pointer chain, {previous frame, return address} on both
+// x86-64 and AArch64. Only reads memory: every frame must be inside the stack of the
+// thread and above the previous one, the walk stops at the first frame that is not.
+// Functions compiled without frame pointers (libc) are skipped or end the walk
+int walk_frame_pointers(void* context, std::uintptr_t* frames, int max){
+    StackBounds const& stack = thread_stack;
+    if (stack.high == 0){
+        return 0;
+    }
+
+    std::uintptr_t low = std::max(stack.low, fault_stack_pointer(context));
+    std::uintptr_t fp = fault_frame_pointer(context);
+
+    int n = 0;
+    while (n < max && fp >= low && fp % sizeof(std::uintptr_t) == 0 && fp <= stack.high - 2 * sizeof(std::uintptr_t)){
+        auto const* frame = reinterpret_cast<std::uintptr_t const*>(fp);
+        if (frame[1] == 0){
+            break;
+        }
+        frames[n++] = frame[1];
+        low = fp + 2 * sizeof(std::uintptr_t);
+        fp = frame[0];
+    }
+    return n;
+}
+
+void write_registers(ReportWriter& out, void* context){
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+    static constexpr struct { const char* name; int index; } registers[] = {
+        {"rip", REG_RIP}, {"rsp", REG_RSP}, {"rbp", REG_RBP}, {"eflags", REG_EFL},
+        {"rax", REG_RAX}, {"rbx", REG_RBX}, {"rcx", REG_RCX}, {"rdx", REG_RDX},
+        {"rsi", REG_RSI}, {"rdi", REG_RDI}, {"r8", REG_R8},   {"r9", REG_R9},
+        {"r10", REG_R10}, {"r11", REG_R11}, {"r12", REG_R12}, {"r13", REG_R13},
+        {"r14", REG_R14}, {"r15", REG_R15},
+    };
+    for (auto& reg: registers){
+        out.str(" ").str(reg.name).str(" ").hex(std::uint64_t(uc->uc_mcontext.gregs[reg.index])).str("\n");
+    }
+#elif defined(__aarch64__)
+    out.str(" pc ").hex(uc->uc_mcontext.pc).str("\n");
+    out.str(" sp ").hex(uc->uc_mcontext.sp).str("\n");
+    for (int i = 0; i < 31; ++i){
+        out.str(" x").dec(i).str(" ").hex(uc->uc_mcontext.regs[i]).str("\n");
+    }
+#else
+    (void) uc;
+    out.str(" unavailable\n");
+#endif
+}
+
+std::uint64_t clock_ns(clockid_t clock){
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000ull + std::uint64_t(ts.tv_nsec);
+}
+
+// Call sites and events of the flight recorder, formatted by the symbolizer
+void write_flight_recorder(ReportWriter& out){
+    out.str("clock ").dec(long(clock_ns(CLOCK_MONOTONIC))).str(" ").dec(long(clock_ns(CLOCK_REALTIME))).str("\n");
+
+    out.str("sites\n");
+    for (std::uint32_t id = 1, n = log_site_count(); id <= n; ++id){
+        LogSiteInfo const* site = find_log_site(id);
+        out.str(" ").dec(id).str(" ").dec(int(site->level)).str(" ").dec(site->loc->line)
+           .str(" ").str(site->loc->filename).str(" ").str(site->loc->function_name)
+           .str(" ").escaped(site->format).str("\n");
+    }
+
+    // " thread time site args", the arguments in hex or "-"
+    out.str("events\n");
+    visit_flight_records([](FlightRecord const& record, void* data){
+        ReportWriter& out = *static_cast<ReportWriter*>(data);
+        out.str(" ").dec(long(record.thread)).str(" ").dec(long(record.time)).str(" ").dec(record.site).str(" ");
+        if (record.size == 0){
+            out.str("-");
+        }
+        out.bytes(record.args, record.size).str("\n");
+    }, &out);
+}
+
+void write_report(int fd, int sig, siginfo_t* info, void* context, long tid){
+    ReportWriter out(fd);
+
+    out.str("*** sym crash report ***\n");
+    out.str("signal ").dec(sig).str(" ").str(signal_name(sig))
+       .str(" code ").dec(info->si_code)
+       .str(" address ").hex(std::uintptr_t(info->si_addr)).str("\n");
+    out.str("pid ").dec(getpid()).str(" tid ").dec(tid).str("\n");
+
+    out.str("registers\n");
+    write_registers(out, context);
+
+    // The faulting instruction first then the return addresses. backtrace() is not used,
+    // the libgcc unwinder takes the loader lock
+    std::uintptr_t frames[max_frames];
+    int n = walk_frame_pointers(context, frames, max_frames);
+
+    out.str("frames\n");
+    out.str(" #0 ").hex(fault_pc(context)).str("\n");
+    for (int i = 0; i < n; ++i){
+        out.str(" #").dec(i + 1).str(" ").hex(frames[i]).str("\n");
+    }
+
+    write_flight_recorder(out);
+
+    out.str("maps\n");
+    out.file("/proc/self/maps");
+    out.str("end\n");
+}
+
+void crash_handler(int sig, siginfo_t* info, void* context){
+    long tid = syscall(SYS_gettid);
+
+    // A single report: another thread crashing at the same time waits to be killed,
+    // a crash inside the handler goes straight to the default action
+    long expected = 0;
+    if (!crashing_thread.compare_exchange_strong(expected, tid)){
+        if (expected != tid){
+            for (;;){
+                pause();
+            }
+        }
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+
+    int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0){
+        write_report(fd, sig, info, context, tid);
+        close(fd);
+    }
+
+    {
+        ReportWriter err(STDERR_FILENO);
+        err.str("Fatal signal ").str(signal_name(sig)).str(", crash report written to ").str(crash_path).str("\n");
+    }
+
+    // Pending until the handler returns, then the default action runs
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+struct CrashStack{
+    CrashStack():
+        memory(new char[crash_stack_size])
+    {
+        stack_t stack{};
+        stack.ss_sp = memory.get();
+        stack.ss_size = crash_stack_size;
+        sigaltstack(&stack, nullptr);
+
+        pthread_attr_t attr;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0){
+            void* base = nullptr;
+            std::size_t size = 0;
+            if (pthread_attr_getstack(&attr, &base, &size) == 0){
+                thread_stack.low = std::uintptr_t(base);
+                thread_stack.high = std::uintptr_t(base) + size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+
+    ~CrashStack(){
+        thread_stack = StackBounds();
+        stack_t stack{};
+        stack.ss_flags = SS_DISABLE;
+        sigaltstack(&stack, nullptr);
+    }
+
+    std::unique_ptr<char[]> memory;
+};
+
+std::mutex install_lock;
+}
+
+void enable_crash_stack(){
+    thread_local CrashStack stack;
+    (void) stack;
+}
+
+void install_crash_handler(CrashHandlerOptions const& options){
+    std::lock_guard<std::mutex> guard(install_lock);
+
+    // Read by the handler, blocked while it changes
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    for (int sig: crash_signals){
+        sigaddset(&blocked, sig);
+    }
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    std::size_t n = std::min(options.path.size(), sizeof(crash_path) - 1);
+    std::memcpy(crash_path, options.path.data(), n);
+    crash_path[n] = '\0';
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+    enable_crash_stack();
+    if (installed){
+        return;
+    }
+
+    struct sigaction action{};
+    action.sa_sigaction = crash_handler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for (int sig: crash_signals){
+        sigaction(sig, &action, nullptr);
+    }
+    installed = true;
+}
+
+bool crash_handler_installed(){
+    std::lock_guard<std::mutex> guard(install_lock);
+    return installed;
+}
+#else
+void enable_crash_stack(){}
+
+void install_crash_handler(CrashHandlerOptions const&){}
+
+bool crash_handler_installed(){
+    return false;
+}
+#endif
+
+// Symbolizer
+// --------------------------------------------
+namespace {
+struct Mapping{
+    std::uint64_t start;
+    std::uint64_t end;
+    std::uint64_t offset;
+    std::string path;
+};
+
+std::uint64_t parse_hex(std::string const& text){
+    return std::stoull(text, nullptr, 16);
+}
+
+// Executables that are not position independent are looked up by address
+bool is_fixed_executable(std::string const& path){
+#ifdef __linux__
+    std::ifstream file(path, std::ios::binary);
+    Elf64_Ehdr header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0){
+        return false;
+    }
+    return header.e_type == ET_EXEC;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+std::string symbolize_frame(std::uint64_t address, bool return_address, std::vector<Mapping> const& maps){
+    auto it = std::find_if(maps.begin(), maps.end(), [&](Mapping const& m){
+        return m.start <= address && address < m.end;
+    });
+    if (it == maps.end() || it->path.empty() || it->path[0] != '/'){
+        return "??";
+    }
+
+    // The module is loaded at its first mapping
+    std::uint64_t base = it->start - it->offset;
+    for (auto const& m: maps){
+        if (m.path == it->path && m.offset == 0){
+            base = m.start;
+            break;
+        }
+    }
+
+    // A return address is after the call, step back into it
+    std::uint64_t lookup = is_fixed_executable(it->path) ? address : address - base;
+    lookup -= return_address ? 1 : 0;
+
+    auto [function, line] = addr2line(it->path.c_str(), lookup);
+    std::string module = it->path.substr(it->path.rfind('/') + 1);
+
+    std::ostringstream text;
+    text << (function.empty() ? "??" : function);
+    if (!line.empty()){
+        text << " at " << line;
+    }
+    text << " (" << module << "+0x" << std::hex << (address - base) << ")";
+    return text.str();
+}
+
+bool is_section(std::string const& line){
+    return line == "registers" || line == "frames" || line == "sites" || line == "events" ||
+           line == "maps" || line == "end";
+}
+
+struct CrashSite{
+    std::uint32_t id;
+    int level;
+    std::uint32_t line;
+    std::string file;
+    std::string function;
+    std::string format;
+};
+
+struct CrashEvent{
+    std::uint64_t thread = 0;
+    std::uint64_t time = 0;
+    std::uint32_t site = 0;
+    std::string args;
+};
+
+// " id level line file function format", the format is escaped and can hold spaces
+void parse_site(std::string const& line, std::vector<CrashSite>& sites){
+    std::istringstream fields(line);
+    CrashSite site;
+    if (!(fields >> site.id >> site.level >> site.line >> site.file >> site.function)){
+        return;
+    }
+
+    std::string escaped;
+    std::getline(fields, escaped);
+    for (std::size_t i = escaped.empty() ? 0 : 1; i < escaped.size(); ++i){
+        if (escaped[i] == '\\' && i + 1 < escaped.size()){
+            i += 1;
+            site.format.push_back(escaped[i] == 'n' ? '\n' : escaped[i]);
+        } else {
+            site.format.push_back(escaped[i]);
+        }
+    }
+    sites.push_back(site);
+}
+
+std::string parse_bytes(std::string const& hex){
+    std::string bytes;
+    for (std::size_t i = 0; i + 1 < hex.size(); i += 2){
+        bytes.push_back(char(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+std::string format_crash_event(CrashEvent const& event, std::vector<CrashSite> const& sites, std::uint64_t offset){
+    auto it = std::find_if(sites.begin(), sites.end(), [&](CrashSite const& site){
+        return site.id == event.site;
+    });
+    if (it == sites.end()){
+        return "unknown call site " + std::to_string(event.site);
+    }
+
+    try {
+        return format_log_line(LogLevel(it->level), event.time + offset, event.thread,
+                               it->file, it->line, it->function, it->format, event.args);
+    } catch (std::runtime_error const&){
+        return it->format + " (corrupted arguments)";
+    }
+}
+}
+
+void symbolize_crash_report(std::istream& in, std::ostream& out){
+    std::vector<std::string> lines;
+    std::vector<Mapping> maps;
+    std::vector<CrashSite> sites;
+    std::vector<CrashEvent> events;
+    std::uint64_t monotonic = 0, realtime = 0;
+    std::string section;
+
+    for (std::string line; std::getline(in, line);){
+        lines.push_back(line);
+
+        if (is_section(line)){
+            section = line;
+            continue;
+        }
+
+        if (line.compare(0, 6, "clock ") == 0){
+            std::istringstream(line.substr(6)) >> monotonic >> realtime;
+        } else if (section == "sites"){
+            parse_site(line, sites);
+        } else if (section == "events"){
+            // " thread time site args"
+            CrashEvent event;
+            std::string args;
+            std::istringstream(line) >> event.thread >> event.time >> event.site >> args;
+            event.args = parse_bytes(args);
+            events.push_back(event);
+        } else if (section == "maps"){
+            // start-end perms offset dev inode path
+            std::istringstream fields(line);
+            std::string range, perms, offset, dev, inode, path;
+            fields >> range >> perms >> offset >> dev >> inode;
+            std::getline(fields >> std::ws, path);
+
+            std::size_t dash = range.find('-');
+            if (dash == std::string::npos){
+                continue;
+            }
+            maps.push_back({parse_hex(range.substr(0, dash)), parse_hex(range.substr(dash + 1)), parse_hex(offset), path});
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](auto const& a, auto const& b){
+        return a.time < b.time;
+    });
+
+    section.clear();
+    for (auto const& line: lines){
+        if (is_section(line)){
+            section = line;
+        }
+
+        // Replaced by the formatted events, oldest first
+        if (section == "events" && line != section){
+            continue;
+        }
+
+        out << line;
+        // " #i 0xaddress"
+        if (section == "frames" && line.size() > 2 && line[1] == '#'){
+            std::istringstream fields(line);
+            std::string index, address;
+            fields >> index >> address;
+            out << "  " << symbolize_frame(parse_hex(address), index != "#0", maps);
+        }
+        out << '\n';
+
+        if (line == "events"){
+            for (auto const& event: events){
+                out << ' ' << format_crash_event(event, sites, realtime - monotonic) << '\n';
+            }
+        }
+    }
+}
+}
@@ -0,0 +1,54 @@
+#ifndef PROJECT_TEST_SRC_CRASH_HANDLER_HEADER
+#define PROJECT_TEST_SRC_CRASH_HANDLER_HEADER
+
+#include <iosfwd>
+#include <string>
+
+namespace sym
+{
+
+/*!
+ * \brief Crash report written from the signal handler.
+ *
+ * On SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT the handler writes the signal, the
+ * registers, the raw return addresses, the events of the flight recorder and a copy of
+ * /proc/self/maps to the report file, then raises the signal again with its default
+ * action (core dump, exit status).
+ *
+ * The return addresses come from the frame pointer chain (the project builds with
+ * -fno-omit-frame-pointer), bounded by the stack recorded by enable_crash_stack().
+ * Frames of code built without frame pointers are missing, a thread that did not call
+ * enable_crash_stack() only reports the faulting instruction.
+ *
+ * The handler only uses async-signal-safe calls and a buffer allocated at install time,
+ * it never takes a lock nor allocates, and it runs on an alternate stack so a stack
+ * overflow is reported too. The report is symbolized offline:
+ *
+ * \code
+ *  $ crash_symbolize crash.txt
+ * \endcode
+ */
+struct CrashHandlerOptions{
+    std::string path = "crash.txt";     // report file, created by the handler
+};
+
+// Install the handler and give the calling thread an alternate signal stack.
+// Calling it again only changes the report file
+void install_crash_handler(CrashHandlerOptions const& options = CrashHandlerOptions());
+
+// True once install_crash_handler() was called
+bool crash_handler_installed();
+
+// Alternate signal stack and stack bounds for the calling thread, freed when the thread exits.
+// Each thread opts in: the ThreadPool workers and the log writer threads call it when they
+// start, other threads call it once to get their stack overflows and frames reported
+void enable_crash_stack();
+
+// Copy of a crash report with each frame followed by its function and line, the modules
+// are located with the maps section of the report. The recorded events are formatted
+// like the text logs and sorted by time
+void symbolize_crash_report(std::istream& in, std::ostream& out);
+
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include "crash_handler.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Print a crash report written by sym::install_crash_handler with its frames symbolized,
+// run it on the machine that crashed so the modules are the same
+int main(int argc, const char* argv[]){
+    if (argc != 2){
+        std::cerr << "usage: " << argv[0] << " <crash.txt>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in){
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    try {
+        sym::symbolize_crash_report(in, std::cout);
+    } catch (std::exception const& e){
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
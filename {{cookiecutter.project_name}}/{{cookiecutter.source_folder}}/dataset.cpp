@@ -0,0 +1,328 @@
+#include "dataset.h"
+#include "compile.h"
+#include "crash_handler.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sym{
+
+static constexpr char magic[8] = {'S', 'Y', 'M', 'C', 'O', 'L', '0', '1'};
+static constexpr std::size_t alignment = 64;
+
+static std::size_t align_up(std::size_t v, std::size_t a){ return (v + a - 1) / a * a; }
+
+// Column file writer
+// --------------------------------------------
+using File = std::unique_ptr<std::FILE, int(*)(std::FILE*)>;
+
+static File open_file(const std::string& path, const char* mode){
+    File file(std::fopen(path.c_str(), mode), &std::fclose);
+    if (!file){
+        throw std::runtime_error("could not open " + path);
+    }
+    return file;
+}
+
+static void write_bytes(std::FILE* file, const void* data, std::size_t size){
+    if (size > 0 && std::fwrite(data, 1, size, file) != size){
+        throw std::runtime_error("could not write dataset");
+    }
+}
+
+static void write_header(std::FILE* file, const std::vector<std::string>& names, std::size_t rows){
+    std::uint64_t header[2] = {rows, names.size()};
+    std::size_t size = sizeof(magic) + sizeof(header);
+
+    write_bytes(file, magic, sizeof(magic));
+    write_bytes(file, header, sizeof(header));
+
+    for (auto& name: names){
+        std::uint32_t n = std::uint32_t(name.size());
+        write_bytes(file, &n, sizeof(n));
+        write_bytes(file, name.data(), name.size());
+        size += sizeof(n) + name.size();
+    }
+
+    char padding[alignment] = {0};
+    write_bytes(file, padding, align_up(size, alignment) - size);
+}
+
+void write_columns(const std::string& path,
+                   const std::vector<std::string>& names,
+                   const std::vector<const double*>& columns,
+                   std::size_t rows)
+{
+    File file = open_file(path, "wb");
+    write_header(file.get(), names, rows);
+
+    for (auto* column: columns){
+        write_bytes(file.get(), column, rows * sizeof(double));
+    }
+}
+
+// Column file reader
+// --------------------------------------------
+#ifdef __linux__
+ColumnFile::ColumnFile(const std::string& path){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0){
+        throw std::runtime_error("could not open " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0){
+        ::close(fd);
+        throw std::runtime_error("could not stat " + path);
+    }
+
+    _map_size = std::size_t(st.st_size);
+    _map = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (_map == MAP_FAILED){
+        _map = nullptr;
+        throw std::runtime_error("could not map " + path);
+    }
+
+    const char* bytes = static_cast<const char*>(_map);
+    std::size_t offset = sizeof(magic) + 2 * sizeof(std::uint64_t);
+
+    if (_map_size < offset || std::memcmp(bytes, magic, sizeof(magic)) != 0){
+        munmap(_map, _map_size);
+        throw std::runtime_error(path + " is not a column file");
+    }
+
+    std::uint64_t header[2];
+    std::memcpy(header, bytes + sizeof(magic), sizeof(header));
+    _rows = std::size_t(header[0]);
+
+    // The sizes come from the file, every read is checked against the mapping
+    auto truncated = [&](){
+        munmap(_map, _map_size);
+        _map = nullptr;
+        throw std::runtime_error(path + " is truncated");
+    };
+
+    for (std::uint64_t i = 0; i < header[1]; ++i){
+        std::uint32_t n;
+        if (_map_size - offset < sizeof(n)){
+            truncated();
+        }
+        std::memcpy(&n, bytes + offset, sizeof(n));
+        offset += sizeof(n);
+
+        if (_map_size - offset < n){
+            truncated();
+        }
+        _names.emplace_back(bytes + offset, n);
+        offset += n;
+    }
+
+    // Divided rather than multiplied, the product can overflow
+    offset = align_up(offset, alignment);
+    if (offset > _map_size ||
+        (!_names.empty() && _rows > (_map_size - offset) / sizeof(double) / _names.size())){
+        truncated();
+    }
+
+    _data = reinterpret_cast<const double*>(bytes + offset);
+}
+
+ColumnFile::~ColumnFile(){
+    if (_map){
+        munmap(_map, _map_size);
+    }
+}
+
+void ColumnFile::advise(std::size_t begin, std::size_t end, int advice, bool inner) const {
+    static const std::uintptr_t page = std::uintptr_t(sysconf(_SC_PAGESIZE));
+
+    for (std::size_t i = 0; i < _names.size(); ++i){
+        std::uintptr_t start = std::uintptr_t(column(i) + begin);
+        std::uintptr_t stop = std::uintptr_t(column(i) + end);
+
+        // Releasing must not drop pages shared with rows outside of the range
+        start = inner ? (start + page - 1) / page * page : start / page * page;
+        stop = inner ? stop / page * page : (stop + page - 1) / page * page;
+
+        if (start < stop){
+            madvise(reinterpret_cast<void*>(start), stop - start, advice);
+        }
+    }
+}
+
+void ColumnFile::prefetch(std::size_t begin, std::size_t end) const { advise(begin, end, MADV_WILLNEED, false); }
+void ColumnFile::release(std::size_t begin, std::size_t end) const  { advise(begin, end, MADV_DONTNEED, true); }
+#else
+ColumnFile::ColumnFile(const std::string&){
+    throw std::runtime_error("memory mapped datasets are only supported on linux");
+}
+ColumnFile::~ColumnFile(){}
+void ColumnFile::advise(std::size_t, std::size_t, int, bool) const {}
+void ColumnFile::prefetch(std::size_t, std::size_t) const {}
+void ColumnFile::release(std::size_t, std::size_t) const {}
+#endif
+
+const double* ColumnFile::column(const std::string& name) const {
+    auto it = std::find(_names.begin(), _names.end(), name);
+    if (it == _names.end()){
+        throw std::out_of_range(name);
+    }
+    return column(std::size_t(it - _names.begin()));
+}
+
+// Streaming evaluation
+// --------------------------------------------
+// Writes the evaluated chunks in order, one thread for the whole file
+class ChunkWriter
+{
+public:
+    explicit ChunkWriter(std::FILE* file):
+        _file(file), _thread([this](){ run(); })
+    {}
+
+    ~ChunkWriter(){
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _stop = true;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    ChunkWriter(const ChunkWriter&) = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+    // Wait for the previous chunk then queue this one, `data` must stay valid until the
+    // next call to write() or wait()
+    void write(const double* data, std::size_t count){
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _data = data;
+            _count = count;
+            _queued = true;
+        }
+        _wake.notify_all();
+    }
+
+    // Block until the queued chunk is written, rethrows its write error
+    void wait(){
+        std::unique_lock<std::mutex> guard(_lock);
+        _done.wait(guard, [this](){ return !_queued; });
+        if (_error){
+            std::rethrow_exception(std::exchange(_error, nullptr));
+        }
+    }
+
+private:
+    void run(){
+        enable_crash_stack();
+
+        std::unique_lock<std::mutex> guard(_lock);
+        for (;;){
+            _wake.wait(guard, [this](){ return _stop || _queued; });
+            if (!_queued){
+                return;
+            }
+
+            guard.unlock();
+            std::exception_ptr error;
+            try {
+                write_bytes(_file, _data, _count * sizeof(double));
+            } catch (...){
+                error = std::current_exception();
+            }
+            guard.lock();
+
+            _error = error;
+            _queued = false;
+            _done.notify_all();
+        }
+    }
+
+    std::FILE* _file;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const double* _data = nullptr;
+    std::size_t _count = 0;
+    bool _queued = false;
+    bool _stop = false;
+    std::exception_ptr _error;
+    std::thread _thread;
+};
+
+std::size_t eval_file(Expr const& f, const std::string& path, const std::string& out_path,
+                      EvalFileOptions const& options)
+{
+    ThreadPool& pool = options.pool ? *options.pool : ThreadPool::global();
+    ColumnFile input(path);
+
+    std::vector<std::string> inputs = placeholders(f);
+    Program prog = compile(f, inputs);
+
+    std::vector<const double*> columns;
+    for (auto& name: inputs){
+        columns.push_back(input.column(name));
+    }
+
+    std::size_t rows = input.rows();
+    std::size_t chunk_rows = std::max<std::size_t>(options.chunk_rows, Program::block_size);
+    std::size_t grain = Program::block_size * 16;
+
+    File output = open_file(out_path, "wb");
+    write_header(output.get(), {options.output_name}, rows);
+
+    // Double buffering: a chunk is evaluated by the pool while the previous one is written
+    std::vector<double> buffers[2] = {
+        std::vector<double>(std::min(chunk_rows, rows)),
+        std::vector<double>(std::min(chunk_rows, rows))
+    };
+    ChunkWriter writer(output.get());
+
+    input.prefetch(0, std::min(chunk_rows, rows));
+
+    for (std::size_t begin = 0, k = 0; begin < rows; begin += chunk_rows, ++k){
+        std::size_t end = std::min(rows, begin + chunk_rows);
+        double* out = buffers[k % 2].data();
+
+        input.prefetch(end, std::min(rows, end + chunk_rows));
+
+        pool.parallel_for(end - begin, grain, [&](std::size_t b, std::size_t e){
+            std::vector<const double*> cols(columns.size());
+            for (std::size_t i = 0; i < columns.size(); ++i){
+                cols[i] = columns[i] + begin + b;
+            }
+            prog.eval(cols.data(), out + b, e - b);
+        });
+
+        input.release(begin, end);
+        writer.write(out, end - begin);
+    }
+    writer.wait();
+
+    if (std::fflush(output.get()) != 0){
+        throw std::runtime_error("could not write " + out_path);
+    }
+    return rows;
+}
+}
@@ -0,0 +1,81 @@
+#ifndef PROJECT_TEST_SRC_DATASET_HEADER
+#define PROJECT_TEST_SRC_DATASET_HEADER
+
+#include "symbolic.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+class ThreadPool;
+
+/*!
+ * \brief Read only, memory mapped columnar dataset.
+ *
+ * File layout (native endianness):
+ *  - char[8]   magic "SYMCOL01"
+ *  - uint64    rows
+ *  - uint64    columns
+ *  - columns x {uint32 size; char name[size];}
+ *  - padding to a multiple of 64 bytes
+ *  - columns x rows doubles, one column after the other
+ */
+class ColumnFile
+{
+public:
+    explicit ColumnFile(const std::string& path);
+    ~ColumnFile();
+
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    std::size_t rows() const                        { return _rows; }
+    const std::vector<std::string>& names() const   { return _names; }
+
+    // Throws std::out_of_range if there is no column with that name
+    const double* column(const std::string& name) const;
+    const double* column(std::size_t i) const       { return _data + i * _rows; }
+
+    // Hint the kernel that rows [begin, end) will be read soon / are not needed anymore
+    void prefetch(std::size_t begin, std::size_t end) const;
+    void release(std::size_t begin, std::size_t end) const;
+
+private:
+    void advise(std::size_t begin, std::size_t end, int advice, bool inner) const;
+
+    void* _map = nullptr;
+    std::size_t _map_size = 0;
+    std::size_t _rows = 0;
+    std::vector<std::string> _names;
+    const double* _data = nullptr;
+};
+
+// Write a dataset readable by ColumnFile
+void write_columns(const std::string& path,
+                   const std::vector<std::string>& names,
+                   const std::vector<const double*>& columns,
+                   std::size_t rows);
+
+struct EvalFileOptions{
+    std::size_t chunk_rows = 1 << 16;       // rows evaluated before being written out
+    ThreadPool* pool = nullptr;             // ThreadPool::global() when null
+    std::string output_name = "result";
+};
+
+/*!
+ * \brief Evaluate `f` over every row of the dataset at `path`, results are written to `out_path`.
+ *
+ * Each placeholder of `f` is read from the column with the same name. Rows are evaluated
+ * chunk by chunk on the thread pool while the previous chunk is written by a single writer
+ * thread, pages of the dataset are released once evaluated so memory usage stays bounded.
+ * Returns the number of rows evaluated.
+ */
+std::size_t eval_file(Expr const& f, const std::string& path, const std::string& out_path,
+                      EvalFileOptions const& options = EvalFileOptions());
+
+}
+
+#endif
@@ -0,0 +1,458 @@
+#include "egraph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace sym{
+
+using ClassId = std::uint32_t;
+using Clock = std::chrono::steady_clock;
+
+// Node of the e-graph, children are equivalence classes instead of expressions
+struct ENode{
+    NodeKind op;
+    ClassId a = 0;
+    ClassId b = 0;
+    std::uint64_t payload = 0;  // symbol id, bits of the scalar or address of an opaque node
+    Expr leaf;                  // original node for leaves, not part of the identity
+
+    bool binary() const { return op == NodeKind::Add || op == NodeKind::Mult; }
+
+    bool operator==(ENode const& o) const {
+        return op == o.op && a == o.a && b == o.b && payload == o.payload;
+    }
+    bool operator<(ENode const& o) const {
+        return std::tie(op, a, b, payload) < std::tie(o.op, o.a, o.b, o.payload);
+    }
+};
+
+struct ENodeHash{
+    std::size_t operator()(ENode const& n) const {
+        std::uint64_t h = std::uint64_t(n.op);
+        h = h * 0x9E3779B97F4A7C15ull ^ n.a;
+        h = h * 0x9E3779B97F4A7C15ull ^ n.b;
+        h = h * 0x9E3779B97F4A7C15ull ^ n.payload;
+        return std::size_t(h ^ (h >> 29));
+    }
+};
+
+static std::uint64_t scalar_bits(double v){
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(v));
+    return bits;
+}
+
+static double scalar_value(std::uint64_t bits){
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+class EGraph{
+public:
+    ClassId find(ClassId id){
+        while (parent[id] != id){
+            parent[id] = parent[parent[id]];
+            id = parent[id];
+        }
+        return id;
+    }
+
+    ENode canonical(ENode n){
+        if (n.binary()){
+            n.a = find(n.a);
+            n.b = find(n.b);
+        }
+        return n;
+    }
+
+    ClassId add(ENode n){
+        n = canonical(std::move(n));
+
+        auto it = memo.find(n);
+        if (it != memo.end()){
+            return find(it->second);
+        }
+
+        ClassId id = ClassId(parent.size());
+        parent.push_back(id);
+        classes.emplace_back();
+        classes.back().push_back(n);
+        memo.emplace(std::move(n), id);
+        node_count += 1;
+        return id;
+    }
+
+    ClassId binary(NodeKind op, ClassId a, ClassId b){
+        ENode n;
+        n.op = op;
+        n.a = a;
+        n.b = b;
+        return add(std::move(n));
+    }
+
+    ClassId scalar(double v){
+        ENode n;
+        n.op = NodeKind::Scalar;
+        n.payload = scalar_bits(v);
+        return add(std::move(n));
+    }
+
+    bool merge(ClassId a, ClassId b){
+        a = find(a);
+        b = find(b);
+
+        if (a == b){
+            return false;
+        }
+
+        if (classes[a].size() < classes[b].size()){
+            std::swap(a, b);
+        }
+
+        parent[b] = a;
+        auto& dest = classes[a];
+        auto& src = classes[b];
+        dest.insert(dest.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+        src = std::vector<ENode>();
+        return true;
+    }
+
+    // Restore congruence: two nodes with the same op and equivalent children are equivalent
+    void rebuild(){
+        for (;;){
+            std::vector<std::pair<ClassId, ClassId>> congruent;
+            memo.clear();
+            node_count = 0;
+
+            for (ClassId c = 0; c < classes.size(); ++c){
+                if (find(c) != c){
+                    continue;
+                }
+
+                auto& nodes = classes[c];
+                for (auto& n: nodes){
+                    n = canonical(std::move(n));
+                }
+                std::sort(nodes.begin(), nodes.end());
+                nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+                node_count += nodes.size();
+
+                for (auto& n: nodes){
+                    auto r = memo.emplace(n, c);
+                    if (!r.second && find(r.first->second) != c){
+                        congruent.emplace_back(r.first->second, c);
+                    }
+                }
+            }
+
+            if (congruent.empty()){
+                return;
+            }
+
+            for (auto& pair: congruent){
+                merge(pair.first, pair.second);
+            }
+        }
+    }
+
+    std::optional<double> constant(ClassId c){
+        for (auto& n: classes[find(c)]){
+            if (n.op == NodeKind::Scalar){
+                return scalar_value(n.payload);
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<ClassId> parent;
+    std::vector<std::vector<ENode>> classes;
+    std::unordered_map<ENode, ClassId, ENodeHash> memo;
+    std::size_t node_count = 0;
+};
+
+// Insert an expression, shared sub expressions are only inserted once.
+// Post order with an explicit stack, deep expressions would overflow a recursion
+static ClassId insert_expr(EGraph& g, Expr const& root, std::unordered_map<ABSExpr*, ClassId>& seen){
+    // Node and whether its operands were pushed already
+    std::vector<std::pair<Expr const*, bool>> stack = {{&root, false}};
+
+    while (!stack.empty()){
+        auto [e, expanded] = stack.back();
+        if (seen.count(e->get())){
+            stack.pop_back();
+            continue;
+        }
+
+        ENode n;
+        n.op = (*e)->kind();
+
+        if (n.binary() && !expanded){
+            stack.back().second = true;
+            stack.push_back({&(*e)->child(1), false});
+            stack.push_back({&(*e)->child(0), false});
+            continue;
+        }
+        stack.pop_back();
+
+        switch (n.op){
+        case NodeKind::Add:
+        case NodeKind::Mult:
+            n.a = seen.at((*e)->child(0).get());
+            n.b = seen.at((*e)->child(1).get());
+            break;
+        case NodeKind::Placeholder:
+            n.payload = static_cast<Placeholder*>(e->get())->id();
+            n.leaf = *e;
+            break;
+        case NodeKind::Scalar:
+            n.payload = scalar_bits(static_cast<Scalar*>(e->get())->value());
+            n.leaf = *e;
+            break;
+        default:
+            n.payload = std::uint64_t(reinterpret_cast<std::uintptr_t>(e->get()));
+            n.leaf = *e;
+        }
+
+        seen.emplace(e->get(), g.add(std::move(n)));
+    }
+    return seen.at(root.get());
+}
+
+// Rewrite rules
+// --------------------------------------------
+enum class Rule{
+    Commute,        // a op b       => b op a
+    Associate,      // (a op b) op c => a op (b op c)
+    Distribute,     // a * (b + c)  => a * b + a * c
+    Factor,         // a * b + a * c => a * (b + c)
+    Fold,           // scalar op scalar => scalar
+    Same,           // target == a
+    Constant        // target == scalar
+};
+
+struct Match{
+    Rule rule;
+    NodeKind op;
+    ClassId target;
+    ClassId a = 0;
+    ClassId b = 0;
+    ClassId c = 0;
+    double value = 0;
+};
+
+static void match_node(EGraph& g, ClassId target, ENode const& n, std::vector<Match>& out){
+    if (!n.binary()){
+        return;
+    }
+
+    out.push_back({Rule::Commute, n.op, target, n.a, n.b});
+
+    for (auto& m: g.classes[g.find(n.a)]){
+        if (m.op == n.op){
+            out.push_back({Rule::Associate, n.op, target, m.a, m.b, n.b});
+        }
+    }
+
+    if (n.op == NodeKind::Mult){
+        for (auto& m: g.classes[g.find(n.b)]){
+            if (m.op == NodeKind::Add){
+                out.push_back({Rule::Distribute, n.op, target, n.a, m.a, m.b});
+            }
+        }
+    } else {
+        for (auto& l: g.classes[g.find(n.a)]){
+            if (l.op != NodeKind::Mult){
+                continue;
+            }
+            for (auto& r: g.classes[g.find(n.b)]){
+                if (r.op == NodeKind::Mult && g.find(l.a) == g.find(r.a)){
+                    out.push_back({Rule::Factor, n.op, target, l.a, l.b, r.b});
+                }
+            }
+        }
+    }
+
+    auto ca = g.constant(n.a);
+    auto cb = g.constant(n.b);
+
+    if (ca && cb){
+        double v = n.op == NodeKind::Add ? *ca + *cb : *ca * *cb;
+        out.push_back({Rule::Fold, n.op, target, 0, 0, 0, v});
+    }
+
+    if (cb){
+        if (n.op == NodeKind::Add && *cb == 0){
+            out.push_back({Rule::Same, n.op, target, n.a});
+        } else if (n.op == NodeKind::Mult && *cb == 1){
+            out.push_back({Rule::Same, n.op, target, n.a});
+        } else if (n.op == NodeKind::Mult && *cb == 0){
+            out.push_back({Rule::Constant, n.op, target, 0, 0, 0, 0});
+        }
+    }
+}
+
+static bool apply(EGraph& g, Match const& m){
+    switch (m.rule){
+    case Rule::Commute:
+        return g.merge(m.target, g.binary(m.op, m.b, m.a));
+    case Rule::Associate:
+        return g.merge(m.target, g.binary(m.op, m.a, g.binary(m.op, m.b, m.c)));
+    case Rule::Distribute:
+        return g.merge(m.target, g.binary(NodeKind::Add,
+                                          g.binary(NodeKind::Mult, m.a, m.b),
+                                          g.binary(NodeKind::Mult, m.a, m.c)));
+    case Rule::Factor:
+        return g.merge(m.target, g.binary(NodeKind::Mult, m.a, g.binary(NodeKind::Add, m.b, m.c)));
+    case Rule::Same:
+        return g.merge(m.target, m.a);
+    case Rule::Fold:
+    case Rule::Constant:
+        return g.merge(m.target, g.scalar(m.value));
+    }
+    return false;
+}
+
+// Extraction
+// --------------------------------------------
+static double node_cost(ENode const& n, CostModel const& cost){
+    switch (n.op){
+    case NodeKind::Placeholder: return cost.placeholder;
+    case NodeKind::Scalar:      return cost.scalar;
+    case NodeKind::Add:         return cost.add;
+    case NodeKind::Mult:        return cost.mult;
+    default:                    return cost.other;
+    }
+}
+
+struct Extractor{
+    EGraph& g;
+    std::vector<ENode const*> best;
+    std::vector<Expr> built;
+
+    // Post order with an explicit stack like insert_expr()
+    Expr build(ClassId root){
+        // Class and whether its operands were pushed already
+        std::vector<std::pair<ClassId, bool>> stack = {{g.find(root), false}};
+
+        while (!stack.empty()){
+            auto [c, expanded] = stack.back();
+            if (built[c]){
+                stack.pop_back();
+                continue;
+            }
+
+            ENode const& n = *best[c];
+            if (n.binary() && !expanded){
+                stack.back().second = true;
+                stack.push_back({g.find(n.b), false});
+                stack.push_back({g.find(n.a), false});
+                continue;
+            }
+            stack.pop_back();
+
+            Expr e;
+            switch (n.op){
+            case NodeKind::Add:  e = Add::make(built[g.find(n.a)], built[g.find(n.b)]); break;
+            case NodeKind::Mult: e = Mult::make(built[g.find(n.a)], built[g.find(n.b)]); break;
+            case NodeKind::Scalar:
+                e = n.leaf ? n.leaf : Scalar::make(scalar_value(n.payload));
+                break;
+            default:
+                e = n.leaf;
+            }
+            built[c] = e;
+        }
+        return built[g.find(root)];
+    }
+};
+
+static Expr extract(EGraph& g, ClassId root, CostModel const& cost){
+    std::size_t size = g.classes.size();
+    std::vector<double> best_cost(size, std::numeric_limits<double>::infinity());
+    std::vector<ENode const*> best(size, nullptr);
+
+    // Costs only decrease so this converges, cycles stay at infinity until broken
+    bool changed = true;
+    while (changed){
+        changed = false;
+
+        for (ClassId c = 0; c < size; ++c){
+            if (g.find(c) != c){
+                continue;
+            }
+
+            for (auto& n: g.classes[c]){
+                double k = node_cost(n, cost);
+                if (n.binary()){
+                    k += best_cost[g.find(n.a)] + best_cost[g.find(n.b)];
+                }
+
+                if (k < best_cost[c]){
+                    best_cost[c] = k;
+                    best[c] = &n;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    Extractor extractor{g, std::move(best), std::vector<Expr>(size)};
+    return extractor.build(root);
+}
+
+Expr optimize(Expr f, OptimizeBudget const& budget, CostModel const& cost){
+    auto start = Clock::now();
+    auto out_of_time = [&](){ return Clock::now() - start > budget.time_limit; };
+
+    EGraph g;
+    std::unordered_map<ABSExpr*, ClassId> seen;
+    ClassId root = insert_expr(g, f, seen);
+    seen.clear();
+
+    std::vector<Match> matches;
+
+    for (std::size_t iteration = 0; iteration < budget.max_iterations; ++iteration){
+        if (g.node_count >= budget.max_nodes || out_of_time()){
+            break;
+        }
+
+        matches.clear();
+        for (ClassId c = 0; c < g.classes.size() && matches.size() < budget.max_nodes; ++c){
+            if (g.find(c) != c){
+                continue;
+            }
+
+            for (auto& n: g.classes[c]){
+                match_node(g, c, n, matches);
+            }
+        }
+
+        // Merges and insertions invalidate the node references, matches only hold class ids
+        std::size_t classes_before = g.classes.size();
+        bool changed = false;
+
+        for (std::size_t i = 0; i < matches.size(); ++i){
+            if (g.node_count >= budget.max_nodes || ((i & 1023) == 0 && out_of_time())){
+                break;
+            }
+            changed |= apply(g, matches[i]);
+        }
+
+        g.rebuild();
+
+        // Saturated: nothing new can be learned
+        if (!changed && classes_before == g.classes.size()){
+            break;
+        }
+    }
+
+    return extract(g, root, cost);
+}
+}
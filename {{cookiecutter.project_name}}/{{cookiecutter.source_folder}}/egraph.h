@@ -0,0 +1,41 @@
+#ifndef PROJECT_TEST_SRC_EGRAPH_HEADER
+#define PROJECT_TEST_SRC_EGRAPH_HEADER
+
+#include "symbolic.h"
+
+#include <chrono>
+#include <cstddef>
+
+namespace sym
+{
+
+// Cost of each node kind used to pick the cheapest equivalent expression.
+// All costs must be strictly positive.
+struct CostModel{
+    double placeholder  = 1;
+    double scalar       = 1;
+    double add          = 1;
+    double mult         = 2;
+    double other        = 1;    // nodes the optimizer does not know how to rewrite
+};
+
+// Limits of the equality saturation, the search stops at the first limit reached
+struct OptimizeBudget{
+    std::size_t max_nodes = 10000;
+    std::size_t max_iterations = 16;
+    std::chrono::milliseconds time_limit = std::chrono::milliseconds(100);
+};
+
+/*!
+ * \brief Rewrite an expression into a cheaper equivalent one using equality saturation.
+ *
+ * An e-graph is built over `f` then commutativity, associativity, distributivity, factoring
+ * (`a * b + a * c` => `a * (b + c)`), constant folding and identity rules are applied until
+ * saturation or until the budget runs out. The cheapest expression under `cost` is extracted,
+ * shared sub expressions are returned as shared nodes.
+ */
+Expr optimize(Expr f, OptimizeBudget const& budget = OptimizeBudget(), CostModel const& cost = CostModel());
+
+}
+
+#endif
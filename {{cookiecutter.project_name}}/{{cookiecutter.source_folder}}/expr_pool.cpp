@@ -0,0 +1,100 @@
+#include "expr_pool.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace sym{
+
+bool ExprPool::valid(ExprHandle h) const {
+    return h && h.index() < _slots.size() &&
+           _slots[h.index()].generation == h.generation() && _slots[h.index()].expr;
+}
+
+ExprHandle ExprPool::insert(Expr const& e){
+    if (!e){
+        return ExprHandle();
+    }
+
+    auto it = _index.find(e.get());
+    if (it != _index.end()){
+        return ExprHandle(it->second, _slots[it->second].generation);
+    }
+
+    std::uint32_t index;
+    if (!_free.empty()){
+        index = _free.back();
+        _free.pop_back();
+    } else {
+        if (_slots.size() > ExprHandle::max_index){
+            throw std::length_error("expression pool is full");
+        }
+        index = std::uint32_t(_slots.size());
+        _slots.emplace_back();
+    }
+
+    _slots[index].expr = e;
+    _index.emplace(e.get(), index);
+    return ExprHandle(index, _slots[index].generation);
+}
+
+Expr ExprPool::get(ExprHandle h) const {
+    return valid(h) ? _slots[h.index()].expr : nullptr;
+}
+
+Expr ExprPool::at(ExprHandle h) const {
+    if (!valid(h)){
+        throw std::out_of_range("stale expression handle " + std::to_string(h.raw()));
+    }
+    return _slots[h.index()].expr;
+}
+
+ExprHandle ExprPool::find(Expr const& e) const {
+    auto it = _index.find(e.get());
+    return it != _index.end() ? ExprHandle(it->second, _slots[it->second].generation) : ExprHandle();
+}
+
+std::size_t ExprPool::collect(std::vector<ExprHandle> const& roots){
+    std::vector<Expr> exprs;
+    for (ExprHandle h: roots){
+        if (Expr e = get(h)){
+            exprs.push_back(std::move(e));
+        }
+    }
+    return collect(exprs);
+}
+
+std::size_t ExprPool::collect(std::vector<Expr> const& roots){
+    std::vector<bool> reachable(_slots.size(), false);
+
+    std::vector<Expr> live;
+    for (auto& root: roots){
+        if (root){
+            live.push_back(root);
+        }
+    }
+
+    for (ABSExpr* node: topological_order(live)){
+        auto it = _index.find(node);
+        if (it != _index.end()){
+            reachable[it->second] = true;
+        }
+    }
+
+    std::size_t released = 0;
+    for (std::uint32_t i = 0; i < _slots.size(); ++i){
+        Slot& slot = _slots[i];
+        if (!slot.expr || reachable[i]){
+            continue;
+        }
+
+        _index.erase(slot.expr.get());
+        slot.expr = nullptr;
+        released += 1;
+
+        // Skip 0, the handle of index 0 and generation 0 is the null handle
+        slot.generation = slot.generation < ExprHandle::max_generation ? slot.generation + 1 : 1;
+        _free.push_back(i);
+    }
+    return released;
+}
+}
@@ -0,0 +1,138 @@
+#ifndef PROJECT_TEST_SRC_EXPR_POOL_HEADER
+#define PROJECT_TEST_SRC_EXPR_POOL_HEADER
+
+#include "symbolic.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace sym
+{
+
+/*!
+ * \brief 32 bit weak reference to an expression stored in an ExprPool.
+ *
+ * 24 bits of slot index and 8 bits of generation. The generation of a slot changes every
+ * time it is collected, so a handle to a collected expression is detected instead of
+ * silently pointing to the expression that reused the slot. The null handle is 0.
+ *
+ * Generations wrap from 255 back to 1, a handle kept while its slot is collected 255 times
+ * becomes valid again and points to whatever the slot holds then. Collect holders of stale
+ * handles at least as often as the pool.
+ */
+class ExprHandle
+{
+public:
+    static constexpr std::uint32_t index_bits = 24;
+    static constexpr std::uint32_t generation_bits = 8;
+    static constexpr std::uint32_t max_index = (1u << index_bits) - 1;
+    static constexpr std::uint32_t max_generation = (1u << generation_bits) - 1;
+
+    ExprHandle() noexcept = default;
+
+    ExprHandle(std::uint32_t index, std::uint32_t generation) noexcept:
+        _raw((generation << index_bits) | (index & max_index))
+    {}
+
+    static ExprHandle from_raw(std::uint32_t raw) noexcept { ExprHandle h; h._raw = raw; return h; }
+
+    std::uint32_t index() const noexcept        { return _raw & max_index; }
+    std::uint32_t generation() const noexcept   { return _raw >> index_bits; }
+    std::uint32_t raw() const noexcept          { return _raw; }
+
+    explicit operator bool() const noexcept     { return _raw != 0; }
+
+    bool operator==(ExprHandle h) const noexcept { return _raw == h._raw; }
+    bool operator!=(ExprHandle h) const noexcept { return _raw != h._raw; }
+
+private:
+    std::uint32_t _raw = 0;
+};
+
+/*!
+ * \brief Owns expressions on behalf of compact handles.
+ *
+ * Caches that keep a very large number of references hold 4 byte handles instead of Expr
+ * (8 bytes and an atomic increment per copy). The pool keeps a strong reference to each
+ * inserted node until collect() releases the nodes that are not reachable from the given
+ * roots, the memory used by a long running cache is bounded by what is still in use.
+ * Every released slot is reused, see ExprHandle for the generation wrap around.
+ *
+ * Not thread safe, guard the pool like a Context.
+ *
+ * \code
+ *  sym::ExprPool pool;
+ *  sym::ExprHandle h = pool.insert(f->derivate("x"));
+ *  ...
+ *  pool.collect({root});               // h survives only if reachable from root
+ *  if (sym::Expr e = pool.get(h)){ ... }
+ * \endcode
+ */
+class ExprPool
+{
+public:
+    ExprPool() = default;
+
+    ExprPool(const ExprPool&) = delete;
+    ExprPool& operator=(const ExprPool&) = delete;
+
+    // Inserting the same node twice returns the same handle.
+    // Throws std::length_error when every index is in use
+    ExprHandle insert(Expr const& e);
+
+    // Checked weak access: nullptr when the handle is null or stale.
+    // A handle only holds an index and a generation, a handle of another pool is not detected
+    Expr get(ExprHandle h) const;
+
+    // Throws std::out_of_range instead of returning nullptr
+    Expr at(ExprHandle h) const;
+
+    bool alive(ExprHandle h) const { return get(h) != nullptr; }
+
+    // Handle of a node that is in the pool, the null handle otherwise
+    ExprHandle find(Expr const& e) const;
+
+    /*!
+     * \brief Release every node that is not reachable from `roots`.
+     *
+     * Handles to released nodes become stale, the nodes themselves are freed unless
+     * an Expr outside of the pool still owns them. Returns the number of released nodes.
+     */
+    std::size_t collect(std::vector<ExprHandle> const& roots);
+    std::size_t collect(std::vector<Expr> const& roots);
+
+    // Nodes currently held by the pool
+    std::size_t size() const        { return _index.size(); }
+
+    // Slots allocated so far, bounded by the largest number of nodes held at once
+    std::size_t capacity() const    { return _slots.size(); }
+
+private:
+    struct Slot{
+        Expr expr;
+        std::uint32_t generation = 1;
+    };
+
+    bool valid(ExprHandle h) const;
+
+    std::vector<Slot> _slots;
+    std::vector<std::uint32_t> _free;
+    std::unordered_map<ABSExpr*, std::uint32_t> _index;
+};
+
+}
+
+namespace std
+{
+template<>
+struct hash<sym::ExprHandle>{
+    std::size_t operator()(sym::ExprHandle h) const noexcept {
+        return std::hash<std::uint32_t>()(h.raw());
+    }
+};
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include <spdlog/details/os.h>
+
+#include "flight_recorder.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace sym{
+
+// Rings
+// --------------------------------------------
+// A slot is a seqlock of 16 words: the sequence is odd while the thread writes the slot,
+// readers copy the words and drop the copy if the sequence changed in between.
+// Every word is atomic so a reader racing with the writer is well defined
+namespace {
+constexpr std::size_t args_words = flight_event_args / sizeof(std::uint64_t);
+
+struct alignas(64) FlightSlot{
+    std::atomic<std::uint64_t> seq{0};      // 0 never written
+    std::atomic<std::uint64_t> time{0};
+    std::atomic<std::uint64_t> thread{0};
+    std::atomic<std::uint64_t> meta{0};     // site | size << 32
+    std::atomic<std::uint64_t> args[args_words] = {};
+};
+
+static_assert(sizeof(FlightSlot) == 128, "a slot is two cache lines");
+
+struct FlightRing{
+    FlightSlot slots[flight_recorder_capacity];
+    std::uint64_t head = 0;                 // events written, only used by the owner
+    std::atomic<bool> in_use{true};
+    FlightRing* next = nullptr;             // set before the ring is published
+};
+
+// Rings are never freed, the ring of a thread that exited is taken by the next new thread
+std::atomic<FlightRing*> flight_rings{nullptr};
+
+// Events older than this are ignored, set by clear_flight_recorder()
+std::atomic<std::uint64_t> flight_cleared{0};
+
+std::uint64_t steady_ns(){
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::uint64_t wall_ns(){
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+FlightRing* acquire_ring(){
+    FlightRing* head = flight_rings.load(std::memory_order_acquire);
+    for (FlightRing* ring = head; ring; ring = ring->next){
+        bool free = false;
+        if (ring->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)){
+            return ring;
+        }
+    }
+
+    FlightRing* ring = new FlightRing();
+    do {
+        ring->next = head;
+    } while (!flight_rings.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_acquire));
+    return ring;
+}
+
+thread_local FlightRing* thread_ring = nullptr;
+
+// Set once the recorder of the thread is destroyed: the log calls of the thread_local
+// destructors that run after it are not recorded, the ring may belong to a new thread
+thread_local bool thread_recorder_exited = false;
+
+// Gives the ring back when the thread exits
+struct RingOwner{
+    FlightRing* ring = nullptr;
+    std::string scratch;                    // encoded arguments, reused between records
+
+    ~RingOwner(){
+        thread_recorder_exited = true;
+        thread_ring = nullptr;
+        if (ring){
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingOwner thread_ring_owner;
+
+// Null once the thread is exiting
+FlightRing* current_ring(){
+    if (!thread_ring && !thread_recorder_exited){
+        thread_ring = acquire_ring();
+        thread_ring_owner.ring = thread_ring;
+    }
+    return thread_ring;
+}
+
+bool read_slot(FlightSlot const& slot, FlightRecord& record){
+    std::uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq == 0 || (seq & 1)){
+        return false;
+    }
+
+    record.time = slot.time.load(std::memory_order_relaxed);
+    record.thread = slot.thread.load(std::memory_order_relaxed);
+    std::uint64_t meta = slot.meta.load(std::memory_order_relaxed);
+
+    std::uint64_t words[args_words];
+    for (std::size_t i = 0; i < args_words; ++i){
+        words[i] = slot.args[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq){
+        return false;
+    }
+
+    record.site = std::uint32_t(meta);
+    record.size = std::min<std::uint32_t>(std::uint32_t(meta >> 32), flight_event_args);
+    std::memcpy(record.args, words, sizeof(words));
+    return record.time >= flight_cleared.load(std::memory_order_relaxed);
+}
+}
+
+void set_flight_recorder_level(LogLevel level){
+    flight_recorder_threshold.store(int(level), std::memory_order_relaxed);
+}
+
+std::string* flight_record_scratch(){
+    return thread_recorder_exited ? nullptr : &thread_ring_owner.scratch;
+}
+
+void commit_flight_record(std::uint32_t site, std::string_view args){
+    FlightRing* ring = current_ring();
+    if (!ring){
+        return;
+    }
+    FlightSlot& slot = ring->slots[ring->head % flight_recorder_capacity];
+    std::uint64_t seq = 2 * ring->head + 1;
+    ring->head += 1;
+
+    std::uint64_t words[args_words] = {};
+    std::memcpy(words, args.data(), std::min(args.size(), flight_event_args));
+
+    slot.seq.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.time.store(steady_ns(), std::memory_order_relaxed);
+    slot.thread.store(spdlog::details::os::thread_id(), std::memory_order_relaxed);
+    slot.meta.store(site | (std::uint64_t(args.size()) << 32), std::memory_order_relaxed);
+    for (std::size_t i = 0; i < args_words; ++i){
+        slot.args[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    slot.seq.store(seq + 1, std::memory_order_release);
+}
+
+void visit_flight_records(void (*fn)(FlightRecord const& record, void* data), void* data){
+    FlightRecord record;
+    for (FlightRing* ring = flight_rings.load(std::memory_order_acquire); ring; ring = ring->next){
+        for (FlightSlot const& slot: ring->slots){
+            if (read_slot(slot, record)){
+                fn(record, data);
+            }
+        }
+    }
+}
+
+std::vector<FlightEvent> flight_recorder_events(){
+    std::vector<FlightRecord> records;
+    visit_flight_records([](FlightRecord const& record, void* data){
+        static_cast<std::vector<FlightRecord>*>(data)->push_back(record);
+    }, &records);
+
+    std::sort(records.begin(), records.end(), [](auto const& a, auto const& b){
+        return a.time < b.time;
+    });
+
+    // Steady clock to wall clock
+    std::uint64_t offset = wall_ns() - steady_ns();
+
+    std::vector<FlightEvent> events;
+    events.reserve(records.size());
+    for (FlightRecord const& record: records){
+        LogSiteInfo const* site = find_log_site(record.site);
+        if (!site){
+            continue;
+        }
+        events.push_back(FlightEvent{site->level, record.time + offset, record.thread, site->loc,
+                                     format_log_args(site->format, std::string_view(record.args, record.size))});
+    }
+    return events;
+}
+
+void clear_flight_recorder(){
+    flight_cleared.store(steady_ns() + 1, std::memory_order_relaxed);
+}
+
+}
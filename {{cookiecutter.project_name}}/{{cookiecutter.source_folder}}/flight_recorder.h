@@ -0,0 +1,122 @@
+#ifndef PROJECT_TEST_SRC_FLIGHT_RECORDER_HEADER
+#define PROJECT_TEST_SRC_FLIGHT_RECORDER_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "binary_log.h"
+
+namespace sym
+{
+
+/*!
+ * \brief Last log events of each thread, kept in memory in binary form.
+ *
+ * Every log call at or above the recorder level (WARN by default) writes its call site,
+ * time and encoded arguments to a ring owned by the thread, even when the message itself
+ * is filtered out by the log level. Nothing is formatted, once warm a record costs about
+ * the price of reading the clock so the recorder can stay on in production. The first
+ * record of a site takes the site lock to register it, and the encoding buffer of a
+ * thread allocates until it reaches the size of its largest record.
+ *
+ * The recorded calls evaluate and encode their arguments, lowering the recorder level
+ * below the log level gives up the free filtered calls of those levels.
+ *
+ * The rings are dumped by show_log_backtrace() and written to the crash report by the
+ * crash handler.
+ *
+ * \code
+ *  warn("step {} dt={}", step, dt);    // recorded even if the log level is ERROR
+ *  ...
+ *  show_log_backtrace();               // last events of every thread, oldest first
+ * \endcode
+ */
+
+// Events kept per thread, older events are overwritten
+constexpr std::size_t flight_recorder_capacity = 256;
+
+// Bytes of encoded arguments kept per event, the arguments after this limit are dropped
+constexpr std::size_t flight_event_args = 96;
+
+// Log calls below this level are not recorded (0 = TRACE ... 6 = OFF)
+inline std::atomic<int> flight_recorder_threshold{3};
+
+// False when log calls of `level` are not recorded
+inline bool flight_recorder_enabled(LogLevel level){
+    return int(level) >= flight_recorder_threshold.load(std::memory_order_relaxed);
+}
+
+// Record the log calls from `level` up, LogLevel::OFF turns the recorder off
+void set_flight_recorder_level(LogLevel level);
+
+// Event as stored in the ring
+struct FlightRecord{
+    std::uint64_t time;                 // steady clock (ns)
+    std::uint64_t thread;
+    std::uint32_t site;                 // see find_log_site()
+    std::uint32_t size;                 // bytes used in args
+    char args[flight_event_args];
+};
+
+// Call `fn` on every event of every thread, in no particular order.
+// Lock free and async-signal-safe, events written during the visit may be skipped
+void visit_flight_records(void (*fn)(FlightRecord const& record, void* data), void* data);
+
+// Event formatted for display
+struct FlightEvent{
+    LogLevel level;
+    std::uint64_t time;                 // wall clock (ns since epoch)
+    std::uint64_t thread;
+    CodeLocation const* loc;
+    std::string text;                   // message only, without the location
+};
+
+// Events of every thread sorted by time, oldest first
+std::vector<FlightEvent> flight_recorder_events();
+
+// Forget the recorded events
+void clear_flight_recorder();
+
+// Write an event to the ring of the calling thread, `args` are encoded arguments
+void commit_flight_record(std::uint32_t site, std::string_view args);
+
+// Encoded arguments of the calling thread, reused between records.
+// Null once the thread is exiting, its events are not recorded anymore
+std::string* flight_record_scratch();
+
+template<typename ... Args>
+void record_flight_event(LogSite& site, LogLevel level, CodeLocation const& loc, const char* fmt, const Args& ... args){
+    std::uint32_t id = log_site_id(site, level, loc, fmt);
+
+    std::string* scratch = flight_record_scratch();
+    if (!scratch){
+        return;
+    }
+
+    // Stop at the last argument that fits, the decoder reads up to the end of the record
+    std::string& out = *scratch;
+    out.clear();
+    bool fits = true;
+    auto encode = [&](auto const& value){
+        if (!fits){
+            return;
+        }
+        std::size_t size = out.size();
+        encode_log_arg(out, value);
+        if (out.size() > flight_event_args){
+            out.resize(size);
+            fits = false;
+        }
+    };
+    (encode(args), ...);
+    (void) encode;
+    commit_flight_record(id, out);
+}
+
+}
+
+#endif
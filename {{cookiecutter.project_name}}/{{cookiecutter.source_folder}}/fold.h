@@ -0,0 +1,37 @@
+#ifndef PROJECT_TEST_SRC_FOLD_HEADER
+#define PROJECT_TEST_SRC_FOLD_HEADER
+
+#include "symbolic.h"
+
+#include <utility>
+
+// Internal: sums and products that fold their neutral and absorbing elements,
+// used by the derivative passes so the expressions they build stay small
+namespace sym
+{
+
+// True when `e` is the scalar constant `v`
+inline bool is_constant(Expr const& e, double v){
+    return e->kind() == NodeKind::Scalar && static_cast<Scalar*>(e.get())->value() == v;
+}
+
+// a + b without its zero terms, a null `a` is an empty sum.
+// Zero terms are dropped rather than broadcast, their 1 x 1 shape would not match a tensor
+inline Expr fold_add(Expr a, Expr b){
+    if (!a || is_constant(a, 0)) return b;
+    if (is_constant(b, 0))       return a;
+    return add(std::move(a), std::move(b));
+}
+
+// a * b, 0 when a factor is 0 and the other factor when one is 1
+inline Expr fold_mult(Expr a, Expr b){
+    if (is_constant(a, 0)) return a;
+    if (is_constant(b, 0)) return b;
+    if (is_constant(a, 1)) return b;
+    if (is_constant(b, 1)) return a;
+    return mult(std::move(a), std::move(b));
+}
+
+}
+
+#endif
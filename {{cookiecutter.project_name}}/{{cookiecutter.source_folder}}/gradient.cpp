@@ -0,0 +1,66 @@
+#include "gradient.h"
+#include "context.h"
+#include "fold.h"
+
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sym{
+
+std::vector<Expr> symbolic_gradient(Expr const& f, std::vector<std::string> const& vars){
+    std::vector<ABSExpr*> order = topological_order(f);
+
+    // Adjoint of each node: d f / d node, accumulated over every parent
+    std::unordered_map<ABSExpr*, Expr> adjoint;
+    std::unordered_map<SymbolId, Expr> by_symbol;
+    adjoint[f.get()] = Scalar::make(1);
+
+    auto accumulate = [&](Expr const& node, Expr const& contribution){
+        Expr& slot = adjoint[node.get()];
+        slot = fold_add(slot, contribution);
+    };
+
+    // Parents are visited before their children so adjoints are complete when used
+    for (auto it = order.rbegin(); it != order.rend(); ++it){
+        ABSExpr* node = *it;
+
+        auto found = adjoint.find(node);
+        if (found == adjoint.end()){
+            continue;
+        }
+        Expr g = found->second;
+
+        switch (node->kind()){
+        case NodeKind::Add:
+            accumulate(node->child(0), g);
+            accumulate(node->child(1), g);
+            break;
+        case NodeKind::Mult:
+            accumulate(node->child(0), fold_mult(g, node->child(1)));
+            accumulate(node->child(1), fold_mult(g, node->child(0)));
+            break;
+        case NodeKind::Placeholder: {
+            Expr& slot = by_symbol[static_cast<Placeholder*>(node)->id()];
+            slot = fold_add(slot, g);
+            break;
+        }
+        case NodeKind::Scalar:
+            break;
+        default:
+            throw std::invalid_argument(std::string("cannot differentiate node ") + to_string(node->kind()));
+        }
+
+        // Adjoints of inner nodes are not needed anymore, the outputs keep what they use
+        adjoint.erase(node);
+    }
+
+    std::vector<Expr> gradient;
+    gradient.reserve(vars.size());
+
+    for (auto& var: vars){
+        auto found = by_symbol.find(try_intern(var));
+        gradient.push_back(found != by_symbol.end() ? found->second : Scalar::make(0));
+    }
+    return gradient;
+}
+}
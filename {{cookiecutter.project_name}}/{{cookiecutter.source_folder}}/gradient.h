@@ -0,0 +1,24 @@
+#ifndef PROJECT_TEST_SRC_GRADIENT_HEADER
+#define PROJECT_TEST_SRC_GRADIENT_HEADER
+
+#include "symbolic.h"
+
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+/*!
+ * \brief Partial derivatives of `f` with respect to each of `vars`, in the same order.
+ *
+ * The gradient is computed by reverse accumulation performed symbolically: the adjoint
+ * of every node is built once and shared by all the outputs, so the returned roots form a
+ * single DAG whose size is O(size of f) instead of O(n x size of f) with one derivate()
+ * call per variable.
+ */
+std::vector<Expr> symbolic_gradient(Expr const& f, std::vector<std::string> const& vars);
+
+}
+
+#endif
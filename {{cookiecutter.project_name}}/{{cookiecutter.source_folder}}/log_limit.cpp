@@ -0,0 +1,90 @@
+#include "log_limit.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace sym{
+
+namespace {
+constexpr int window_bits = 24;
+constexpr std::uint64_t window_mask = (std::uint64_t(1) << window_bits) - 1;
+
+// Sites that dropped a call, push only
+std::atomic<LogLimit*> suppressing_sites{nullptr};
+
+std::uint64_t steady_seconds(){
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+}
+
+bool admit_first_n(LogLimit& limit, std::uint64_t n){
+    return limit.calls.fetch_add(1, std::memory_order_relaxed) < n;
+}
+
+bool admit_every_n(LogLimit& limit, std::uint64_t k){
+    return k <= 1 || limit.calls.fetch_add(1, std::memory_order_relaxed) % k == 0;
+}
+
+bool admit_per_second(LogLimit& limit, std::uint64_t n){
+    if (n == 0){
+        return false;
+    }
+
+    std::uint64_t now = steady_seconds() << window_bits;
+    std::uint64_t window = limit.window.load(std::memory_order_relaxed);
+
+    for (;;){
+        std::uint64_t next;
+        if ((window & ~window_mask) != now){
+            next = now | 1;                     // first call of a new second
+        } else if ((window & window_mask) < std::min(n, window_mask)){
+            next = window + 1;
+        } else {
+            return false;
+        }
+
+        if (limit.window.compare_exchange_weak(window, next, std::memory_order_relaxed)){
+            return true;
+        }
+    }
+}
+
+void suppress_log(LogLimit& limit, LogLevel level, CodeLocation const& loc){
+    limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+    if (limit.listed.load(std::memory_order_relaxed)){
+        return;
+    }
+
+    bool expected = false;
+    if (!limit.listed.compare_exchange_strong(expected, true, std::memory_order_relaxed)){
+        return;
+    }
+
+    limit.level = level;
+    limit.loc = &loc;
+    LogLimit* head = suppressing_sites.load(std::memory_order_relaxed);
+    do {
+        limit.next = head;
+    } while (!suppressing_sites.compare_exchange_weak(head, &limit, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void report_suppressed(LogLimit& limit, LogLevel level, CodeLocation const& loc){
+    if (limit.suppressed.load(std::memory_order_relaxed) == 0){
+        return;
+    }
+
+    std::uint64_t n = limit.suppressed.exchange(0, std::memory_order_relaxed);
+    if (n > 0){
+        log(level, loc, "{} similar messages suppressed", n);
+    }
+}
+
+void report_suppressed_logs(){
+    for (LogLimit* limit = suppressing_sites.load(std::memory_order_acquire); limit; limit = limit->next){
+        report_suppressed(*limit, limit->level, *limit->loc);
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef PROJECT_TEST_SRC_LOG_LIMIT_HEADER
+#define PROJECT_TEST_SRC_LOG_LIMIT_HEADER
+
+#include <atomic>
+#include <cstdint>
+
+namespace sym
+{
+
+struct CodeLocation;
+enum class LogLevel;
+
+/*!
+ * \brief Limit on the messages of a log call site, one per macro in static storage.
+ *
+ * The limited log macros keep a LogLimit next to their call site and only log the calls
+ * it admits, the other calls return before their arguments are evaluated. A limit is a
+ * few atomics updated with compare and swap, there is no lock shared between sites.
+ *
+ * The calls dropped by a limit are counted, the count is logged as
+ * "N similar messages suppressed" before the next admitted message of the site,
+ * or by report_suppressed_logs() for the sites that stopped logging.
+ *
+ * \code
+ *  SYM_LOG_PER_SECOND(WARN, 5, "late frame {}", frame);      // at most 5 per second
+ *  SYM_LOG_EVERY_N(DEBUG, 100, "step {}", step);             // 1 call in 100
+ *  SYM_LOG_FIRST_N(ERROR, 10, "bad vertex {}", id);          // first 10 calls
+ * \endcode
+ */
+struct LogLimit{
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> window{0};       // second << 24 | messages admitted in that second
+    std::atomic<std::uint64_t> suppressed{0};   // not reported yet
+
+    // Set when the site first drops a call, for report_suppressed_logs()
+    std::atomic<bool> listed{false};
+    LogLevel level;
+    CodeLocation const* loc = nullptr;
+    LogLimit* next = nullptr;
+};
+
+// Admit the first `n` calls of the site
+bool admit_first_n(LogLimit& limit, std::uint64_t n);
+
+// Admit one call in `k`, starting with the first
+bool admit_every_n(LogLimit& limit, std::uint64_t k);
+
+// Admit at most `n` calls per second of the steady clock, none when `n` is 0
+bool admit_per_second(LogLimit& limit, std::uint64_t n);
+
+// Count a dropped call
+void suppress_log(LogLimit& limit, LogLevel level, CodeLocation const& loc);
+
+// Log the count of calls dropped since the last report, if any
+void report_suppressed(LogLimit& limit, LogLevel level, CodeLocation const& loc);
+
+// Report the calls dropped by every site, for the sites that stopped logging
+void report_suppressed_logs();
+
+}
+
+#endif
@@ -1,67 +1,56 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/details/os.h>
 
 #include "logger.h"
+#include "crash_handler.h"
+#include "ring_buffer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <cstdarg>
+#include <exception>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <memory>
+#include <string_view>
 
-// Linux signal handling & stack trace printing
+// Stack trace printing
 // --------------------------------------------
-#ifdef __linux__
-#include <execinfo.h>
-#include <signal.h>
-#endif
-
 namespace sym{
-#ifdef __linux__
 std::vector<std::string> get_backtrace(size_t size){
-    std::vector<void *> ptrs(size);
-
-    int real_size = backtrace(ptrs.data(), int(ptrs.size()));
-
-    char ** symbols = backtrace_symbols(ptrs.data(), int(size));
-
-    std::vector<std::string> names((size_t(real_size)));
+    StackTrace trace = capture_stack_trace(1);
+    trace.size = std::min(trace.size, size);
 
-    for (int i = 0; i < real_size; ++i){
-        const char* line = symbols[i];
-        names[size_t(i)] = std::string(line);
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < trace.size; ++i){
+        names.push_back(symbolize(trace.frames[i]));
     }
-
     return names;
 }
 
-void show_backtrace() {
-    std::vector<std::string> symbols = get_backtrace(16);
-    for (auto& sym: symbols){
-        spdlog_log(LogLevel::CRITICAL, sym);
+void show_backtrace(StackTrace const& trace){
+    for (std::size_t i = 0; i < trace.size; ++i){
+        spdlog_log(LogLevel::CRITICAL, fmt::format("#{:<2} {} {}", i, trace.frames[i], symbolize(trace.frames[i])));
     }
 }
 
-void signal_handler(int sig){
-    spdlog_log(LogLevel::CRITICAL, fmt::format("Received signal {} >>>", sig));
-    show_backtrace();
-    spdlog_log(LogLevel::CRITICAL, "<<< Exiting");
-    exit(1);
+void show_backtrace() {
+    show_backtrace(capture_stack_trace(1));
 }
 
+// The crash handler replaces the SIGSEGV handler that used to log the backtrace
 int register_signal_handler(){
-    signal(SIGSEGV, signal_handler);   // install our handler
+    if (!crash_handler_installed()){
+        install_crash_handler();
+    }
     return 0;
 }
-#else
-void register_signal_handler(){}
-
-void show_backtrace(){}
-
-std::vector<std::string> get_backtrace(size_t size){
-    return std::vector<std::string>();
-}
-#endif
 // ==============================================================
 
 
@@ -72,8 +61,6 @@ Logger new_logger(char const* name){
     // Static so only executed once
     static int _ = register_signal_handler();
 
-    spdlog::enable_backtrace(32);
-
     auto stdout_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
 
     auto console = std::make_shared<spdlog::logger>(name, stdout_sink);
@@ -91,9 +78,20 @@ Logger new_logger(char const* name){
     return console;
 }
 
-Logger root(){
-    static Logger log = new_logger("root");
-    return log;
+// Never destroyed, log calls made while static objects are destroyed still find it
+Logger const& root(){
+    static Logger* log = new Logger(new_logger("root"));
+    return *log;
+}
+
+// Used by every log call: a raw pointer cached per thread does not touch the reference
+// count of the shared_ptr nor the guard of the static above
+spdlog::logger& root_logger(){
+    thread_local spdlog::logger* logger = nullptr;
+    if (!logger){
+        logger = root().get();
+    }
+    return *logger;
 }
 
 static constexpr spdlog::level::level_enum log_level_spd[] = {
@@ -107,15 +105,359 @@ static constexpr spdlog::level::level_enum log_level_spd[] = {
 };
 
 void show_log_backtrace(){
-    spdlog::dump_backtrace();
+    std::vector<FlightEvent> events = flight_recorder_events();
+
+    // After the messages already queued
+    flush_log();
+    spdlog::logger* logger = &root_logger();
+
+    auto write = [&](LogLevel level, spdlog::log_clock::time_point time, std::size_t thread, std::string_view text){
+        spdlog::details::log_msg msg(spdlog::source_loc{}, logger->name(), log_level_spd[int(level)],
+                                     spdlog::string_view_t(text.data(), text.size()));
+        msg.time = time;
+        msg.thread_id = thread;
+
+        for (auto& sink: logger->sinks()){
+            if (sink->should_log(msg.level)){
+                sink->log(msg);
+            }
+        }
+    };
+
+    auto now = spdlog::log_clock::now();
+    std::size_t thread = spdlog::details::os::thread_id();
+    write(LogLevel::INFO, now, thread, "****************** Backtrace Start ******************");
+
+    for (FlightEvent const& event: events){
+        auto time = spdlog::log_clock::time_point(std::chrono::duration_cast<spdlog::log_clock::duration>(
+            std::chrono::nanoseconds(event.time)));
+        std::string text = fmt::format("{}:{} {} - {}", event.loc->filename, event.loc->line,
+                                       event.loc->function_name, event.text);
+        write(event.level, time, std::size_t(event.thread), text);
+    }
+
+    write(LogLevel::INFO, now, thread, "****************** Backtrace End ********************");
+    logger->flush();
+}
+
+void set_log_level(LogLevel level){
+    log_threshold.store(int(level), std::memory_order_relaxed);
+}
+
+LogLevel log_level(){
+    return LogLevel(log_threshold.load(std::memory_order_relaxed));
+}
+
+// Asynchronous logging
+// --------------------------------------------
+namespace {
+struct FlushRequest{
+    std::mutex lock;
+    std::condition_variable done_cv;
+    bool done = false;
+};
+
+struct LogRecord{
+    LogLevel level;
+    spdlog::log_clock::time_point time;
+    std::size_t thread;
+    std::string text;                   // keeps its capacity between laps of the ring
+    FlushRequest* flush = nullptr;      // not a message, signaled once everything before is written
+};
+
+class AsyncBackend
+{
+public:
+    AsyncBackend(Logger logger, AsyncLogOptions const& options):
+        _logger(std::move(logger)), _ring(options.capacity), _batch(std::max<std::size_t>(options.batch, 1)),
+        _policy(int(options.overflow))
+    {
+        _writer = std::thread([this](){ run(); });
+    }
+
+    ~AsyncBackend(){
+        _stop.store(true);
+        wake();
+        _writer.join();
+    }
+
+    void set_policy(OverflowPolicy policy){
+        _policy.store(int(policy), std::memory_order_relaxed);
+    }
+
+    void push(LogLevel level, fmt::string_view msg){
+        auto fill = [&](LogRecord& r){
+            r.level = level;
+            r.time = spdlog::log_clock::now();
+            r.thread = spdlog::details::os::thread_id();
+            r.text.assign(msg.data(), msg.size());
+            r.flush = nullptr;
+        };
+
+        while (!_ring.try_push(fill)){
+            switch (OverflowPolicy(_policy.load(std::memory_order_relaxed))){
+            case OverflowPolicy::Block:
+                wake();
+                std::this_thread::yield();
+                break;
+            case OverflowPolicy::Drop:
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            case OverflowPolicy::DropOldest: {
+                FlushRequest* request = nullptr;
+                _ring.try_pop([&](LogRecord& r){
+                    request = r.flush;
+                    if (!request){
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+
+                // Flush requests are never dropped, they go back in the queue
+                if (request){
+                    push_flush(request);
+                }
+                break;
+            }
+            }
+        }
+        notify();
+    }
+
+    void flush(){
+        FlushRequest request;
+        push_flush(&request);
+        wake();
+
+        std::unique_lock<std::mutex> guard(request.lock);
+        request.done_cv.wait(guard, [&](){ return request.done; });
+    }
+
+    std::size_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void push_flush(FlushRequest* request){
+        while (!_ring.try_push([&](LogRecord& r){ r.flush = request; })){
+            wake();
+            std::this_thread::yield();
+        }
+    }
+
+    static void complete(FlushRequest* request){
+        std::lock_guard<std::mutex> guard(request->lock);
+        request->done = true;
+        request->done_cv.notify_all();
+    }
+
+    // Producers only take the lock when the writer is asleep
+    void notify(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed)){
+            wake();
+        }
+    }
+
+    void wake(){
+        std::lock_guard<std::mutex> guard(_lock);
+        _wake.notify_one();
+    }
+
+    void run(){
+        // A crash in a sink is reported by the crash handler
+        enable_crash_stack();
+
+        std::vector<FlushRequest*> flushes;
+
+        for (;;){
+            std::size_t written = 0;
+
+            while (written < _batch && _ring.try_pop([&](LogRecord& r){ write(r, flushes); })){
+                written += 1;
+            }
+
+            if (written > 0 || !flushes.empty()){
+                for (auto& sink: _logger->sinks()){
+                    try {
+                        sink->flush();
+                    } catch (std::exception const& e){
+                        sink_error(e.what());
+                    } catch (...){
+                        sink_error("Unknown exception in logger");
+                    }
+                }
+                for (FlushRequest* request: flushes){
+                    complete(request);
+                }
+                flushes.clear();
+                continue;
+            }
+
+            if (_stop.load()){
+                return;
+            }
+
+            // Sleep until a producer wakes us up, the timeout covers a missed notification
+            std::unique_lock<std::mutex> guard(_lock);
+            _sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_ring.empty() && !_stop.load()){
+                _wake.wait_for(guard, std::chrono::milliseconds(50));
+            }
+            _sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void write(LogRecord& r, std::vector<FlushRequest*>& flushes){
+        if (r.flush){
+            flushes.push_back(r.flush);
+            return;
+        }
+
+        spdlog::details::log_msg msg(spdlog::source_loc{}, _logger->name(), log_level_spd[int(r.level)],
+                                     spdlog::string_view_t(r.text.data(), r.text.size()));
+        msg.time = r.time;
+        msg.thread_id = r.thread;
+
+        for (auto& sink: _logger->sinks()){
+            if (sink->should_log(msg.level)){
+                try {
+                    sink->log(msg);
+                } catch (std::exception const& e){
+                    sink_error(e.what());
+                } catch (...){
+                    sink_error("Unknown exception in logger");
+                }
+            }
+        }
+    }
+
+    // Like the default error handler of spdlog: a sink that throws is reported on stderr
+    // at most once per second and the writer keeps draining, the exception would
+    // terminate the process from the writer thread
+    void sink_error(const char* what){
+        _sink_errors += 1;
+        auto now = std::chrono::steady_clock::now();
+        if (_sink_errors > 1 && now - _last_sink_error < std::chrono::seconds(1)){
+            return;
+        }
+        _last_sink_error = now;
+        std::fprintf(stderr, "[*** LOG ERROR #%04zu ***] [%s] {%s}\n", _sink_errors, _logger->name().c_str(), what);
+    }
+
+    Logger _logger;
+    RingBuffer<LogRecord> _ring;
+    std::size_t _batch;
+    std::atomic<int> _policy;
+    std::atomic<std::size_t> _dropped{0};
+
+    // Writer thread only
+    std::size_t _sink_errors = 0;
+    std::chrono::steady_clock::time_point _last_sink_error;
+
+    std::atomic<bool> _stop{false};
+    std::atomic<bool> _sleeping{false};
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::thread _writer;
+};
+
+// Created once and never destroyed, like root(): log calls racing with
+// disable_async_logging() or made by static destructors can still push to it safely
+std::mutex async_lock;
+AsyncBackend* async_storage = nullptr;
+std::atomic<AsyncBackend*> async_backend{nullptr};
+
+// Messages queued before exit() are written
+void flush_async_at_exit(){
+    AsyncBackend* backend = async_backend.load(std::memory_order_acquire);
+    if (backend){
+        backend->flush();
+    }
+}
 }
 
-void spdlog_log(LogLevel level, std::string const& msg){
-    root()->log(log_level_spd[int(level)], msg);
+void enable_async_logging(AsyncLogOptions const& options){
+    std::lock_guard<std::mutex> guard(async_lock);
+    if (!async_storage){
+        async_storage = new AsyncBackend(root(), options);
+        std::atexit(flush_async_at_exit);
+    }
+    async_storage->set_policy(options.overflow);
+    async_backend.store(async_storage, std::memory_order_release);
+}
+
+void disable_async_logging(){
+    std::lock_guard<std::mutex> guard(async_lock);
+    async_backend.store(nullptr, std::memory_order_release);
+    if (async_storage){
+        async_storage->flush();
+    }
+}
+
+void flush_log(){
+    AsyncBackend* backend = async_backend.load(std::memory_order_acquire);
+    if (backend){
+        backend->flush();
+    } else {
+        root_logger().flush();
+    }
+}
+
+std::size_t dropped_log_messages(){
+    std::lock_guard<std::mutex> guard(async_lock);
+    return async_storage ? async_storage->dropped() : 0;
+}
+
+void spdlog_log(LogLevel level, fmt::string_view msg){
+    AsyncBackend* backend = async_backend.load(std::memory_order_acquire);
+    if (backend){
+        backend->push(level, msg);
+        return;
+    }
+
+    // Not a spdlog::string_view_t, spdlog would use the message as a format string
+    std::string_view text(msg.data(), msg.size());
+    root_logger().log(spdlog::source_loc{}, log_level_spd[int(level)], text);
+}
+
+fmt::string_view format_log(CodeLocation const& loc, fmt::string_view fmt, fmt::format_args args){
+    // Reused by every message of the thread, it only grows
+    thread_local fmt::memory_buffer buffer;
+    buffer.clear();
+
+    fmt::string_view file = loc.filename;
+    fmt::string_view function = loc.function_name;
+    fmt::format_int line(loc.line);
+
+    buffer.append(file.data(), file.data() + file.size());
+    buffer.push_back(':');
+    buffer.append(line.data(), line.data() + line.size());
+    buffer.push_back(' ');
+    buffer.append(function.data(), function.data() + function.size());
+    buffer.append(" - ", " - " + 3);
+    fmt::vformat_to(buffer, fmt, args);
+
+    return fmt::string_view(buffer.data(), buffer.size());
+}
+
+void vlog(LogLevel level, CodeLocation const& loc, fmt::string_view fmt, fmt::format_args args){
+    // Filtered out messages are not formatted
+    if (!log_enabled(level)){
+        return;
+    }
+    spdlog_log(level, format_log(loc, fmt, args));
 }
 
 const char* Exception::what() const noexcept {
-    show_backtrace();
-    return message;
+    if (!_shown){
+        _shown = true;
+        try {
+            spdlog_log(LogLevel::CRITICAL, _message);
+            show_backtrace(_trace);
+        } catch (...){
+        }
+    }
+    return _message.c_str();
 }
 }
@@ -1,27 +1,32 @@
 #ifndef PROJECT_TEST_SRC_LOGGER_HEADER
 #define PROJECT_TEST_SRC_LOGGER_HEADER
 
+#include <atomic>
+#include <cstddef>
 #include <string>
 #include <vector>
 // Do not include spdlog directly
 // only use the fmt header
 #include <spdlog/fmt/bundled/core.h>
 
+#include "backtrace.h"
+#include "binary_log.h"
+#include "flight_recorder.h"
+#include "log_limit.h"
+
 namespace sym
 {
 
+// Call site of a log statement, stored once per site in static storage
+// so a log call only passes a pointer to it
 struct CodeLocation{
-    CodeLocation(std::string const& file, std::string const& fun, int line, std::string const& fun_long):
-        filename(file), function_name(fun), line(line), function_long(fun_long)
-    {}
-
-    std::string filename;
-    std::string function_name;
+    const char* filename;
+    const char* function_name;
     int line;
-    std::string function_long;
+    const char* function_long;
 };
 
-#define LOC sym::CodeLocation(__FILE__, __FUNCTION__, __LINE__, __PRETTY_FUNCTION__)
+#define LOC sym::CodeLocation{__FILE__, __FUNCTION__, __LINE__, __PRETTY_FUNCTION__}
 
 enum class LogLevel{
     TRACE,
@@ -33,49 +38,202 @@ enum class LogLevel{
     OFF
 };
 
-// Show backtrace using spdlog
+// Log the events of the flight recorder, with their original level, time and thread
 void show_log_backtrace();
 
-// Show backtrace using execinfo
+// Log the backtrace of the caller
 void show_backtrace();
 
-// retrieve backtrace using execinfo
+// Log a captured backtrace, one line per frame
+void show_backtrace(StackTrace const& trace);
+
+// Symbolized backtrace of the caller, at most `size` frames
 std::vector<std::string> get_backtrace(size_t size);
 
-void spdlog_log(LogLevel level, const std::string& msg);
+void spdlog_log(LogLevel level, fmt::string_view msg);
+
+// What a log call does when the asynchronous queue is full
+enum class OverflowPolicy{
+    Block,          // wait for the writer thread, nothing is lost
+    Drop,           // drop the new message
+    DropOldest      // drop the oldest queued message
+};
+
+struct AsyncLogOptions{
+    std::size_t capacity = 8192;        // queued messages, rounded up to a power of 2
+    std::size_t batch = 256;            // messages written between two flushes of the sinks
+    OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+/*!
+ * \brief Switch to asynchronous logging.
+ *
+ * Log calls copy the formatted message in a bounded lock-free queue and return, a
+ * background thread writes the messages to the sinks in batches and flushes once per
+ * batch. The time and thread of a message are taken by the log call.
+ * The queue is allocated by the first call, later calls only change the overflow policy.
+ */
+void enable_async_logging(AsyncLogOptions const& options = AsyncLogOptions());
+
+// Write the queued messages and go back to synchronous logging
+void disable_async_logging();
+
+// Block until the messages logged before the call are written
+void flush_log();
+
+// Messages dropped because the queue was full
+std::size_t dropped_log_messages();
+
+// Log calls below this level are removed at compile time (0 = TRACE ... 6 = OFF),
+// set with the SYM_LOG_MIN_LEVEL CMake cache variable
+#ifndef SYM_LOG_MIN_LEVEL
+#define SYM_LOG_MIN_LEVEL 0
+#endif
+
+// Runtime threshold, checked before the arguments of a log call are evaluated
+inline std::atomic<int> log_threshold{0};
+
+// False when messages of `level` are dropped
+inline bool log_enabled(LogLevel level){
+    return int(level) >= log_threshold.load(std::memory_order_relaxed);
+}
+
+// Drop the messages below `level`, calls removed by SYM_LOG_MIN_LEVEL cannot be enabled back
+void set_log_level(LogLevel level);
+LogLevel log_level();
+
+// Format "file:line function - message" in a single pass into a thread local buffer.
+// The view is valid until the next call on the same thread
+fmt::string_view format_log(CodeLocation const& loc, fmt::string_view fmt, fmt::format_args args);
+
+// Type erased log, the arguments are only formatted when `level` is enabled
+void vlog(LogLevel level, CodeLocation const& loc, fmt::string_view fmt, fmt::format_args args);
 
 template<typename ... Args>
 void log(LogLevel level, CodeLocation const& loc, const char* fmt, const Args& ... args){
-    auto msg = fmt::format("{}:{} {} - {}",
-                           loc.filename,
-                           loc.line,
-                           loc.function_name,
-                           fmt::format(fmt, args...));
+    vlog(level, loc, fmt, fmt::make_format_args(args...));
+}
 
-    spdlog_log(level, msg);
+// Log from a macro call site, recorded by the flight recorder and written to the binary
+// log when it is enabled
+template<typename ... Args>
+void log(LogLevel level, CodeLocation const& loc, LogSite& site, const char* fmt, const Args& ... args){
+    if (flight_recorder_enabled(level)){
+        record_flight_event(site, level, loc, fmt, args...);
+    }
+    if (!log_enabled(level)){
+        return;
+    }
+    if (binary_logging.load(std::memory_order_relaxed)){
+        binary_log(site, level, loc, fmt, args...);
+        return;
+    }
+    vlog(level, loc, fmt, fmt::make_format_args(args...));
 }
 
-#define SYM_LOG_HELPER(level, ...) log(level, LOC, __VA_ARGS__)
+#define SYM_LOG_HELPER(level, ...)\
+    do {\
+        if (sym::log_enabled(level) || sym::flight_recorder_enabled(level)){\
+            static constexpr sym::CodeLocation sym_log_loc = LOC;\
+            static sym::LogSite sym_log_site;\
+            sym::log(level, sym_log_loc, sym_log_site, __VA_ARGS__);\
+        }\
+    } while (0)
+
+// Log call admitted by the LogLimit of the site, the dropped calls are only counted
+#define SYM_LOG_LIMITED(level, admit, ...)\
+    do {\
+        if (sym::log_enabled(level) || sym::flight_recorder_enabled(level)){\
+            static constexpr sym::CodeLocation sym_log_loc = LOC;\
+            static sym::LogSite sym_log_site;\
+            static sym::LogLimit sym_log_limit;\
+            if (admit){\
+                sym::report_suppressed(sym_log_limit, level, sym_log_loc);\
+                sym::log(level, sym_log_loc, sym_log_site, __VA_ARGS__);\
+            } else {\
+                sym::suppress_log(sym_log_limit, level, sym_log_loc);\
+            }\
+        }\
+    } while (0)
+
+// Limited calls take the level name, they are compiled out below SYM_LOG_MIN_LEVEL
+// like the plain macros: SYM_LOG_PER_SECOND(WARN, 5, "late frame {}", frame)
+
+// At most `n` messages per second, none when `n` is 0
+#define SYM_LOG_PER_SECOND(level, n, ...)   SYM_LOG_LIMITED_##level(sym::admit_per_second(sym_log_limit, n), __VA_ARGS__)
+
+// One call in `k`
+#define SYM_LOG_EVERY_N(level, k, ...)      SYM_LOG_LIMITED_##level(sym::admit_every_n(sym_log_limit, k), __VA_ARGS__)
+
+// The first `n` calls, see report_suppressed_logs() for the count of the others
+#define SYM_LOG_FIRST_N(level, n, ...)      SYM_LOG_LIMITED_##level(sym::admit_first_n(sym_log_limit, n), __VA_ARGS__)
+
+// Compiled out log call, the arguments are type checked but never evaluated
+#define SYM_LOG_DISABLED(level, ...)\
+    do {\
+        if (false){\
+            sym::log(level, sym::CodeLocation{}, __VA_ARGS__);\
+        }\
+    } while (0)
+
+#if SYM_LOG_MIN_LEVEL <= 1
+#define debug(...)      SYM_LOG_HELPER(sym::LogLevel::DEBUG, __VA_ARGS__)
+#define SYM_LOG_LIMITED_DEBUG(admit, ...)     SYM_LOG_LIMITED(sym::LogLevel::DEBUG, admit, __VA_ARGS__)
+#else
+#define debug(...)      SYM_LOG_DISABLED(sym::LogLevel::DEBUG, __VA_ARGS__)
+#define SYM_LOG_LIMITED_DEBUG(admit, ...)     SYM_LOG_DISABLED(sym::LogLevel::DEBUG, __VA_ARGS__)
+#endif
 
+#if SYM_LOG_MIN_LEVEL <= 2
 #define info(...)       SYM_LOG_HELPER(sym::LogLevel::INFO, __VA_ARGS__)
+#define SYM_LOG_LIMITED_INFO(admit, ...)      SYM_LOG_LIMITED(sym::LogLevel::INFO, admit, __VA_ARGS__)
+#else
+#define info(...)       SYM_LOG_DISABLED(sym::LogLevel::INFO, __VA_ARGS__)
+#define SYM_LOG_LIMITED_INFO(admit, ...)      SYM_LOG_DISABLED(sym::LogLevel::INFO, __VA_ARGS__)
+#endif
+
+#if SYM_LOG_MIN_LEVEL <= 3
 #define warn(...)       SYM_LOG_HELPER(sym::LogLevel::WARN, __VA_ARGS__)
-#define debug(...)      SYM_LOG_HELPER(sym::LogLevel::DEBUG, __VA_ARGS__)
+#define SYM_LOG_LIMITED_WARN(admit, ...)      SYM_LOG_LIMITED(sym::LogLevel::WARN, admit, __VA_ARGS__)
+#else
+#define warn(...)       SYM_LOG_DISABLED(sym::LogLevel::WARN, __VA_ARGS__)
+#define SYM_LOG_LIMITED_WARN(admit, ...)      SYM_LOG_DISABLED(sym::LogLevel::WARN, __VA_ARGS__)
+#endif
+
+#if SYM_LOG_MIN_LEVEL <= 4
 #define error(...)      SYM_LOG_HELPER(sym::LogLevel::ERROR, __VA_ARGS__)
+#define SYM_LOG_LIMITED_ERROR(admit, ...)     SYM_LOG_LIMITED(sym::LogLevel::ERROR, admit, __VA_ARGS__)
+#else
+#define error(...)      SYM_LOG_DISABLED(sym::LogLevel::ERROR, __VA_ARGS__)
+#define SYM_LOG_LIMITED_ERROR(admit, ...)     SYM_LOG_DISABLED(sym::LogLevel::ERROR, __VA_ARGS__)
+#endif
+
+#if SYM_LOG_MIN_LEVEL <= 5
 #define critical(...)   SYM_LOG_HELPER(sym::LogLevel::CRITICAL, __VA_ARGS__)
+#define SYM_LOG_LIMITED_CRITICAL(admit, ...)  SYM_LOG_LIMITED(sym::LogLevel::CRITICAL, admit, __VA_ARGS__)
+#else
+#define critical(...)   SYM_LOG_DISABLED(sym::LogLevel::CRITICAL, __VA_ARGS__)
+#define SYM_LOG_LIMITED_CRITICAL(admit, ...)  SYM_LOG_DISABLED(sym::LogLevel::CRITICAL, __VA_ARGS__)
+#endif
 
 
-// Exception that shows the backtrace when .what() is called
+// Exception that shows the backtrace when .what() is first called.
+// The return addresses are captured at construction, they are only symbolized when shown
 class Exception: public std::exception{
 public:
     template<typename ... Args>
     Exception(const char* fmt, const Args& ... args):
-        message(fmt::format(fmt, args...).c_str())
+        _message(fmt::format(fmt, args...)), _trace(capture_stack_trace())
     {}
 
     const char* what() const noexcept final;
 
+    StackTrace const& trace() const { return _trace; }
+
 private:
-    const char* message;
+    std::string _message;
+    StackTrace _trace;
+    mutable bool _shown = false;
 };
 
 // Make a simple exception
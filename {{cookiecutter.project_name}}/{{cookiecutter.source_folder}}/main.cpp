@@ -237,6 +237,8 @@ private:
 
         SDL_DestroyWindow(window);
         SDL_Quit();
+
+        sym::report_suppressed_logs();
     }
 
     void recreate_swap_chain() {
@@ -994,7 +996,8 @@ private:
     }
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void*) {
-        debug("validation: {}/{}: {}", messageSeverity, messageType, pCallbackData->pMessage);
+        // Drivers can repeat the same message thousands of times per second
+        SYM_LOG_PER_SECOND(DEBUG, 20, "validation: {}/{}: {}", messageSeverity, messageType, pCallbackData->pMessage);
         return VK_FALSE;
     }
 };
@@ -0,0 +1,379 @@
+#include "ode.h"
+#include "gradient.h"
+#include "solver.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace sym{
+
+// `columns` columns of `count` lanes, the layout used by Program::eval_all
+struct Columns{
+    Columns(std::size_t columns, std::size_t count):
+        data(columns * count), ptrs(columns), count(count)
+    {
+        for (std::size_t k = 0; k < columns; ++k){
+            ptrs[k] = data.data() + k * count;
+        }
+    }
+
+    // Copies would point to the buffer of the original
+    Columns(Columns const&) = delete;
+    Columns(Columns&&) = default;
+
+    double* operator[](std::size_t k)               { return ptrs[k]; }
+    const double* operator[](std::size_t k) const   { return ptrs[k]; }
+
+    std::vector<double> data;
+    std::vector<double*> ptrs;
+    std::size_t count;
+};
+
+// State of up to Program::block_size trajectories integrated together
+struct OdeSystem::Block{
+    Block(std::size_t states, std::size_t parameters, std::size_t count):
+        in(states + parameters + 1, count), x(states, count),
+        time(in[states + parameters]), steps(count, 0), success(count, 1)
+    {}
+
+    void eval(Program const& program, Columns& out) const {
+        program.eval_all(in.ptrs.data(), out.ptrs.data(), in.count);
+    }
+
+    Columns in;         // states, parameters then time
+    Columns x;          // current state
+    double* time;
+    std::vector<std::uint32_t> steps;
+    std::vector<char> success;
+};
+
+OdeSystem::OdeSystem(std::vector<Expr> const& rhs,
+                     std::vector<std::string> const& states,
+                     std::vector<std::string> const& parameters,
+                     std::string const& time,
+                     CompileOptions const& options):
+    _states(states.size()), _parameters(parameters.size())
+{
+    if (rhs.size() != states.size() || states.empty()){
+        throw std::invalid_argument("one right hand side per state is required");
+    }
+
+    std::vector<std::string> inputs = states;
+    inputs.insert(inputs.end(), parameters.begin(), parameters.end());
+    inputs.push_back(time);
+
+    std::vector<Expr> outputs = rhs;
+    for (auto& f: rhs){
+        auto row = symbolic_gradient(f, states);
+        outputs.insert(outputs.end(), row.begin(), row.end());
+    }
+
+    _rhs = compile(rhs, inputs, options);
+    _jacobian = compile(outputs, inputs, options);
+}
+
+OdeResult OdeSystem::integrate(std::vector<double> const& initial,
+                               std::vector<double> const& params,
+                               std::size_t trajectories,
+                               OdeOptions const& options) const
+{
+    const std::size_t n = _states;
+    const std::size_t q = _parameters;
+
+    if (initial.size() != trajectories * n){
+        throw std::invalid_argument("one initial state per trajectory is required");
+    }
+    if (params.size() != trajectories * q && params.size() != q){
+        throw std::invalid_argument("one set of parameters per trajectory is required");
+    }
+    if (!(options.t1 >= options.t0) || !(options.dt > 0)){
+        throw std::invalid_argument("integration needs t0 <= t1 and dt > 0");
+    }
+    if (options.method != OdeMethod::RK45 &&
+        std::ceil((options.t1 - options.t0) / options.dt) > double(options.max_steps)){
+        throw std::invalid_argument("dt is too small for max_steps");
+    }
+
+    const bool shared_params = params.size() == q;
+
+    OdeResult result;
+    result.x.resize(trajectories * n);
+    result.steps.resize(trajectories);
+    result.success.resize(trajectories);
+
+    ThreadPool& pool = options.pool ? *options.pool : ThreadPool::global();
+
+    pool.parallel_for(trajectories, Program::block_size, [&](std::size_t first, std::size_t end){
+        const std::size_t count = end - first;
+        Block block(n, q, count);
+
+        for (std::size_t l = 0; l < count; ++l){
+            for (std::size_t j = 0; j < n; ++j){
+                block.x[j][l] = initial[(first + l) * n + j];
+            }
+            for (std::size_t j = 0; j < q; ++j){
+                block.in[n + j][l] = shared_params ? params[j] : params[(first + l) * q + j];
+            }
+        }
+
+        switch (options.method){
+        case OdeMethod::RK4:    rk4(block, options); break;
+        case OdeMethod::RK45:   rk45(block, options); break;
+        case OdeMethod::BDF:    bdf(block, options); break;
+        }
+
+        for (std::size_t l = 0; l < count; ++l){
+            bool finite = true;
+            for (std::size_t j = 0; j < n; ++j){
+                result.x[(first + l) * n + j] = block.x[j][l];
+                finite = finite && std::isfinite(block.x[j][l]);
+            }
+            result.steps[first + l] = block.steps[l];
+            result.success[first + l] = block.success[l] && finite;
+        }
+    });
+
+    return result;
+}
+
+// Runge-Kutta 4
+// --------------------------------------------
+void OdeSystem::rk4(Block& block, OdeOptions const& options) const {
+    const std::size_t n = _states;
+    const std::size_t count = block.in.count;
+    const std::size_t steps = std::size_t(std::ceil((options.t1 - options.t0) / options.dt));
+    const double h = steps > 0 ? (options.t1 - options.t0) / double(steps) : 0;
+
+    Columns k[4] = {{n, count}, {n, count}, {n, count}, {n, count}};
+
+    // k[stage] = f(x + c h k[stage - 1], t)
+    auto eval_stage = [&](std::size_t stage, double c, double t){
+        for (std::size_t j = 0; j < n; ++j){
+            for (std::size_t l = 0; l < count; ++l){
+                block.in[j][l] = block.x[j][l] + (stage > 0 ? c * h * k[stage - 1][j][l] : 0);
+            }
+        }
+        std::fill_n(block.time, count, t);
+        block.eval(_rhs, k[stage]);
+    };
+
+    for (std::size_t s = 0; s < steps; ++s){
+        double t = options.t0 + double(s) * h;
+
+        eval_stage(0, 0, t);
+        eval_stage(1, 0.5, t + 0.5 * h);
+        eval_stage(2, 0.5, t + 0.5 * h);
+        eval_stage(3, 1, t + h);
+
+        for (std::size_t j = 0; j < n; ++j){
+            for (std::size_t l = 0; l < count; ++l){
+                block.x[j][l] += h / 6 * (k[0][j][l] + 2 * k[1][j][l] + 2 * k[2][j][l] + k[3][j][l]);
+            }
+        }
+    }
+
+    std::fill(block.steps.begin(), block.steps.end(), std::uint32_t(steps));
+}
+
+// Dormand-Prince 5(4)
+// --------------------------------------------
+namespace {
+const double dp_c[7] = {0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1};
+
+const double dp_a[7][6] = {
+    {},
+    {1.0 / 5},
+    {3.0 / 40, 9.0 / 40},
+    {44.0 / 45, -56.0 / 15, 32.0 / 9},
+    {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729},
+    {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656},
+    {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84}
+};
+
+// 5th order solution minus the embedded 4th order one
+const double dp_e[7] = {
+    71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40
+};
+}
+
+void OdeSystem::rk45(Block& block, OdeOptions const& options) const {
+    const std::size_t n = _states;
+    const std::size_t count = block.in.count;
+
+    std::vector<Columns> k;
+    for (std::size_t stage = 0; stage < 7; ++stage){
+        k.emplace_back(n, count);
+    }
+    std::vector<double> t(count, options.t0);
+    std::vector<double> h(count, std::min(options.dt, options.t1 - options.t0));
+    std::vector<char> active(count, options.t1 > options.t0);
+    const double t_snap = 64 * std::numeric_limits<double>::epsilon() * std::max(1.0, std::abs(options.t1));
+
+    // First same as last: the last stage is evaluated at the new state and becomes
+    // the first stage of the next step
+    for (std::size_t j = 0; j < n; ++j){
+        std::copy_n(block.x[j], count, block.in[j]);
+    }
+    std::copy_n(t.data(), count, block.time);
+    block.eval(_rhs, k[0]);
+
+    while (std::find(active.begin(), active.end(), 1) != active.end()){
+        // Finished lanes are evaluated with a zero step, their state does not move
+        for (std::size_t stage = 1; stage < 7; ++stage){
+            for (std::size_t j = 0; j < n; ++j){
+                for (std::size_t l = 0; l < count; ++l){
+                    double sum = 0;
+                    for (std::size_t i = 0; i < stage; ++i){
+                        sum += dp_a[stage][i] * k[i][j][l];
+                    }
+                    block.in[j][l] = block.x[j][l] + h[l] * sum;
+                }
+            }
+            for (std::size_t l = 0; l < count; ++l){
+                block.time[l] = t[l] + dp_c[stage] * h[l];
+            }
+            block.eval(_rhs, k[stage]);
+        }
+
+        // The inputs of the last stage are the 5th order solution
+        for (std::size_t l = 0; l < count; ++l){
+            if (!active[l]){
+                continue;
+            }
+
+            double err = 0;
+            for (std::size_t j = 0; j < n; ++j){
+                double e = 0;
+                for (std::size_t i = 0; i < 7; ++i){
+                    e += dp_e[i] * k[i][j][l];
+                }
+                double scale = options.atol + options.rtol * std::max(std::abs(block.x[j][l]), std::abs(block.in[j][l]));
+                err += (h[l] * e / scale) * (h[l] * e / scale);
+            }
+            err = std::sqrt(err / double(n));
+
+            bool accept = err <= 1;
+            double factor = !std::isfinite(err) ? 0.2 : err == 0 ? 5 : std::clamp(0.9 * std::pow(err, -0.2), 0.2, 5.0);
+
+            if (accept){
+                t[l] += h[l];
+                block.steps[l] += 1;
+
+                // t + (t1 - t) can round below t1, a remainder of a few ulps is not a step
+                if (options.t1 - t[l] <= t_snap){
+                    t[l] = options.t1;
+                }
+                for (std::size_t j = 0; j < n; ++j){
+                    block.x[j][l] = block.in[j][l];
+                    k[0][j][l] = k[6][j][l];
+                }
+            } else {
+                factor = std::min(factor, 1.0);
+            }
+
+            h[l] = std::min(h[l] * factor, options.t1 - t[l]);
+
+            if (accept && t[l] >= options.t1){
+                h[l] = 0;
+                active[l] = 0;
+            } else if (block.steps[l] >= options.max_steps || h[l] <= 1e-15 * std::max(1.0, std::abs(t[l]))){
+                h[l] = 0;
+                active[l] = 0;
+                block.success[l] = 0;
+            }
+        }
+    }
+}
+
+// BDF 2
+// --------------------------------------------
+void OdeSystem::bdf(Block& block, OdeOptions const& options) const {
+    const std::size_t n = _states;
+    const std::size_t count = block.in.count;
+    const std::size_t steps = std::size_t(std::ceil((options.t1 - options.t0) / options.dt));
+    const double h = steps > 0 ? (options.t1 - options.t0) / double(steps) : 0;
+
+    Columns previous(n, count);
+    Columns history(n, count);      // known part of the implicit equation
+    Columns fj(n + n * n, count);   // f then J
+    std::vector<char> converged(count);
+    std::vector<double> a(n * n);
+    std::vector<double> dy(n);
+
+    for (std::size_t s = 0; s < steps; ++s){
+        // Backward Euler starts the 2 step method:
+        //  y - x - h f(y) = 0
+        //  y - 4/3 x + 1/3 x_prev - 2/3 h f(y) = 0
+        const bool first = s == 0;
+        const double beta = first ? 1 : 2.0 / 3;
+
+        for (std::size_t j = 0; j < n; ++j){
+            for (std::size_t l = 0; l < count; ++l){
+                double x = block.x[j][l];
+                double p = previous[j][l];
+                history[j][l] = first ? x : 4.0 / 3 * x - 1.0 / 3 * p;
+                block.in[j][l] = first ? x : 2 * x - p;     // extrapolated guess
+            }
+        }
+        std::fill_n(block.time, count, options.t0 + double(s + 1) * h);
+        for (std::size_t l = 0; l < count; ++l){
+            converged[l] = !block.success[l];   // failed lanes are left alone
+        }
+
+        // Newton on G(y) = y - history - beta h f(y), G'(y) = I - beta h J
+        for (std::size_t it = 0; it < options.max_newton; ++it){
+            if (std::find(converged.begin(), converged.end(), 0) == converged.end()){
+                break;
+            }
+
+            block.eval(_jacobian, fj);
+
+            for (std::size_t l = 0; l < count; ++l){
+                if (converged[l]){
+                    continue;
+                }
+
+                for (std::size_t r = 0; r < n; ++r){
+                    dy[r] = -(block.in[r][l] - history[r][l] - beta * h * fj[r][l]);
+                    for (std::size_t c = 0; c < n; ++c){
+                        a[r * n + c] = (r == c) - beta * h * fj[n + r * n + c][l];
+                    }
+                }
+
+                if (!solve_linear(a.data(), dy.data(), n)){
+                    block.success[l] = 0;
+                    converged[l] = 1;
+                    continue;
+                }
+
+                double norm = 0;
+                for (std::size_t j = 0; j < n; ++j){
+                    block.in[j][l] += dy[j];
+                    double scale = options.atol + options.rtol * std::abs(block.in[j][l]);
+                    norm += (dy[j] / scale) * (dy[j] / scale);
+                }
+                converged[l] = std::sqrt(norm / double(n)) <= 1;
+            }
+        }
+
+        for (std::size_t l = 0; l < count; ++l){
+            if (!block.success[l]){
+                continue;
+            }
+            if (!converged[l]){
+                block.success[l] = 0;
+                continue;
+            }
+
+            block.steps[l] += 1;
+            for (std::size_t j = 0; j < n; ++j){
+                previous[j][l] = block.x[j][l];
+                block.x[j][l] = block.in[j][l];
+            }
+        }
+    }
+}
+}
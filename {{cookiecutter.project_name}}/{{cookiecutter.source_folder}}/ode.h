@@ -0,0 +1,90 @@
+#ifndef PROJECT_TEST_SRC_ODE_HEADER
+#define PROJECT_TEST_SRC_ODE_HEADER
+
+#include "symbolic.h"
+#include "compile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+class ThreadPool;
+
+enum class OdeMethod{
+    RK4,    // classic Runge-Kutta, fixed step
+    RK45,   // Dormand-Prince 5(4), adaptive step
+    BDF     // backward differentiation of order 2, fixed step, Newton on the symbolic Jacobian
+};
+
+struct OdeOptions{
+    OdeMethod method = OdeMethod::RK45;
+    double t0 = 0;
+    double t1 = 1;
+    double dt = 1e-2;                   // step of fixed step methods, first step of RK45
+    double rtol = 1e-6;                 // RK45 error control and BDF Newton convergence
+    double atol = 1e-9;
+    std::size_t max_steps = 1000000;    // per trajectory
+    std::size_t max_newton = 10;        // Newton iterations per BDF step
+    ThreadPool* pool = nullptr;         // ThreadPool::global() when null
+};
+
+// Results of each trajectory, stored trajectory after trajectory
+struct OdeResult{
+    std::vector<double> x;                  // trajectories x states, state at t1
+    std::vector<std::uint32_t> steps;       // accepted steps
+    std::vector<char> success;
+};
+
+/*!
+ * \brief System dx/dt = f(x, t; p) integrated over ensembles of trajectories.
+ *
+ * The right hand side, and its Jacobian for the implicit method, are compiled once.
+ * Trajectories are integrated by blocks of Program::block_size so every stage is a single
+ * program evaluation over SIMD lanes, blocks are spread on a thread pool.
+ * Each lane of RK45 keeps its own step size.
+ *
+ * \code
+ *  // dx/dt = -k x for many k
+ *  sym::OdeSystem system({sym::mult(sym::mult(sym::make_val(-1), k), x)}, {"x"}, {"k"});
+ *  auto result = system.integrate(initial, params, n);
+ * \endcode
+ */
+class OdeSystem
+{
+public:
+    // `rhs[i]` is dx_i/dt, `time` names the placeholder holding t
+    OdeSystem(std::vector<Expr> const& rhs,
+              std::vector<std::string> const& states,
+              std::vector<std::string> const& parameters = {},
+              std::string const& time = "t",
+              CompileOptions const& options = CompileOptions());
+
+    // `initial` holds trajectories x states values, `params` holds trajectories x parameters
+    // values or a single set of parameters shared by every trajectory
+    OdeResult integrate(std::vector<double> const& initial,
+                        std::vector<double> const& params,
+                        std::size_t trajectories,
+                        OdeOptions const& options = OdeOptions()) const;
+
+    std::size_t state_count() const { return _states; }
+
+private:
+    struct Block;
+
+    void rk4(Block& block, OdeOptions const& options) const;
+    void rk45(Block& block, OdeOptions const& options) const;
+    void bdf(Block& block, OdeOptions const& options) const;
+
+    std::size_t _states;
+    std::size_t _parameters;
+    Program _rhs;           // outputs: f
+    Program _jacobian;      // outputs: f then J (states x states)
+};
+
+}
+
+#endif
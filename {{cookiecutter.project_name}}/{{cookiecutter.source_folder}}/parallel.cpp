@@ -0,0 +1,284 @@
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace sym{
+
+namespace {
+// Identity of a node built by the parallel passes: children by address, scalars by bits
+struct NodeKey{
+    NodeKind kind;
+    const ABSExpr* a;
+    const ABSExpr* b;
+    std::uint64_t bits;
+
+    bool operator==(NodeKey const&) const = default;
+};
+
+struct NodeKeyHash{
+    std::size_t operator()(NodeKey const& k) const {
+        std::size_t h = std::hash<const void*>()(k.a);
+        h ^= std::hash<const void*>()(k.b) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        h ^= std::hash<std::uint64_t>()(k.bits) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        return h ^ std::size_t(k.kind);
+    }
+};
+
+/*!
+ * \brief Concurrent hash consing of new nodes.
+ *
+ * Split in shards with their own lock so threads building different nodes rarely wait
+ * on each other. Nodes are kept alive until the table is destroyed.
+ */
+class NodeTable
+{
+public:
+    Expr scalar(double v){
+        std::uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(v));
+        return intern({NodeKind::Scalar, nullptr, nullptr, bits}, [v](){ return Scalar::make(v); });
+    }
+
+    Expr add(Expr const& a, Expr const& b){
+        return intern({NodeKind::Add, a.get(), b.get(), 0}, [&](){ return Add::make(a, b); });
+    }
+
+    Expr mult(Expr const& a, Expr const& b){
+        return intern({NodeKind::Mult, a.get(), b.get(), 0}, [&](){ return Mult::make(a, b); });
+    }
+
+private:
+    static constexpr std::size_t shard_count = 64;
+
+    struct alignas(64) Shard{
+        std::mutex lock;
+        std::unordered_map<NodeKey, Expr, NodeKeyHash> nodes;
+    };
+
+    template<typename Make>
+    Expr intern(NodeKey const& key, Make make){
+        std::size_t h = NodeKeyHash()(key);
+        Shard& shard = _shards[(h >> 16) % shard_count];
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.nodes.find(key);
+        if (it != shard.nodes.end()){
+            return it->second;
+        }
+        Expr node = make();
+        shard.nodes.emplace(key, node);
+        return node;
+    }
+
+    std::array<Shard, shard_count> _shards;
+};
+
+/*!
+ * \brief Nodes of a DAG grouped by level, children are always in a lower level.
+ *
+ * Built sequentially in O(n), the transforms then run level by level.
+ */
+struct Levels{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<ABSExpr*> nodes;                // topological order
+    std::vector<std::array<std::uint32_t, 2>> children;
+    std::vector<std::uint32_t> by_level;        // node indices sorted by level
+    std::vector<std::size_t> offsets;           // level l is by_level[offsets[l], offsets[l + 1])
+
+    explicit Levels(Expr const& root){
+        // Depth first walk like topological_order, the map doubles as the visited set
+        std::unordered_map<ABSExpr*, std::uint32_t> index;
+        std::vector<std::pair<ABSExpr*, bool>> stack{{root.get(), false}};
+        std::vector<std::uint32_t> level;
+        std::uint32_t depth = 0;
+
+        while (!stack.empty()){
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+
+            if (!expanded){
+                if (index.emplace(node, none).second){
+                    stack.emplace_back(node, true);
+                    for (std::size_t c = node->arity(); c > 0; --c){
+                        stack.emplace_back(node->child(c - 1).get(), false);
+                    }
+                }
+                continue;
+            }
+
+            std::uint32_t i = std::uint32_t(nodes.size());
+            nodes.push_back(node);
+            children.push_back({none, none});
+            level.push_back(0);
+
+            switch (node->kind()){
+            case NodeKind::Placeholder:
+            case NodeKind::Scalar:
+                break;
+            case NodeKind::Add:
+            case NodeKind::Mult:
+                for (std::size_t c = 0; c < 2; ++c){
+                    std::uint32_t child = index.at(node->child(c).get());
+                    children[i][c] = child;
+                    level[i] = std::max(level[i], level[child] + 1);
+                }
+                break;
+            default:
+                throw std::invalid_argument(std::string("parallel transform of node ") + to_string(node->kind()));
+            }
+
+            index[node] = i;
+            depth = std::max(depth, level[i]);
+        }
+
+        // Counting sort on the level
+        offsets.assign(depth + 2, 0);
+        for (std::uint32_t l: level){
+            offsets[l + 1] += 1;
+        }
+        for (std::size_t l = 1; l < offsets.size(); ++l){
+            offsets[l] += offsets[l - 1];
+        }
+
+        by_level.resize(nodes.size());
+        std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (std::uint32_t i = 0; i < nodes.size(); ++i){
+            by_level[fill[level[i]]++] = i;
+        }
+    }
+
+    std::size_t depth() const { return offsets.size() - 1; }
+};
+}
+
+// Below this many nodes a level is processed by the calling thread
+static constexpr std::size_t grain = 1024;
+
+// results[i] = fn(i) level by level, fn reads the results of the children of node i
+template<typename Fn>
+static Expr transform(Levels const& levels, ThreadPool* pool, Fn fn){
+    ThreadPool& workers = pool ? *pool : ThreadPool::global();
+    std::vector<Expr> results(levels.nodes.size());
+
+    auto run = [&](std::size_t begin, std::size_t end){
+        for (std::size_t k = begin; k < end; ++k){
+            std::uint32_t i = levels.by_level[k];
+            results[i] = fn(i, results);
+        }
+    };
+
+    for (std::size_t l = 0; l < levels.depth(); ++l){
+        std::size_t begin = levels.offsets[l];
+        std::size_t end = levels.offsets[l + 1];
+
+        // Workers copy shared nodes (children, 0 and 1), that needs atomic reference counts
+        if (end - begin <= grain || !SYM_ATOMIC_REFCOUNT){
+            run(begin, end);
+            continue;
+        }
+
+        workers.parallel_for(end - begin, grain, [&](std::size_t b, std::size_t e){
+            run(begin + b, begin + e);
+        });
+    }
+
+    return results.back();     // the root is last
+}
+
+static bool is_value(Expr const& e, double v){
+    return e->kind() == NodeKind::Scalar && static_cast<Scalar*>(e.get())->value() == v;
+}
+
+Expr parallel_derivate(Expr const& f, const std::string& name, ThreadPool* pool){
+    SYM_PROFILE_NODE_SCOPE(f.get(), Derivate);
+
+    Levels levels(f);
+    NodeTable table;
+    Expr zero = table.scalar(0);
+    Expr one = table.scalar(1);
+
+    auto plus = [&](Expr const& a, Expr const& b){
+        if (is_value(a, 0)) return b;
+        if (is_value(b, 0)) return a;
+        return table.add(a, b);
+    };
+
+    auto times = [&](Expr const& a, Expr const& b){
+        if (is_value(a, 0) || is_value(b, 1)) return a;
+        if (is_value(b, 0) || is_value(a, 1)) return b;
+        return table.mult(a, b);
+    };
+
+    return transform(levels, pool, [&](std::uint32_t i, std::vector<Expr> const& d) -> Expr {
+        ABSExpr* node = levels.nodes[i];
+        auto [l, r] = levels.children[i];
+
+        switch (node->kind()){
+        case NodeKind::Placeholder:
+            return static_cast<Placeholder*>(node)->name() == name ? one : zero;
+        case NodeKind::Add:
+            return plus(d[l], d[r]);
+        case NodeKind::Mult:
+            return plus(times(d[l], node->child(1)), times(node->child(0), d[r]));
+        default:
+            return zero;
+        }
+    });
+}
+
+static Expr bound_value(Placeholder* p, const Context& c){
+    auto it = c.find(p->name());
+    return it != c.end() ? it->second : Expr(p);
+}
+
+static Expr bound_value(Placeholder* p, const PersistentContext& c){
+    Expr value = c.find(p->id());
+    return value ? value : Expr(p);
+}
+
+template<typename Ctx>
+static Expr partial_eval_impl(Expr const& f, Ctx const& c, ThreadPool* pool){
+    SYM_PROFILE_NODE_SCOPE(f.get(), PartialEval);
+
+    Levels levels(f);
+    NodeTable table;
+
+    return transform(levels, pool, [&](std::uint32_t i, std::vector<Expr> const& values) -> Expr {
+        ABSExpr* node = levels.nodes[i];
+        auto [l, r] = levels.children[i];
+
+        switch (node->kind()){
+        case NodeKind::Placeholder:
+            return bound_value(static_cast<Placeholder*>(node), c);
+        case NodeKind::Add:
+        case NodeKind::Mult:
+            // Untouched sub expressions are shared with `f`
+            if (values[l] == node->child(0) && values[r] == node->child(1)){
+                return Expr(node);
+            }
+            return node->kind() == NodeKind::Add ? table.add(values[l], values[r]) : table.mult(values[l], values[r]);
+        default:
+            return Expr(node);
+        }
+    });
+}
+
+Expr parallel_partial_eval(Expr const& f, const Context& c, ThreadPool* pool){
+    return partial_eval_impl(f, c, pool);
+}
+
+Expr parallel_partial_eval(Expr const& f, const PersistentContext& c, ThreadPool* pool){
+    return partial_eval_impl(f, c, pool);
+}
+}
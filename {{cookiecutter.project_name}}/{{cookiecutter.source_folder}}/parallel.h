@@ -0,0 +1,38 @@
+#ifndef PROJECT_TEST_SRC_PARALLEL_HEADER
+#define PROJECT_TEST_SRC_PARALLEL_HEADER
+
+#include "symbolic.h"
+#include "context.h"
+#include "thread_pool.h"
+
+#include <string>
+
+namespace sym
+{
+
+/*!
+ * \brief Multi threaded versions of derivate() and partial_eval() for very large scalar graphs.
+ *
+ * The DAG is split in levels, a node only depends on nodes of lower levels, and the nodes
+ * of a level are processed in parallel on the pool. Unlike the recursive walks every node
+ * is visited once, so sharing in `f` is preserved in the result. New nodes go through a
+ * sharded interning table: two equal nodes built by different threads are the same node.
+ *
+ * Only Placeholder, Scalar, Add and Mult nodes are supported, std::invalid_argument is
+ * thrown otherwise. `pool` defaults to ThreadPool::global().
+ *
+ * The workers copy nodes shared by the whole graph, SYM_ATOMIC_REFCOUNT is required
+ * to run the levels in parallel. When it is disabled every level runs on the calling thread.
+ */
+
+// Derivative of `f` with respect to `name`, terms multiplied by 0 or 1 are folded
+Expr parallel_derivate(Expr const& f, const std::string& name, ThreadPool* pool = nullptr);
+
+// Same result as f->partial_eval(c), sub expressions without bound placeholders are
+// reused instead of copied
+Expr parallel_partial_eval(Expr const& f, const Context& c, ThreadPool* pool = nullptr);
+Expr parallel_partial_eval(Expr const& f, const PersistentContext& c, ThreadPool* pool = nullptr);
+
+}
+
+#endif
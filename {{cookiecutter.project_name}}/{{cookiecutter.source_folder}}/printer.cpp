@@ -0,0 +1,192 @@
+#include "printer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace sym{
+
+namespace {
+enum Precedence{
+    Lowest = 0,
+    Additive = 1,
+    Multiplicative = 2,
+    Atom = 3
+};
+
+// Either a node to print or a piece of text
+struct Task{
+    ABSExpr* node;
+    const char* text;
+    int precedence;     // of the parent operator
+    bool right;         // right operand of the parent
+};
+}
+
+static bool scalar_style(PrintStyle style){
+    return style == PrintStyle::C || style == PrintStyle::GLSL;
+}
+
+static bool scalar_kind(NodeKind kind){
+    switch (kind){
+    case NodeKind::Placeholder:
+    case NodeKind::Scalar:
+    case NodeKind::Add:
+    case NodeKind::Mult:        return true;
+    default:                    return false;
+    }
+}
+
+static int precedence(NodeKind kind){
+    switch (kind){
+    case NodeKind::Add:
+    case NodeKind::TensorAdd:   return Additive;
+    case NodeKind::Mult:
+    case NodeKind::TensorMult:  return Multiplicative;
+    default:                    return Atom;
+    }
+}
+
+static const char* function_name(NodeKind kind){
+    switch (kind){
+    case NodeKind::MatMul:      return "matmul";
+    case NodeKind::Transpose:   return "transpose";
+    case NodeKind::Sum:         return "sum";
+    default:                    return to_string(kind);
+    }
+}
+
+void print_number(std::string& out, double v, PrintStyle style){
+    if (std::isnan(v)){
+        out += style == PrintStyle::GLSL ? "(0.0 / 0.0)" : style == PrintStyle::C ? "NAN" : "nan";
+        return;
+    }
+    if (std::isinf(v)){
+        if (style == PrintStyle::GLSL){
+            out += v > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+        } else if (style == PrintStyle::C){
+            out += v > 0 ? "INFINITY" : "-INFINITY";
+        } else {
+            out += v > 0 ? "inf" : "-inf";
+        }
+        return;
+    }
+
+    char buffer[32];
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr;
+    out.append(buffer, end);
+
+    // 2 is an int in C and GLSL
+    if (scalar_style(style) && std::none_of(buffer, end, [](char c){ return c == '.' || c == 'e'; })){
+        out += ".0";
+    }
+}
+
+static void print_tensor(std::string& out, Tensor const& value, PrintStyle style){
+    out += '[';
+    for (std::size_t i = 0; i < value.rows(); ++i){
+        out += i > 0 ? ", [" : "[";
+        for (std::size_t j = 0; j < value.cols(); ++j){
+            if (j > 0) out += ", ";
+            print_number(out, value(i, j), style);
+        }
+        out += ']';
+    }
+    out += ']';
+}
+
+void print(std::string& out, Expr const& f, PrintStyle style){
+    // Reused between calls, printing does not allocate once it has grown
+    thread_local std::vector<Task> stack;
+    stack.clear();
+    stack.push_back({f.get(), nullptr, Lowest, false});
+
+    const bool prefix = style == PrintStyle::Prefix;
+
+    while (!stack.empty()){
+        Task task = stack.back();
+        stack.pop_back();
+
+        if (!task.node){
+            out += task.text;
+            continue;
+        }
+
+        ABSExpr* node = task.node;
+        NodeKind kind = node->kind();
+
+        if (scalar_style(style) && !scalar_kind(kind)){
+            stack.clear();
+            throw std::invalid_argument(std::string("cannot print ") + to_string(kind) + " as scalar code");
+        }
+
+        // Children are pushed in reverse, the last pushed is printed first
+        switch (kind){
+        case NodeKind::Placeholder:
+            out += static_cast<Placeholder*>(node)->name();
+            break;
+        case NodeKind::TensorPlaceholder:
+            out += static_cast<TensorPlaceholder*>(node)->name();
+            break;
+        case NodeKind::Scalar:
+            print_number(out, static_cast<Scalar*>(node)->value(), style);
+            break;
+        case NodeKind::TensorConstant:
+            print_tensor(out, static_cast<TensorConstant*>(node)->value(), style);
+            break;
+        case NodeKind::Add:
+        case NodeKind::Mult:
+        case NodeKind::TensorAdd:
+        case NodeKind::TensorMult: {
+            bool add = kind == NodeKind::Add || kind == NodeKind::TensorAdd;
+
+            if (prefix){
+                stack.push_back({nullptr, ")", 0, false});
+                stack.push_back({node->child(1).get(), nullptr, Lowest, false});
+                stack.push_back({nullptr, " ", 0, false});
+                stack.push_back({node->child(0).get(), nullptr, Lowest, false});
+                stack.push_back({nullptr, add ? "(+ " : "(* ", 0, false});
+                break;
+            }
+
+            // Operators are left associative: a right operand of the same
+            // precedence keeps its parentheses so the evaluation order is preserved
+            int p = precedence(kind);
+            bool parens = p < task.precedence || (p == task.precedence && task.right);
+
+            if (parens) stack.push_back({nullptr, ")", 0, false});
+            stack.push_back({node->child(1).get(), nullptr, p, true});
+            stack.push_back({nullptr, add ? " + " : " * ", 0, false});
+            stack.push_back({node->child(0).get(), nullptr, p, false});
+            if (parens) stack.push_back({nullptr, "(", 0, false});
+            break;
+        }
+        default: {
+            // function(a, b) or (function a b)
+            stack.push_back({nullptr, ")", 0, false});
+            for (std::size_t i = node->arity(); i > 0; --i){
+                stack.push_back({node->child(i - 1).get(), nullptr, Lowest, false});
+                if (i > 1) stack.push_back({nullptr, prefix ? " " : ", ", 0, false});
+            }
+
+            if (prefix){
+                stack.push_back({nullptr, node->arity() > 0 ? " " : "", 0, false});
+                stack.push_back({nullptr, function_name(kind), 0, false});
+                stack.push_back({nullptr, "(", 0, false});
+            } else {
+                stack.push_back({nullptr, "(", 0, false});
+                stack.push_back({nullptr, function_name(kind), 0, false});
+            }
+        }
+        }
+    }
+}
+
+std::string to_string(Expr const& f, PrintStyle style){
+    std::string out;
+    print(out, f, style);
+    return out;
+}
+}
@@ -0,0 +1,48 @@
+#ifndef PROJECT_TEST_SRC_PRINTER_HEADER
+#define PROJECT_TEST_SRC_PRINTER_HEADER
+
+#include "symbolic.h"
+
+#include <string>
+
+namespace sym
+{
+
+enum class PrintStyle{
+    Infix,      // x * (y + 2)
+    Prefix,     // (* x (+ y 2))
+    C,          // x * (y + 2.0), double literals
+    GLSL        // x * (y + 2.0), float literals, inf and nan as divisions
+};
+
+/*!
+ * \brief Append `f` to `out`.
+ *
+ * Numbers are printed with std::to_chars in their shortest form that reads back to the
+ * same double. Parentheses are only emitted where needed, the grouping of additions and
+ * multiplications is kept exactly so printed code evaluates in the same order.
+ * The traversal is iterative, deep expressions do not overflow the stack, and nothing is
+ * allocated once `out` has enough capacity: keep the buffer between calls.
+ *
+ * C and GLSL only support scalar expressions, std::invalid_argument is thrown on tensor
+ * nodes.
+ *
+ * \code
+ *  std::string buffer;
+ *  for (auto& f: model){
+ *      buffer.clear();
+ *      sym::print(buffer, f, sym::PrintStyle::C);
+ *      out.write(buffer.data(), buffer.size());
+ *  }
+ * \endcode
+ */
+void print(std::string& out, Expr const& f, PrintStyle style = PrintStyle::Infix);
+
+// Append a number the way `style` prints it
+void print_number(std::string& out, double v, PrintStyle style = PrintStyle::Infix);
+
+std::string to_string(Expr const& f, PrintStyle style = PrintStyle::Infix);
+
+}
+
+#endif
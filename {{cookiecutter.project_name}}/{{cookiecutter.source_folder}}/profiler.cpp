@@ -0,0 +1,296 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace sym{
+
+thread_local Profiler* Profiler::_current = nullptr;
+
+const char* to_string(ProfiledOp op){
+    switch (op){
+    case ProfiledOp::FullEval:      return "full_eval";
+    case ProfiledOp::PartialEval:   return "partial_eval";
+    case ProfiledOp::Derivate:      return "derivate";
+    }
+    return "unknown";
+}
+
+#if SYM_PROFILE
+// Every node allocation goes through here, the profiler sees the real size of the node
+void* ABSExpr::operator new(std::size_t size){
+    if (Profiler* p = Profiler::current()){
+        p->allocation(size);
+    }
+    return ::operator new(size);
+}
+
+void ABSExpr::operator delete(void* ptr){
+    ::operator delete(ptr);
+}
+#endif
+
+// Graph Stats
+// --------------------------------------------
+GraphStats graph_stats(Expr const& root){
+    GraphStats stats;
+    if (!root){
+        return stats;
+    }
+
+    // tree size of each unique node, children come first in the topological order
+    std::unordered_map<ABSExpr*, double> tree_size;
+
+    for (ABSExpr* node: topological_order(root)){
+        double size = 1;
+        for (std::size_t i = 0; i < node->arity(); ++i){
+            size += tree_size[node->child(i).get()];
+        }
+        tree_size[node] = size;
+        stats.by_kind[node->kind()] += 1;
+    }
+
+    stats.unique_nodes = tree_size.size();
+    stats.tree_nodes = tree_size[root.get()];
+    stats.sharing_ratio = stats.tree_nodes / double(stats.unique_nodes);
+    return stats;
+}
+
+// Profiler
+// --------------------------------------------
+Profiler::Profiler(bool track_subtrees, std::size_t top):
+    _track_subtrees(track_subtrees), _top(top), _start(Clock::now()), _previous(_current)
+{
+    for (std::size_t op = 0; op < op_count; ++op){
+        for (std::size_t kind = 0; kind < kind_count; ++kind){
+            _counters[op][kind].op = ProfiledOp(op);
+            _counters[op][kind].kind = NodeKind(kind);
+        }
+    }
+    _current = this;
+}
+
+Profiler::~Profiler(){
+    _current = _previous;
+}
+
+void Profiler::enter(ABSExpr* node, ProfiledOp op){
+    _stack.push_back({node, op, Clock::now(), 0});
+}
+
+void Profiler::leave(){
+    Frame frame = _stack.back();
+    _stack.pop_back();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - frame.start).count();
+    double self = elapsed - frame.child_seconds;
+
+    if (!_stack.empty()){
+        _stack.back().child_seconds += elapsed;
+    }
+
+    auto& counter = _counters[std::size_t(frame.op)][std::size_t(frame.node->kind()) % kind_count];
+    counter.calls += 1;
+    counter.self_seconds += self;
+
+    if (_track_subtrees){
+        NodeStats& stats = _nodes[frame.node];
+        if (!stats.node){
+            stats.node = Expr(frame.node);
+        }
+        stats.calls += 1;
+        stats.inclusive_seconds += elapsed;
+        stats.self_seconds += self;
+    }
+}
+
+void Profiler::allocation(std::size_t bytes){
+    _allocations += 1;
+    _allocated_bytes += bytes;
+
+    if (!_stack.empty()){
+        Frame& frame = _stack.back();
+        auto& counter = _counters[std::size_t(frame.op)][std::size_t(frame.node->kind()) % kind_count];
+        counter.allocations += 1;
+        counter.allocated_bytes += bytes;
+    }
+}
+
+// Print a few levels of the expression, deep trees are elided
+static void preview(std::ostream& out, ABSExpr* node, int depth){
+    if (node->arity() == 0){
+        node->gen(out);
+        return;
+    }
+
+    if (depth == 0){
+        out << "...";
+        return;
+    }
+
+    if (node->kind() == NodeKind::Add || node->kind() == NodeKind::Mult){
+        out << "(";
+        preview(out, node->child(0).get(), depth - 1);
+        out << (node->kind() == NodeKind::Add ? " + " : " * ");
+        preview(out, node->child(1).get(), depth - 1);
+        out << ")";
+        return;
+    }
+
+    out << to_string(node->kind()) << "(";
+    for (std::size_t i = 0; i < node->arity(); ++i){
+        if (i > 0) out << ", ";
+        preview(out, node->child(i).get(), depth - 1);
+    }
+    out << ")";
+}
+
+ProfileReport Profiler::report(Expr const& root) const {
+    ProfileReport report;
+    report.total_seconds = std::chrono::duration<double>(Clock::now() - _start).count();
+    report.allocations = _allocations;
+    report.allocated_bytes = _allocated_bytes;
+
+    for (std::size_t op = 0; op < op_count; ++op){
+        for (std::size_t kind = 0; kind < kind_count; ++kind){
+            auto& counter = _counters[op][kind];
+            if (counter.calls > 0 || counter.allocations > 0){
+                report.counters.push_back(counter);
+            }
+        }
+    }
+
+    std::vector<NodeStats const*> nodes;
+    nodes.reserve(_nodes.size());
+    for (auto& item: _nodes){
+        nodes.push_back(&item.second);
+    }
+
+    std::size_t top = std::min(_top, nodes.size());
+    std::partial_sort(nodes.begin(), nodes.begin() + std::ptrdiff_t(top), nodes.end(),
+        [](NodeStats const* a, NodeStats const* b){ return a->inclusive_seconds > b->inclusive_seconds; });
+
+    for (std::size_t i = 0; i < top; ++i){
+        std::stringstream ss;
+        preview(ss, nodes[i]->node.get(), 3);
+
+        report.hottest.push_back({
+            ss.str(),
+            nodes[i]->node->kind(),
+            nodes[i]->calls,
+            nodes[i]->inclusive_seconds,
+            nodes[i]->self_seconds
+        });
+    }
+
+    if (root){
+        report.graph = graph_stats(root);
+    }
+    return report;
+}
+
+// Output
+// --------------------------------------------
+void ProfileReport::print(std::ostream& out) const {
+    out << "Total: " << total_seconds << " s, "
+        << allocations << " node allocations (" << allocated_bytes << " bytes)\n";
+
+    if (graph.unique_nodes > 0){
+        out << "Graph: " << graph.unique_nodes << " unique nodes, "
+            << graph.tree_nodes << " tree nodes, sharing ratio " << graph.sharing_ratio << "\n";
+        for (auto& item: graph.by_kind){
+            out << "  " << std::setw(12) << to_string(item.first) << ": " << item.second << "\n";
+        }
+    }
+
+    out << std::setw(14) << "op" << std::setw(12) << "kind" << std::setw(12) << "calls"
+        << std::setw(14) << "self (s)" << std::setw(12) << "allocs" << std::setw(14) << "bytes" << "\n";
+
+    for (auto& c: counters){
+        out << std::setw(14) << to_string(c.op) << std::setw(12) << to_string(c.kind)
+            << std::setw(12) << c.calls << std::setw(14) << c.self_seconds
+            << std::setw(12) << c.allocations << std::setw(14) << c.allocated_bytes << "\n";
+    }
+
+    if (!hottest.empty()){
+        out << "Hottest sub expressions (inclusive time):\n";
+        for (auto& s: hottest){
+            out << "  " << s.inclusive_seconds << " s (" << s.calls << " calls) " << s.preview << "\n";
+        }
+    }
+}
+
+static void json_string(std::ostream& out, std::string const& str){
+    out << '"';
+    for (char c: str){
+        switch (c){
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        default:
+            // Other control characters are not allowed in a JSON string
+            if (static_cast<unsigned char>(c) < 0x20){
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+// JSON has no inf nor nan
+static std::ostream& json_number(std::ostream& out, double value){
+    if (!std::isfinite(value)){
+        return out << "null";
+    }
+    return out << value;
+}
+
+void ProfileReport::to_json(std::ostream& out) const {
+    out << "{\"total_seconds\": ";
+    json_number(out, total_seconds)
+        << ", \"allocations\": " << allocations
+        << ", \"allocated_bytes\": " << allocated_bytes;
+
+    out << ", \"graph\": {\"unique_nodes\": " << graph.unique_nodes
+        << ", \"tree_nodes\": ";
+    json_number(out, graph.tree_nodes) << ", \"sharing_ratio\": ";
+    json_number(out, graph.sharing_ratio) << ", \"by_kind\": {";
+
+    const char* sep = "";
+    for (auto& item: graph.by_kind){
+        out << sep << "\"" << to_string(item.first) << "\": " << item.second;
+        sep = ", ";
+    }
+    out << "}}, \"counters\": [";
+
+    sep = "";
+    for (auto& c: counters){
+        out << sep << "{\"op\": \"" << to_string(c.op) << "\", \"kind\": \"" << to_string(c.kind)
+            << "\", \"calls\": " << c.calls << ", \"self_seconds\": ";
+        json_number(out, c.self_seconds)
+            << ", \"allocations\": " << c.allocations << ", \"allocated_bytes\": " << c.allocated_bytes << "}";
+        sep = ", ";
+    }
+    out << "], \"hottest\": [";
+
+    sep = "";
+    for (auto& s: hottest){
+        out << sep << "{\"expr\": ";
+        json_string(out, s.preview);
+        out << ", \"kind\": \"" << to_string(s.kind) << "\", \"calls\": " << s.calls
+            << ", \"inclusive_seconds\": ";
+        json_number(out, s.inclusive_seconds) << ", \"self_seconds\": ";
+        json_number(out, s.self_seconds) << "}";
+        sep = ", ";
+    }
+    out << "]}";
+}
+}
@@ -0,0 +1,169 @@
+#ifndef PROJECT_TEST_SRC_PROFILER_HEADER
+#define PROJECT_TEST_SRC_PROFILER_HEADER
+
+#include "symbolic.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compile time switch, when 0 the evaluation hooks expand to nothing
+#ifndef SYM_PROFILE
+#define SYM_PROFILE 0
+#endif
+
+namespace sym
+{
+
+enum class ProfiledOp{
+    FullEval,
+    PartialEval,
+    Derivate
+};
+
+const char* to_string(ProfiledOp op);
+
+// Static shape of an expression graph
+struct GraphStats{
+    std::size_t unique_nodes = 0;           // nodes in the DAG
+    double tree_nodes = 0;                  // nodes if every shared node was duplicated
+    double sharing_ratio = 1;               // tree_nodes / unique_nodes
+    std::unordered_map<NodeKind, std::size_t> by_kind;
+};
+
+GraphStats graph_stats(Expr const& root);
+
+
+struct ProfileReport{
+    struct Counter{
+        ProfiledOp op;
+        NodeKind kind;
+        std::uint64_t calls = 0;
+        double self_seconds = 0;
+        std::uint64_t allocations = 0;      // node allocations made while this op was running
+        std::uint64_t allocated_bytes = 0;
+    };
+
+    struct Subtree{
+        std::string preview;                // expression truncated to a few levels
+        NodeKind kind;
+        std::uint64_t calls = 0;
+        double inclusive_seconds = 0;
+        double self_seconds = 0;
+    };
+
+    double total_seconds = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+    std::vector<Counter> counters;
+    std::vector<Subtree> hottest;           // sorted by inclusive time
+    GraphStats graph;                       // only filled when a root is given
+
+    void print(std::ostream& out) const;
+    void to_json(std::ostream& out) const;
+};
+
+
+/*!
+ * \brief Record node counts, evaluation times and node allocations of the current thread.
+ *
+ * Requires the library to be compiled with SYM_PROFILE=1, otherwise the report stays empty.
+ * A profiler is active from its construction to its destruction, they can be nested.
+ *
+ * \code
+ *  sym::Profiler profiler;
+ *  f->full_eval(ctx);
+ *  profiler.report(f).print(std::cout);
+ * \endcode
+ */
+class Profiler
+{
+public:
+    // `track_subtrees` keeps per node timings to find the most expensive sub expressions
+    Profiler(bool track_subtrees = true, std::size_t top = 16);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    ProfileReport report(Expr const& root = nullptr) const;
+
+    static Profiler* current() { return _current; }
+
+    // Hooks
+    void enter(ABSExpr* node, ProfiledOp op);
+    void leave();
+    void allocation(std::size_t bytes);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame{
+        ABSExpr* node;
+        ProfiledOp op;
+        Clock::time_point start;
+        double child_seconds;
+    };
+
+    struct NodeStats{
+        Expr node;              // keep the node alive so the preview is valid at report time
+        std::uint64_t calls = 0;
+        double inclusive_seconds = 0;
+        double self_seconds = 0;
+    };
+
+    static constexpr std::size_t op_count = 3;
+    static constexpr std::size_t kind_count = 16;
+
+    bool _track_subtrees;
+    std::size_t _top;
+    Clock::time_point _start;
+    Profiler* _previous;
+
+    std::vector<Frame> _stack;
+    ProfileReport::Counter _counters[op_count][kind_count];
+    std::uint64_t _allocations = 0;
+    std::uint64_t _allocated_bytes = 0;
+    std::unordered_map<ABSExpr*, NodeStats> _nodes;
+
+    static thread_local Profiler* _current;
+};
+
+
+// RAII hook placed at the start of the evaluation methods
+class ProfileScope
+{
+public:
+    ProfileScope(ABSExpr* node, ProfiledOp op):
+        _profiler(Profiler::current())
+    {
+        if (_profiler) _profiler->enter(node, op);
+    }
+
+    ~ProfileScope(){
+        if (_profiler) _profiler->leave();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler* _profiler;
+};
+
+// SYM_PROFILE_SCOPE profiles the node of a member function,
+// SYM_PROFILE_NODE_SCOPE the node given by a free function
+#if SYM_PROFILE
+#define SYM_PROFILE_SCOPE(op) sym::ProfileScope _sym_profile_scope(this, sym::ProfiledOp::op)
+#define SYM_PROFILE_NODE_SCOPE(node, op) sym::ProfileScope _sym_profile_scope(node, sym::ProfiledOp::op)
+#else
+#define SYM_PROFILE_SCOPE(op) (void)0
+#define SYM_PROFILE_NODE_SCOPE(node, op) (void)0
+#endif
+
+}
+
+#endif
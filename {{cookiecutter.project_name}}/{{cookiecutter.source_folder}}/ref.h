@@ -0,0 +1,175 @@
+#ifndef PROJECT_TEST_SRC_REF_HEADER
+#define PROJECT_TEST_SRC_REF_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Reference count policy for expression graphs
+//  1: atomic counts, graphs can be shared between threads (default)
+//  0: plain integer counts, faster but a graph must stay on a single thread
+#ifndef SYM_ATOMIC_REFCOUNT
+#define SYM_ATOMIC_REFCOUNT 1
+#endif
+
+namespace sym
+{
+
+/*!
+ * \brief Base class storing the reference count inside the object.
+ *
+ * Unlike std::shared_ptr there is no separate control block and the count can be
+ * non-atomic when SYM_ATOMIC_REFCOUNT is 0.
+ */
+class RefCounted
+{
+public:
+    RefCounted() noexcept = default;
+    RefCounted(const RefCounted&) noexcept {}
+    RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+
+    void acquire_ref() const noexcept {
+#if SYM_ATOMIC_REFCOUNT
+        _refcount.fetch_add(1, std::memory_order_relaxed);
+#else
+        _refcount += 1;
+#endif
+    }
+
+    // Return true when the last reference was released
+    bool release_ref() const noexcept {
+#if SYM_ATOMIC_REFCOUNT
+        return _refcount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+        return --_refcount == 0;
+#endif
+    }
+
+    std::uint32_t ref_count() const noexcept {
+#if SYM_ATOMIC_REFCOUNT
+        return _refcount.load(std::memory_order_relaxed);
+#else
+        return _refcount;
+#endif
+    }
+
+private:
+#if SYM_ATOMIC_REFCOUNT
+    mutable std::atomic<std::uint32_t> _refcount{0};
+#else
+    mutable std::uint32_t _refcount = 0;
+#endif
+};
+
+
+/*!
+ * \brief Intrusive smart pointer, T must derive from RefCounted and have a virtual destructor
+ * if it is deleted through a base pointer.
+ */
+template<typename T>
+class Ref
+{
+public:
+    Ref() noexcept = default;
+    Ref(std::nullptr_t) noexcept {}
+
+    // Taking a raw pointer adds a reference, a live object can always be re-wrapped
+    explicit Ref(T* ptr) noexcept:
+        _ptr(ptr)
+    {
+        if (_ptr) _ptr->acquire_ref();
+    }
+
+    Ref(const Ref& other) noexcept:
+        Ref(other._ptr)
+    {}
+
+    Ref(Ref&& other) noexcept:
+        _ptr(other._ptr)
+    {
+        other._ptr = nullptr;
+    }
+
+    template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    Ref(const Ref<U>& other) noexcept:
+        Ref(other.get())
+    {}
+
+    template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    Ref(Ref<U>&& other) noexcept:
+        _ptr(other.detach())
+    {}
+
+    ~Ref(){ reset(); }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(_ptr, other._ptr);
+        return *this;
+    }
+
+    void reset() noexcept {
+        if (_ptr && _ptr->release_ref()){
+            delete _ptr;
+        }
+        _ptr = nullptr;
+    }
+
+    // Give up ownership without releasing the reference
+    T* detach() noexcept {
+        T* ptr = _ptr;
+        _ptr = nullptr;
+        return ptr;
+    }
+
+    T* get() const noexcept         { return _ptr; }
+    T* operator->() const noexcept  { return _ptr; }
+    T& operator*() const noexcept   { return *_ptr; }
+    explicit operator bool() const noexcept { return _ptr != nullptr; }
+
+    std::uint32_t use_count() const noexcept { return _ptr ? _ptr->ref_count() : 0; }
+
+private:
+    T* _ptr = nullptr;
+};
+
+template<typename T, typename U>
+bool operator==(const Ref<T>& a, const Ref<U>& b) noexcept { return a.get() == b.get(); }
+template<typename T, typename U>
+bool operator!=(const Ref<T>& a, const Ref<U>& b) noexcept { return a.get() != b.get(); }
+template<typename T>
+bool operator==(const Ref<T>& a, std::nullptr_t) noexcept { return a.get() == nullptr; }
+template<typename T>
+bool operator!=(const Ref<T>& a, std::nullptr_t) noexcept { return a.get() != nullptr; }
+template<typename T>
+bool operator==(std::nullptr_t, const Ref<T>& a) noexcept { return a.get() == nullptr; }
+template<typename T>
+bool operator!=(std::nullptr_t, const Ref<T>& a) noexcept { return a.get() != nullptr; }
+template<typename T, typename U>
+bool operator<(const Ref<T>& a, const Ref<U>& b) noexcept { return std::less<const void*>()(a.get(), b.get()); }
+
+template<typename T, typename ... Args>
+Ref<T> make_ref(Args&& ... args){
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+template<typename T, typename U>
+Ref<T> static_ref_cast(const Ref<U>& ref) noexcept {
+    return Ref<T>(static_cast<T*>(ref.get()));
+}
+
+}
+
+namespace std
+{
+template<typename T>
+struct hash<sym::Ref<T>>{
+    std::size_t operator()(const sym::Ref<T>& ref) const noexcept {
+        return std::hash<T*>()(ref.get());
+    }
+};
+}
+
+#endif
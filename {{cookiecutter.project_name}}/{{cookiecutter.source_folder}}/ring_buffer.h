@@ -0,0 +1,121 @@
+#ifndef PROJECT_TEST_SRC_RING_BUFFER_HEADER
+#define PROJECT_TEST_SRC_RING_BUFFER_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sym
+{
+
+/*!
+ * \brief Bounded lock-free queue, any number of producers and consumers.
+ *
+ * Each slot carries a sequence number telling whether it is ready to be written or read
+ * for the current lap (D. Vyukov's bounded queue). Producers and consumers only contend
+ * on their own position counter, a full queue fails instead of blocking.
+ *
+ * Values are never destroyed while the ring is alive, they are written and read in place:
+ * a slot holding a std::string keeps its capacity from one lap to the next.
+ *
+ * \code
+ *  RingBuffer<Record> ring(1024);
+ *  ring.try_push([&](Record& r){ r.text.assign(msg); });     // producer
+ *  ring.try_pop([&](Record& r){ write(r.text); });           // consumer
+ * \endcode
+ */
+template<typename T>
+class RingBuffer
+{
+public:
+    // `capacity` is rounded up to a power of 2
+    explicit RingBuffer(std::size_t capacity):
+        _mask(round_up(capacity) - 1), _slots(new Slot[_mask + 1])
+    {
+        for (std::size_t i = 0; i <= _mask; ++i){
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Call fill(T&) on a free slot, false when the ring is full
+    template<typename Fill>
+    bool try_push(Fill&& fill){
+        std::size_t pos = _head.load(std::memory_order_relaxed);
+
+        for (;;){
+            Slot& slot = _slots[pos & _mask];
+            std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+
+            if (diff == 0){
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    fill(slot.value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Call read(T&) on the oldest value, false when the ring is empty
+    template<typename Read>
+    bool try_pop(Read&& read){
+        std::size_t pos = _tail.load(std::memory_order_relaxed);
+
+        for (;;){
+            Slot& slot = _slots[pos & _mask];
+            std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+
+            if (diff == 0){
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    read(slot.value);
+                    slot.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate when other threads are pushing or popping
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+
+private:
+    struct alignas(64) Slot{
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t round_up(std::size_t n){
+        std::size_t p = 2;
+        while (p < n){
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const std::size_t _mask;
+    std::unique_ptr<Slot[]> _slots;
+
+    alignas(64) std::atomic<std::size_t> _head{0};
+    alignas(64) std::atomic<std::size_t> _tail{0};
+};
+
+}
+
+#endif
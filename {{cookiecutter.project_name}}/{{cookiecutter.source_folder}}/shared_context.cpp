@@ -0,0 +1,161 @@
+#include "shared_context.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace sym{
+
+// Epoch based reclamation
+// --------------------------------------------
+// One domain for every SharedContext: a reader announces a single epoch whatever
+// the number of contexts it reads.
+namespace {
+
+struct alignas(64) ReaderRecord{
+    std::atomic<std::uint64_t> epoch{0};    // 0 when the thread is not reading
+    std::atomic<bool> used{true};
+    ReaderRecord* next = nullptr;
+    unsigned depth = 0;                     // nested readers, only touched by the owner
+};
+
+struct EpochDomain{
+    std::atomic<std::uint64_t> epoch{1};
+    std::atomic<ReaderRecord*> records{nullptr};
+    std::mutex registration;
+
+    // Records are never freed, the record of an exited thread is reused
+    ReaderRecord* acquire(){
+        std::lock_guard<std::mutex> lock(registration);
+
+        for (ReaderRecord* r = records.load(std::memory_order_acquire); r != nullptr; r = r->next){
+            if (!r->used.exchange(true, std::memory_order_acquire)){
+                return r;
+            }
+        }
+
+        ReaderRecord* r = new ReaderRecord();
+        r->next = records.load(std::memory_order_relaxed);
+        records.store(r, std::memory_order_release);
+        return r;
+    }
+
+    // Oldest epoch announced by an active reader
+    std::uint64_t oldest_reader() const {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+        for (ReaderRecord* r = records.load(std::memory_order_acquire); r != nullptr; r = r->next){
+            std::uint64_t e = r->epoch.load(std::memory_order_acquire);
+            if (e != 0){
+                oldest = std::min(oldest, e);
+            }
+        }
+        return oldest;
+    }
+};
+
+// Leaked: threads can still exit after static destruction
+EpochDomain& domain(){
+    static EpochDomain* d = new EpochDomain();
+    return *d;
+}
+
+struct ThreadRecord{
+    ReaderRecord* record = domain().acquire();
+    ~ThreadRecord(){ record->used.store(false, std::memory_order_release); }
+};
+
+ReaderRecord& this_thread_record(){
+    thread_local ThreadRecord t;
+    return *t.record;
+}
+}
+
+// Readers
+// --------------------------------------------
+SharedContext::Reader SharedContext::read() const {
+    ReaderRecord& r = this_thread_record();
+
+    if (r.depth++ == 0){
+        r.epoch.store(domain().epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        // The announcement must be visible before the snapshot is loaded
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    return Reader(_current.load(std::memory_order_acquire));
+}
+
+SharedContext::Reader::~Reader(){
+    if (_ctx == nullptr){
+        return;
+    }
+
+    ReaderRecord& r = this_thread_record();
+    if (--r.depth == 0){
+        r.epoch.store(0, std::memory_order_release);
+    }
+}
+
+PersistentContext SharedContext::snapshot() const   { Reader r = read(); return *r; }
+double SharedContext::full_eval(Expr const& f) const { Reader r = read(); return f->full_eval(*r); }
+Expr SharedContext::partial_eval(Expr const& f) const { Reader r = read(); return f->partial_eval(*r); }
+
+// Writers
+// --------------------------------------------
+SharedContext::SharedContext(PersistentContext initial):
+    _current(new PersistentContext(std::move(initial)))
+{}
+
+SharedContext::~SharedContext(){
+    delete _current.load();
+    for (auto& item: _retired){
+        delete item.second;
+    }
+}
+
+void SharedContext::update(std::function<PersistentContext(const PersistentContext&)> const& fn){
+    std::lock_guard<std::mutex> lock(_writer);
+
+    const PersistentContext* next = new PersistentContext(fn(*_current.load(std::memory_order_relaxed)));
+    const PersistentContext* previous = _current.exchange(next, std::memory_order_seq_cst);
+
+    // Readers announcing a later epoch loaded the pointer after the exchange
+    std::uint64_t epoch = domain().epoch.fetch_add(1, std::memory_order_seq_cst);
+    _retired.emplace_back(epoch, previous);
+
+    reclaim();
+}
+
+void SharedContext::set(const std::string& name, Expr value){
+    set(intern(name), std::move(value));
+}
+
+void SharedContext::set(SymbolId id, Expr value){
+    update([&](const PersistentContext& ctx){ return ctx.insert(id, value); });
+}
+
+void SharedContext::assign(PersistentContext ctx){
+    update([&](const PersistentContext&){ return std::move(ctx); });
+}
+
+void SharedContext::collect(){
+    std::lock_guard<std::mutex> lock(_writer);
+    reclaim();
+}
+
+std::size_t SharedContext::retired() const {
+    std::lock_guard<std::mutex> lock(_writer);
+    return _retired.size();
+}
+
+// A snapshot retired at epoch e can still be used by readers that announced e or less
+void SharedContext::reclaim(){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t oldest = domain().oldest_reader();
+
+    auto alive = std::partition(_retired.begin(), _retired.end(),
+        [oldest](auto const& item){ return item.first >= oldest; });
+
+    for (auto it = alive; it != _retired.end(); ++it){
+        delete it->second;
+    }
+    _retired.erase(alive, _retired.end());
+}
+}
@@ -0,0 +1,119 @@
+#ifndef PROJECT_TEST_SRC_SHARED_CONTEXT_HEADER
+#define PROJECT_TEST_SRC_SHARED_CONTEXT_HEADER
+
+#include "symbolic.h"
+#include "context.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sym
+{
+
+/*!
+ * \brief Context read by many threads and updated by a few, read-copy-update.
+ *
+ * The bindings are an immutable PersistentContext snapshot published through an atomic
+ * pointer. Readers announce the current epoch, load the pointer and evaluate against the
+ * snapshot directly: no lock, no read-modify-write, reads are wait-free.
+ * Writers build the next snapshot from the current one (O(log n) path copying), publish it
+ * and retire the previous one, which is deleted once every reader that could still see it
+ * has left its read section (epoch based reclamation).
+ *
+ * \code
+ *  sym::SharedContext params(sym::PersistentContext().insert("k", sym::make_val(1)));
+ *
+ *  // evaluator threads
+ *  double v = params.full_eval(f);
+ *
+ *  // control thread
+ *  params.set("k", sym::make_val(2));
+ * \endcode
+ *
+ * A thread registers itself the first time it reads (one mutex acquisition per thread).
+ * Expressions bound in the context are shared between threads, SYM_ATOMIC_REFCOUNT
+ * must be enabled.
+ */
+class SharedContext
+{
+public:
+    /*!
+     * \brief Pins the snapshot that was current when it was created.
+     *
+     * Readers are cheap and can be nested, they must be destroyed by the thread that
+     * created them. Holding one does not block writers, it only delays reclamation.
+     */
+    class Reader
+    {
+    public:
+        Reader(Reader&& r) noexcept:
+            _ctx(std::exchange(r._ctx, nullptr))
+        {}
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+        ~Reader();
+
+        const PersistentContext& operator*() const  { return *_ctx; }
+        const PersistentContext* operator->() const { return _ctx; }
+
+    private:
+        friend class SharedContext;
+
+        explicit Reader(const PersistentContext* ctx):
+            _ctx(ctx)
+        {}
+
+        const PersistentContext* _ctx;
+    };
+
+    explicit SharedContext(PersistentContext initial = PersistentContext());
+
+    // No reader may be active
+    ~SharedContext();
+
+    SharedContext(const SharedContext&) = delete;
+    SharedContext& operator=(const SharedContext&) = delete;
+
+    // Writers are serialized with each other, they never wait for readers
+    void set(const std::string& name, Expr value);
+    void set(SymbolId id, Expr value);
+
+    // Replace every binding at once
+    void assign(PersistentContext ctx);
+
+    // Publish `fn(current)`, readers see either every change or none of them
+    void update(std::function<PersistentContext(const PersistentContext&)> const& fn);
+
+    Reader read() const;
+
+    // Copy of the current bindings, valid after the next updates
+    PersistentContext snapshot() const;
+
+    double full_eval(Expr const& f) const;
+    Expr partial_eval(Expr const& f) const;
+
+    // Delete the retired snapshots no reader can see anymore, writers do it on every update
+    void collect();
+
+    // Snapshots waiting for reclamation
+    std::size_t retired() const;
+
+private:
+    void reclaim();
+
+    std::atomic<const PersistentContext*> _current;
+
+    mutable std::mutex _writer;
+    std::vector<std::pair<std::uint64_t, const PersistentContext*>> _retired;
+};
+
+}
+
+#endif
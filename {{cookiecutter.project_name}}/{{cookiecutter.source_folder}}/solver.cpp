@@ -0,0 +1,248 @@
+#include "solver.h"
+#include "gradient.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace sym{
+
+Solver::Solver(std::vector<Expr> const& equations,
+               std::vector<std::string> const& unknowns,
+               std::vector<std::string> const& parameters,
+               CompileOptions const& options):
+    _equations(equations.size()), _unknowns(unknowns.size()), _parameters(parameters.size())
+{
+    if (equations.empty() || unknowns.empty()){
+        throw std::invalid_argument("solver needs at least one equation and one unknown");
+    }
+
+    // f then the Jacobian row by row, the gradients share their adjoints with f
+    std::vector<Expr> outputs = equations;
+    for (auto& eq: equations){
+        auto row = symbolic_gradient(eq, unknowns);
+        outputs.insert(outputs.end(), row.begin(), row.end());
+    }
+
+    std::vector<std::string> inputs = unknowns;
+    inputs.insert(inputs.end(), parameters.begin(), parameters.end());
+
+    _program = compile(outputs, inputs, options);
+}
+
+bool solve_linear(double* a, double* b, std::size_t n){
+    for (std::size_t col = 0; col < n; ++col){
+        std::size_t pivot = col;
+        for (std::size_t row = col + 1; row < n; ++row){
+            if (std::abs(a[row * n + col]) > std::abs(a[pivot * n + col])){
+                pivot = row;
+            }
+        }
+
+        if (a[pivot * n + col] == 0 || !std::isfinite(a[pivot * n + col])){
+            return false;
+        }
+
+        if (pivot != col){
+            std::swap_ranges(a + pivot * n, a + pivot * n + n, a + col * n);
+            std::swap(b[pivot], b[col]);
+        }
+
+        for (std::size_t row = col + 1; row < n; ++row){
+            double factor = a[row * n + col] / a[col * n + col];
+            for (std::size_t k = col; k < n; ++k){
+                a[row * n + k] -= factor * a[col * n + k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (std::size_t col = n; col > 0; --col){
+        std::size_t row = col - 1;
+        double sum = b[row];
+        for (std::size_t k = row + 1; k < n; ++k){
+            sum -= a[row * n + k] * b[k];
+        }
+        b[row] = sum / a[row * n + row];
+    }
+    return true;
+}
+
+SolveResult Solver::solve(std::vector<double> const& starts,
+                          std::vector<double> const& params,
+                          std::size_t problems,
+                          SolverOptions const& options) const
+{
+    if (options.method == SolverMethod::Newton && _equations != _unknowns){
+        throw std::invalid_argument("Newton needs as many equations as unknowns");
+    }
+    if (starts.size() != problems * _unknowns){
+        throw std::invalid_argument("one starting point per problem is required");
+    }
+    if (params.size() != problems * _parameters && params.size() != _parameters){
+        throw std::invalid_argument("one set of parameters per problem is required");
+    }
+
+    SolveResult result;
+    result.x.resize(problems * _unknowns);
+    result.residual.resize(problems);
+    result.iterations.resize(problems);
+    result.converged.resize(problems);
+
+    ThreadPool& pool = options.pool ? *options.pool : ThreadPool::global();
+
+    pool.parallel_for(problems, Program::block_size, [&](std::size_t begin, std::size_t end){
+        solve_block(starts, params, begin, end - begin, options, result);
+    });
+
+    return result;
+}
+
+void Solver::solve_block(std::vector<double> const& starts, std::vector<double> const& params,
+                         std::size_t first, std::size_t count,
+                         SolverOptions const& options, SolveResult& result) const
+{
+    const std::size_t n = _unknowns;
+    const std::size_t m = _equations;
+    const std::size_t q = _parameters;
+    const bool newton = options.method == SolverMethod::Newton;
+    const bool shared_params = params.size() == q && count > 0 && q > 0;
+
+    // Inputs and outputs are columns of `count` lanes
+    std::vector<double> in((n + q) * count);
+    std::vector<double> out((m + m * n) * count);
+    std::vector<const double*> in_cols(n + q);
+    std::vector<double*> out_cols(m + m * n);
+
+    for (std::size_t k = 0; k < n + q; ++k)     in_cols[k] = in.data() + k * count;
+    for (std::size_t k = 0; k < m + m * n; ++k) out_cols[k] = out.data() + k * count;
+
+    for (std::size_t l = 0; l < count; ++l){
+        for (std::size_t j = 0; j < n; ++j){
+            in[j * count + l] = starts[(first + l) * n + j];
+        }
+        for (std::size_t j = 0; j < q; ++j){
+            in[(n + j) * count + l] = shared_params ? params[j] : params[(first + l) * q + j];
+        }
+    }
+
+    // Last accepted state of each lane
+    std::vector<double> x(count * n);
+    std::vector<double> f(count * m);
+    std::vector<double> jac(count * m * n);
+    std::vector<double> norm(count, std::numeric_limits<double>::infinity());
+    std::vector<double> lambda(count, options.lambda);
+    std::vector<char> active(count, 1);
+
+    std::vector<double> a(n * n);
+    std::vector<double> dx(n);
+
+    for (std::size_t iteration = 0; iteration <= options.max_iterations; ++iteration){
+        _program.eval_all(in_cols.data(), out_cols.data(), count);
+        bool any_active = false;
+
+        for (std::size_t l = 0; l < count; ++l){
+            if (!active[l]){
+                continue;
+            }
+
+            double candidate = 0;
+            for (std::size_t i = 0; i < m; ++i){
+                candidate += out[i * count + l] * out[i * count + l];
+            }
+            candidate = std::sqrt(candidate);
+
+            // Newton takes every step, Levenberg-Marquardt only keeps the steps that reduce ||f||
+            if (newton || candidate < norm[l]){
+                if (!newton && iteration > 0){
+                    lambda[l] /= 10;
+                }
+
+                norm[l] = candidate;
+                for (std::size_t j = 0; j < n; ++j)     x[l * n + j] = in[j * count + l];
+                for (std::size_t i = 0; i < m; ++i)     f[l * m + i] = out[i * count + l];
+                for (std::size_t k = 0; k < m * n; ++k) jac[l * m * n + k] = out[(m + k) * count + l];
+            } else {
+                lambda[l] *= 10;
+            }
+
+            result.iterations[first + l] = std::uint32_t(iteration);
+
+            if (norm[l] <= options.tolerance){
+                result.converged[first + l] = 1;
+                active[l] = 0;
+                continue;
+            }
+
+            if (iteration == options.max_iterations || !std::isfinite(norm[l])){
+                active[l] = 0;
+                continue;
+            }
+
+            const double* fl = f.data() + l * m;
+            const double* jl = jac.data() + l * m * n;
+            bool solved;
+
+            if (newton){
+                std::copy_n(jl, n * n, a.data());
+                for (std::size_t i = 0; i < n; ++i) dx[i] = -fl[i];
+                solved = solve_linear(a.data(), dx.data(), n);
+            } else {
+                // (J'J + lambda diag(J'J)) dx = -J'f
+                for (std::size_t r = 0; r < n; ++r){
+                    for (std::size_t c = 0; c < n; ++c){
+                        double sum = 0;
+                        for (std::size_t i = 0; i < m; ++i) sum += jl[i * n + r] * jl[i * n + c];
+                        a[r * n + c] = sum;
+                    }
+
+                    double g = 0;
+                    for (std::size_t i = 0; i < m; ++i) g += jl[i * n + r] * fl[i];
+                    dx[r] = -g;
+                }
+                for (std::size_t r = 0; r < n; ++r){
+                    a[r * n + r] += lambda[l] * std::max(a[r * n + r], 1e-12);
+                }
+                solved = solve_linear(a.data(), dx.data(), n);
+            }
+
+            if (!solved){
+                // Newton is stuck on a singular Jacobian, LM retries with more damping
+                if (newton){
+                    active[l] = 0;
+                    continue;
+                }
+                std::fill(dx.begin(), dx.end(), 0);
+            }
+
+            double step = 0;
+            double size = 0;
+            for (std::size_t j = 0; j < n; ++j){
+                step += dx[j] * dx[j];
+                size += x[l * n + j] * x[l * n + j];
+                in[j * count + l] = x[l * n + j] + dx[j];
+            }
+
+            // The step is lost in rounding: a root for Newton, a minimum of ||f|| for least squares
+            if (solved && std::sqrt(step) <= options.step_tolerance * (std::sqrt(size) + options.step_tolerance)){
+                result.converged[first + l] = 1;
+                active[l] = 0;
+                continue;
+            }
+
+            any_active = true;
+        }
+
+        if (!any_active){
+            break;
+        }
+    }
+
+    for (std::size_t l = 0; l < count; ++l){
+        std::copy_n(x.data() + l * n, n, result.x.data() + (first + l) * n);
+        result.residual[first + l] = norm[l];
+    }
+}
+}
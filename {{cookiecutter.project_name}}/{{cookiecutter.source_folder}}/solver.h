@@ -0,0 +1,87 @@
+#ifndef PROJECT_TEST_SRC_SOLVER_HEADER
+#define PROJECT_TEST_SRC_SOLVER_HEADER
+
+#include "symbolic.h"
+#include "compile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+class ThreadPool;
+
+enum class SolverMethod{
+    Newton,                 // square systems, J dx = -f
+    LevenbergMarquardt      // least squares, (J'J + lambda diag(J'J)) dx = -J'f
+};
+
+struct SolverOptions{
+    SolverMethod method = SolverMethod::Newton;
+    std::size_t max_iterations = 50;
+    double tolerance = 1e-12;           // stop when ||f|| is below
+    double step_tolerance = 1e-15;      // stop when the step is below (relative to ||x||)
+    double lambda = 1e-3;               // initial Levenberg-Marquardt damping
+    ThreadPool* pool = nullptr;         // ThreadPool::global() when null
+};
+
+// Solve `a x = b` by Gaussian elimination with partial pivoting, `a` is n x n row major.
+// Both are overwritten, the solution replaces `b`. Returns false if `a` is singular
+bool solve_linear(double* a, double* b, std::size_t n);
+
+// Results of each problem, stored problem after problem
+struct SolveResult{
+    std::vector<double> x;                  // problems x unknowns
+    std::vector<double> residual;           // ||f(x)|| of each problem
+    std::vector<std::uint32_t> iterations;
+    std::vector<char> converged;
+};
+
+/*!
+ * \brief Solve many independent instances of a system of equations f(x; p) = 0.
+ *
+ * f and its Jacobian are derived and compiled once into a single program. Problems are
+ * solved by blocks of Program::block_size so each evaluation runs over SIMD lanes, blocks
+ * are spread on a thread pool.
+ *
+ * \code
+ *  // x * x - a = 0 for many a
+ *  sym::Solver solver({sym::add(sym::mult(x, x), sym::mult(sym::make_val(-1), a))}, {"x"}, {"a"});
+ *  auto result = solver.solve(starts, params, n);
+ * \endcode
+ */
+class Solver
+{
+public:
+    Solver(std::vector<Expr> const& equations,
+           std::vector<std::string> const& unknowns,
+           std::vector<std::string> const& parameters = {},
+           CompileOptions const& options = CompileOptions());
+
+    // `starts` holds problems x unknowns values, `params` holds problems x parameters values
+    // or a single set of parameters shared by every problem
+    SolveResult solve(std::vector<double> const& starts,
+                      std::vector<double> const& params,
+                      std::size_t problems,
+                      SolverOptions const& options = SolverOptions()) const;
+
+    std::size_t equation_count() const  { return _equations; }
+    std::size_t unknown_count() const   { return _unknowns; }
+
+private:
+    void solve_block(std::vector<double> const& starts, std::vector<double> const& params,
+                     std::size_t first, std::size_t count,
+                     SolverOptions const& options, SolveResult& result) const;
+
+    std::size_t _equations;
+    std::size_t _unknowns;
+    std::size_t _parameters;
+    Program _program;       // outputs: f (equations) then J (equations x unknowns)
+};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "specialize.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace sym{
+
+struct Specialized::Plan{
+    Expr f;                             // keeps the cache key alive
+    std::vector<std::string> bound;
+    Program hoisted;                    // bound -> value of every hoisted expression
+    Program residual;                   // hoisted values are constants, NaN until bound
+    std::vector<std::size_t> slots;     // instruction of `residual` holding hoisted value k
+};
+
+namespace {
+using CacheKey = std::tuple<const ABSExpr*, std::vector<std::string>, bool>;
+
+struct Cache{
+    std::mutex mutex;
+    std::map<CacheKey, std::shared_ptr<const Specialized::Plan>> plans;
+};
+
+Cache& cache(){
+    static Cache instance;
+    return instance;
+}
+}
+
+static std::string slot_name(std::size_t k){
+    return "@hoisted" + std::to_string(k);
+}
+
+std::shared_ptr<const Specialized::Plan> Specialized::make_plan(Expr const& f, std::vector<std::string> bound, CompileOptions const& options){
+    auto plan = std::make_shared<Plan>();
+    plan->f = f;
+    plan->bound = std::move(bound);
+
+    std::unordered_set<std::string> is_bound(plan->bound.begin(), plan->bound.end());
+    std::vector<ABSExpr*> order = topological_order(f);
+
+    // Static nodes only depend on bound variables and constants
+    std::unordered_set<ABSExpr*> is_static;
+    for (ABSExpr* node: order){
+        bool value = false;
+
+        switch (node->kind()){
+        case NodeKind::Scalar:
+            value = true;
+            break;
+        case NodeKind::Placeholder:
+            value = is_bound.count(static_cast<Placeholder*>(node)->name()) > 0;
+            break;
+        case NodeKind::Add:
+        case NodeKind::Mult:
+            value = is_static.count(node->child(0).get()) && is_static.count(node->child(1).get());
+            break;
+        default:
+            throw std::invalid_argument(std::string("cannot specialize node ") + to_string(node->kind()));
+        }
+
+        if (value){
+            is_static.insert(node);
+        }
+    }
+
+    // Hoist the largest static sub expressions, constants are already constants
+    std::unordered_map<ABSExpr*, std::size_t> slot_of;
+    std::vector<Expr> hoisted;
+
+    auto hoist = [&](Expr const& e){
+        if (e->kind() != NodeKind::Scalar && is_static.count(e.get()) && !slot_of.count(e.get())){
+            slot_of.emplace(e.get(), hoisted.size());
+            hoisted.push_back(e);
+        }
+    };
+
+    hoist(f);
+    for (ABSExpr* node: order){
+        if (!is_static.count(node) && node->arity() == 2){
+            hoist(node->child(0));
+            hoist(node->child(1));
+        }
+    }
+
+    // Residual expression: hoisted expressions are replaced by placeholders
+    std::unordered_map<ABSExpr*, Expr> rebuilt;
+    for (ABSExpr* node: order){
+        auto slot = slot_of.find(node);
+        if (slot != slot_of.end()){
+            rebuilt.emplace(node, make_var(slot_name(slot->second)));
+        } else if (node->arity() == 0){
+            rebuilt.emplace(node, Expr(node));
+        } else if (!is_static.count(node)){
+            Expr const& l = rebuilt.at(node->child(0).get());
+            Expr const& r = rebuilt.at(node->child(1).get());
+            rebuilt.emplace(node, node->kind() == NodeKind::Add ? add(l, r) : mult(l, r));
+        }
+    }
+
+    std::vector<std::string> inputs;
+    for (auto& name: placeholders(f)){
+        if (!is_bound.count(name)){
+            inputs.push_back(name);
+        }
+    }
+
+    std::size_t free_count = inputs.size();
+    for (std::size_t k = 0; k < hoisted.size(); ++k){
+        inputs.push_back(slot_name(k));
+    }
+
+    plan->hoisted = compile(hoisted, plan->bound, options);
+    plan->residual = compile(rebuilt.at(f.get()), inputs, options);
+
+    // Hoisted values are loaded once each, turn the loads into constants
+    plan->slots.resize(hoisted.size());
+    for (std::size_t i = 0; i < plan->residual._code.size(); ++i){
+        auto& instr = plan->residual._code[i];
+        if (instr.op == Program::Op::Input && instr.a >= free_count){
+            plan->slots[instr.a - free_count] = i;
+            instr.op = Program::Op::Const;
+            instr.a = 0;
+            instr.value = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+    plan->residual._inputs.resize(free_count);
+    return plan;
+}
+
+Specialized::Specialized(std::shared_ptr<const Plan> plan):
+    _plan(std::move(plan)), _program(_plan->residual), _hoisted(_plan->slots.size())
+{}
+
+void Specialized::bind(const double* values){
+    if (_hoisted.empty()){
+        return;
+    }
+
+    _plan->hoisted.eval_all(values, _hoisted.data());
+    for (std::size_t k = 0; k < _hoisted.size(); ++k){
+        _program._code[_plan->slots[k]].value = _hoisted[k];
+    }
+}
+
+void Specialized::bind(std::vector<double> const& values){
+    if (values.size() != _plan->bound.size()){
+        throw std::invalid_argument("expected " + std::to_string(_plan->bound.size()) + " bound values");
+    }
+    bind(values.data());
+}
+
+const std::vector<std::string>& Specialized::bound() const {
+    return _plan->bound;
+}
+
+std::size_t Specialized::hoisted_count() const {
+    return _plan->slots.size();
+}
+
+Specialized specialize(Expr const& f, std::vector<std::string> const& bound, CompileOptions const& options){
+    std::vector<std::string> names = bound;
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    CacheKey key(f.get(), names, options.contract_fma);
+    Cache& c = cache();
+
+    {
+        std::lock_guard<std::mutex> lock(c.mutex);
+        auto it = c.plans.find(key);
+        if (it != c.plans.end()){
+            return Specialized(it->second);
+        }
+    }
+
+    // Built outside of the lock, when two threads race the first plan wins
+    auto plan = Specialized::make_plan(f, std::move(names), options);
+
+    std::lock_guard<std::mutex> lock(c.mutex);
+    auto it = c.plans.emplace(std::move(key), std::move(plan)).first;
+    return Specialized(it->second);
+}
+
+std::size_t specialization_cache_size(){
+    std::lock_guard<std::mutex> lock(cache().mutex);
+    return cache().plans.size();
+}
+
+void clear_specialization_cache(){
+    std::lock_guard<std::mutex> lock(cache().mutex);
+    cache().plans.clear();
+}
+}
@@ -0,0 +1,83 @@
+#ifndef PROJECT_TEST_SRC_SPECIALIZE_HEADER
+#define PROJECT_TEST_SRC_SPECIALIZE_HEADER
+
+#include "compile.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+/*!
+ * \brief Program specialized for a fixed set of bound variables.
+ *
+ * Sub expressions that only depend on bound variables (and constants) are hoisted out of
+ * the program: binding evaluates them once and writes the results into the constants of
+ * the program, the tree is never rebuilt. The remaining variables are the inputs of the
+ * program, in order of first appearance.
+ *
+ * The analysis is cached by (expression, set of bound variables), specializing the same
+ * model again is a lookup. The cache keeps the expression alive until
+ * clear_specialization_cache() is called.
+ *
+ * \code
+ *  auto spec = sym::specialize(f, {"w", "b"});     // bound() is sorted: {"b", "w"}
+ *  for (auto& request: requests){
+ *      spec.bind({request.b, request.w});
+ *      double v = spec.eval(request.inputs);
+ *  }
+ * \endcode
+ */
+class Specialized
+{
+public:
+    struct Plan;
+
+    // Set the values of the bound variables, given in the order of `bound()`.
+    // Costs one evaluation of the hoisted expressions
+    void bind(const double* values);
+    void bind(std::vector<double> const& values);
+
+    // Evaluate with the last bound values, same as Program::eval
+    double eval(const double* inputs) const { return _program.eval(inputs); }
+    void eval(const double* const* columns, double* out, std::size_t n) const { _program.eval(columns, out, n); }
+
+    // Bound variables, sorted by name
+    const std::vector<std::string>& bound() const;
+
+    // Variables left free, inputs of `program()`
+    const std::vector<std::string>& inputs() const { return _program.inputs(); }
+
+    // Number of hoisted sub expressions
+    std::size_t hoisted_count() const;
+
+    const Program& program() const { return _program; }
+
+private:
+    friend Specialized specialize(Expr const&, std::vector<std::string> const&, CompileOptions const&);
+
+    explicit Specialized(std::shared_ptr<const Plan> plan);
+
+    static std::shared_ptr<const Plan> make_plan(Expr const& f, std::vector<std::string> bound, CompileOptions const& options);
+
+    std::shared_ptr<const Plan> _plan;
+    Program _program;
+    std::vector<double> _hoisted;
+};
+
+// Specialize `f` for the variables in `bound`, the values are given later by Specialized::bind.
+// Throws std::invalid_argument for nodes that cannot be compiled
+Specialized specialize(Expr const& f, std::vector<std::string> const& bound, CompileOptions const& options = CompileOptions());
+
+// Number of cached specializations
+std::size_t specialization_cache_size();
+
+// Drop every cached specialization, existing Specialized objects stay valid
+void clear_specialization_cache();
+
+}
+
+#endif
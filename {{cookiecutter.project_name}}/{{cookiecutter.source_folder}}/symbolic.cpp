@@ -1,44 +1,362 @@
 #include "symbolic.h"
+#include "context.h"
+#include "fold.h"
+#include "profiler.h"
 #include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace sym{
 
-double Placeholder::full_eval(const Context& c)     { return c.at(_name)->full_eval(c); }
-Expr Placeholder::partial_eval(const Context& c)    {
-    try{
-        return c.at(_name);
-    } catch (std::out_of_range const&) {
-        return Placeholder::make(_name);
-        // return std::weak_ptr(?);
+const char* to_string(NodeKind kind){
+    switch (kind){
+    case NodeKind::Placeholder: return "Placeholder";
+    case NodeKind::Scalar:      return "Scalar";
+    case NodeKind::Add:         return "Add";
+    case NodeKind::Mult:        return "Mult";
+    case NodeKind::TensorPlaceholder:   return "TensorPlaceholder";
+    case NodeKind::TensorConstant:      return "TensorConstant";
+    case NodeKind::TensorAdd:           return "TensorAdd";
+    case NodeKind::TensorMult:          return "TensorMult";
+    case NodeKind::MatMul:              return "MatMul";
+    case NodeKind::Transpose:           return "Transpose";
+    case NodeKind::Sum:                 return "Sum";
     }
+    return "Unknown";
+}
+
+Expr const& ABSExpr::child(std::size_t i) const { throw std::out_of_range("node has no child " + std::to_string(i)); }
+Tensor ABSExpr::tensor_eval(const Context& c)           { return Tensor(full_eval(c)); }
+Tensor ABSExpr::tensor_eval(const PersistentContext& c) { return Tensor(full_eval(c)); }
+
+Placeholder::Placeholder(const std::string& name):
+    _name(name), _id(intern(name))
+{}
+
+double Placeholder::full_eval(const Context& c)     { SYM_PROFILE_SCOPE(FullEval); return c.at(_name)->full_eval(c); }
+Expr Placeholder::partial_eval(const Context& c)    {
+    SYM_PROFILE_SCOPE(PartialEval);
+    auto it = c.find(_name);
+    return it != c.end() ? it->second : Expr(this);
+}
+double Placeholder::full_eval(const PersistentContext& c)   { SYM_PROFILE_SCOPE(FullEval); return c.at(_id)->full_eval(c); }
+Expr Placeholder::partial_eval(const PersistentContext& c)  {
+    SYM_PROFILE_SCOPE(PartialEval);
+    Expr value = c.find(_id);
+    return value ? value : Expr(this);
 }
 std::ostream& Placeholder::gen(std::ostream& out)   { return out << _name;}
-Expr Placeholder::derivate(const std::string& n)    { return n == _name ? Scalar::make(1): Scalar::make(0); }
+Expr Placeholder::derivate(const std::string& n)    { SYM_PROFILE_SCOPE(Derivate); return n == _name ? Scalar::make(1): Scalar::make(0); }
 
-double Scalar::full_eval(const Context&)        {   return _value; }
-Expr Scalar::partial_eval(const Context&)       {   return Scalar::make(_value); }
+double Scalar::full_eval(const Context&)        {   SYM_PROFILE_SCOPE(FullEval); return _value; }
+Expr Scalar::partial_eval(const Context&)       {   SYM_PROFILE_SCOPE(PartialEval); return Expr(this); }
+double Scalar::full_eval(const PersistentContext&)  {   SYM_PROFILE_SCOPE(FullEval); return _value; }
+Expr Scalar::partial_eval(const PersistentContext&) {   SYM_PROFILE_SCOPE(PartialEval); return Expr(this); }
 std::ostream& Scalar::gen(std::ostream& out)    {   return out << _value; }
-Expr Scalar::derivate(const std::string&)       {   return Scalar::make(0); }
+Expr Scalar::derivate(const std::string&)       {   SYM_PROFILE_SCOPE(Derivate); return Scalar::make(0); }
 
-double Add::full_eval(const Context& c)     {   return _lhs->full_eval(c) + _rhs->full_eval(c); }
-Expr Add::partial_eval(const Context& c)    {   return Add::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
+double Add::full_eval(const Context& c)     {   SYM_PROFILE_SCOPE(FullEval); return _lhs->full_eval(c) + _rhs->full_eval(c); }
+Expr Add::partial_eval(const Context& c)    {   SYM_PROFILE_SCOPE(PartialEval); return Add::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
+double Add::full_eval(const PersistentContext& c)   {   SYM_PROFILE_SCOPE(FullEval); return _lhs->full_eval(c) + _rhs->full_eval(c); }
+Expr Add::partial_eval(const PersistentContext& c)  {   SYM_PROFILE_SCOPE(PartialEval); return Add::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
 std::ostream& Add::gen(std::ostream& out)   {   out << "("; _lhs->gen(out) << " + "; _rhs->gen(out) << ")"; return out;}
-Expr Add::derivate(const std::string& c)    {   return Add::make(_lhs->derivate(c), _rhs->derivate(c));}
+Expr Add::derivate(const std::string& c)    {   SYM_PROFILE_SCOPE(Derivate); return add(_lhs->derivate(c), _rhs->derivate(c));}
 
-double Mult::full_eval(const Context& c)    {   return _lhs->full_eval(c) * _rhs->full_eval(c); }
-Expr Mult::partial_eval(const Context& c)   {   return Mult::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
+double Mult::full_eval(const Context& c)    {   SYM_PROFILE_SCOPE(FullEval); return _lhs->full_eval(c) * _rhs->full_eval(c); }
+Expr Mult::partial_eval(const Context& c)   {   SYM_PROFILE_SCOPE(PartialEval); return Mult::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
+double Mult::full_eval(const PersistentContext& c)  {   SYM_PROFILE_SCOPE(FullEval); return _lhs->full_eval(c) * _rhs->full_eval(c); }
+Expr Mult::partial_eval(const PersistentContext& c) {   SYM_PROFILE_SCOPE(PartialEval); return Mult::make(_lhs->partial_eval(c), _rhs->partial_eval(c));}
 std::ostream& Mult::gen(std::ostream& out)  {   out << "("; _lhs->gen(out) << " * "; _rhs->gen(out) << ")"; return out;}
 
 Expr Mult::derivate(const std::string& c)   {
-    auto a = Mult::make(_lhs->derivate(c), _rhs);
-    auto b = Mult::make(_lhs, _rhs->derivate(c));
-    return Add::make(a, b);
+    SYM_PROFILE_SCOPE(Derivate);
+    auto a = mult(_lhs->derivate(c), _rhs);
+    auto b = mult(_lhs, _rhs->derivate(c));
+    return add(a, b);
+}
+
+// Tensors
+// --------------------------------------------
+// 1 x 1 values broadcast to `shape`, for the operations that do not broadcast (matmul, sum)
+static Expr expand(Expr e, Shape shape){
+    if (e->shape() == shape) return e;
+    if (is_constant(e, 0)) return make_tensor(Tensor(shape.rows, shape.cols));
+    return mult(std::move(e), make_tensor(Tensor(shape.rows, shape.cols, 1)));
+}
+
+// Reverse accumulation of the gradient of the 1 x 1 `root` with respect to the tensor placeholder `name`
+static Expr tensor_gradient(Expr const& root, const std::string& name, Shape shape){
+    auto order = topological_order(root);
+    std::unordered_map<ABSExpr*, Expr> adjoint;
+    adjoint[root.get()] = Scalar::make(1);
+    Expr result = Scalar::make(0);
+
+    // Adjoints of broadcast operands are summed back to 1 x 1
+    auto accumulate = [&](Expr const& node, Expr g){
+        if (node->shape().scalar() && !g->shape().scalar()){
+            g = sum(std::move(g));
+        }
+        Expr& a = adjoint[node.get()];
+        a = a ? fold_add(std::move(a), std::move(g)) : std::move(g);
+    };
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it){
+        ABSExpr* node = *it;
+        auto found = adjoint.find(node);
+        if (found == adjoint.end() || is_constant(found->second, 0)){
+            continue;
+        }
+        Expr g = found->second;
+
+        switch (node->kind()){
+        case NodeKind::Add:
+        case NodeKind::TensorAdd:
+            accumulate(node->child(0), g);
+            accumulate(node->child(1), g);
+            break;
+        case NodeKind::Mult:
+        case NodeKind::TensorMult:
+            accumulate(node->child(0), fold_mult(g, node->child(1)));
+            accumulate(node->child(1), fold_mult(g, node->child(0)));
+            break;
+        case NodeKind::MatMul: {
+            Expr const& a = node->child(0);
+            Expr const& b = node->child(1);
+            if (a->shape().cols == b->shape().rows){
+                accumulate(a, matmul(g, transpose(b)));
+                accumulate(b, matmul(transpose(a), g));
+            } else {
+                accumulate(a, fold_mult(g, b));
+                accumulate(b, fold_mult(g, a));
+            }
+            break;
+        }
+        case NodeKind::Transpose:
+            accumulate(node->child(0), transpose(g));
+            break;
+        case NodeKind::Sum:
+            accumulate(node->child(0), expand(g, node->child(0)->shape()));
+            break;
+        case NodeKind::TensorPlaceholder:
+            if (static_cast<TensorPlaceholder*>(node)->name() == name){
+                result = fold_add(result, g);
+            }
+            break;
+        case NodeKind::Placeholder:
+        case NodeKind::Scalar:
+        case NodeKind::TensorConstant:
+            break;
+        default:
+            throw std::invalid_argument(std::string("cannot derivate node ") + to_string(node->kind()));
+        }
+    }
+    return expand(result, shape);
+}
+
+// The value bound to a tensor placeholder must have its shape
+static Tensor checked(Tensor value, Shape shape, const std::string& name){
+    if (value.shape() != shape){
+        throw std::invalid_argument(name + " is " + to_string(shape) + " but is bound to a " + to_string(value.shape()) + " value");
+    }
+    return value;
+}
+
+TensorPlaceholder::TensorPlaceholder(const std::string& name, Shape shape):
+    _name(name), _id(intern(name)), _shape(shape)
+{}
+
+double TensorPlaceholder::full_eval(const Context& c)               { return tensor_eval(c).scalar(); }
+double TensorPlaceholder::full_eval(const PersistentContext& c)     { return tensor_eval(c).scalar(); }
+Tensor TensorPlaceholder::tensor_eval(const Context& c)             { SYM_PROFILE_SCOPE(FullEval); return checked(c.at(_name)->tensor_eval(c), _shape, _name); }
+Tensor TensorPlaceholder::tensor_eval(const PersistentContext& c)   { SYM_PROFILE_SCOPE(FullEval); return checked(c.at(_id)->tensor_eval(c), _shape, _name); }
+Expr TensorPlaceholder::partial_eval(const Context& c)              {
+    SYM_PROFILE_SCOPE(PartialEval);
+    auto it = c.find(_name);
+    return it != c.end() ? it->second : Expr(this);
+}
+Expr TensorPlaceholder::partial_eval(const PersistentContext& c)    {
+    SYM_PROFILE_SCOPE(PartialEval);
+    Expr value = c.find(_id);
+    return value ? value : Expr(this);
+}
+std::ostream& TensorPlaceholder::gen(std::ostream& out)             { return out << _name; }
+Expr TensorPlaceholder::derivate(const std::string& n)              {
+    SYM_PROFILE_SCOPE(Derivate);
+    if (n != _name){
+        return Scalar::make(0);
+    }
+    if (!_shape.scalar()){
+        throw std::invalid_argument("derivative of " + _name + " with respect to itself, derivate a 1 x 1 expression of it instead");
+    }
+    return Scalar::make(1);
+}
+
+double TensorConstant::full_eval(const Context&)                { SYM_PROFILE_SCOPE(FullEval); return _value.scalar(); }
+double TensorConstant::full_eval(const PersistentContext&)      { SYM_PROFILE_SCOPE(FullEval); return _value.scalar(); }
+Tensor TensorConstant::tensor_eval(const Context&)              { SYM_PROFILE_SCOPE(FullEval); return _value; }
+Tensor TensorConstant::tensor_eval(const PersistentContext&)    { SYM_PROFILE_SCOPE(FullEval); return _value; }
+Expr TensorConstant::partial_eval(const Context&)               { SYM_PROFILE_SCOPE(PartialEval); return Expr(this); }
+Expr TensorConstant::partial_eval(const PersistentContext&)     { SYM_PROFILE_SCOPE(PartialEval); return Expr(this); }
+Expr TensorConstant::derivate(const std::string&)               { SYM_PROFILE_SCOPE(Derivate); return Scalar::make(0); }
+std::ostream& TensorConstant::gen(std::ostream& out)            {
+    out << "[";
+    for (std::size_t i = 0; i < _value.rows(); ++i){
+        out << (i > 0 ? ", [" : "[");
+        for (std::size_t j = 0; j < _value.cols(); ++j){
+            out << (j > 0 ? ", " : "") << _value(i, j);
+        }
+        out << "]";
+    }
+    return out << "]";
+}
+
+template<typename Ctx>
+static std::vector<Tensor> eval_args(std::vector<Expr> const& args, Ctx const& c){
+    std::vector<Tensor> values;
+    values.reserve(args.size());
+    for (auto& arg: args){
+        values.push_back(arg->tensor_eval(c));
+    }
+    return values;
+}
+
+template<typename Ctx>
+static std::vector<Expr> partial_args(std::vector<Expr> const& args, Ctx const& c){
+    std::vector<Expr> values;
+    values.reserve(args.size());
+    for (auto& arg: args){
+        values.push_back(arg->partial_eval(c));
+    }
+    return values;
+}
+
+Expr const& TensorExpr::child(std::size_t i) const              { return i < _args.size() ? _args[i] : ABSExpr::child(i); }
+double TensorExpr::full_eval(const Context& c)                  { return tensor_eval(c).scalar(); }
+double TensorExpr::full_eval(const PersistentContext& c)        { return tensor_eval(c).scalar(); }
+Tensor TensorExpr::tensor_eval(const Context& c)                { SYM_PROFILE_SCOPE(FullEval); auto args = eval_args(_args, c); return apply(args); }
+Tensor TensorExpr::tensor_eval(const PersistentContext& c)      { SYM_PROFILE_SCOPE(FullEval); auto args = eval_args(_args, c); return apply(args); }
+Expr TensorExpr::partial_eval(const Context& c)                 { SYM_PROFILE_SCOPE(PartialEval); return rebuild(partial_args(_args, c)); }
+Expr TensorExpr::partial_eval(const PersistentContext& c)       { SYM_PROFILE_SCOPE(PartialEval); return rebuild(partial_args(_args, c)); }
+
+std::ostream& TensorExpr::gen(std::ostream& out){
+    switch (kind()){
+    case NodeKind::TensorAdd:
+    case NodeKind::TensorMult:
+        out << "(";
+        _args[0]->gen(out) << (kind() == NodeKind::TensorAdd ? " + " : " * ");
+        _args[1]->gen(out) << ")";
+        return out;
+    case NodeKind::MatMul:      out << "matmul("; break;
+    case NodeKind::Transpose:   out << "transpose("; break;
+    case NodeKind::Sum:         out << "sum("; break;
+    default:                    out << to_string(kind()) << "("; break;
+    }
+
+    for (std::size_t i = 0; i < _args.size(); ++i){
+        if (i > 0) out << ", ";
+        _args[i]->gen(out);
+    }
+    return out << ")";
+}
+
+Expr TensorExpr::derivate(const std::string& name){
+    SYM_PROFILE_SCOPE(Derivate);
+    Expr self(this);
+
+    for (ABSExpr* node: topological_order(self)){
+        if (node->kind() == NodeKind::TensorPlaceholder && !node->shape().scalar() &&
+            static_cast<TensorPlaceholder*>(node)->name() == name)
+        {
+            if (!_shape.scalar()){
+                throw std::invalid_argument("derivative of a " + to_string(_shape) + " expression with respect to the tensor " + name);
+            }
+            return tensor_gradient(self, name, node->shape());
+        }
+    }
+    return forward(name);
+}
+
+TensorAdd::TensorAdd(Expr a, Expr b):   TensorExpr(broadcast(a->shape(), b->shape()), {a, b}) {}
+TensorMult::TensorMult(Expr a, Expr b): TensorExpr(broadcast(a->shape(), b->shape()), {a, b}) {}
+MatMul::MatMul(Expr a, Expr b):         TensorExpr(matmul(a->shape(), b->shape()), {a, b}) {}
+Transpose::Transpose(Expr a):           TensorExpr({a->shape().cols, a->shape().rows}, {a}) {}
+Sum::Sum(Expr a):                       TensorExpr({1, 1}, {a}) {}
+
+Tensor TensorAdd::apply(std::vector<Tensor>& args) const    { return elementwise_add(std::move(args[0]), std::move(args[1])); }
+Tensor TensorMult::apply(std::vector<Tensor>& args) const   { return elementwise_mult(std::move(args[0]), std::move(args[1])); }
+Tensor MatMul::apply(std::vector<Tensor>& args) const       { return matmul(args[0], args[1]); }
+Tensor Transpose::apply(std::vector<Tensor>& args) const    { return transpose(args[0]); }
+Tensor Sum::apply(std::vector<Tensor>& args) const          { return Tensor(sum(args[0])); }
+
+Expr TensorAdd::rebuild(std::vector<Expr> args) const       { return add(std::move(args[0]), std::move(args[1])); }
+Expr TensorMult::rebuild(std::vector<Expr> args) const      { return mult(std::move(args[0]), std::move(args[1])); }
+Expr MatMul::rebuild(std::vector<Expr> args) const          { return matmul(std::move(args[0]), std::move(args[1])); }
+Expr Transpose::rebuild(std::vector<Expr> args) const       { return transpose(std::move(args[0])); }
+Expr Sum::rebuild(std::vector<Expr> args) const             { return sum(std::move(args[0])); }
+
+Expr TensorAdd::forward(const std::string& n)   { return fold_add(_args[0]->derivate(n), _args[1]->derivate(n)); }
+Expr TensorMult::forward(const std::string& n)  { return fold_add(fold_mult(_args[0]->derivate(n), _args[1]), fold_mult(_args[0], _args[1]->derivate(n))); }
+Expr MatMul::forward(const std::string& n)      {
+    Expr da = _args[0]->derivate(n);
+    Expr db = _args[1]->derivate(n);
+    Expr a = is_constant(da, 0) ? da : matmul(expand(da, _args[0]->shape()), _args[1]);
+    Expr b = is_constant(db, 0) ? db : matmul(_args[0], expand(db, _args[1]->shape()));
+    return fold_add(a, b);
+}
+Expr Transpose::forward(const std::string& n)   { Expr d = _args[0]->derivate(n); return is_constant(d, 0) ? d : transpose(d); }
+Expr Sum::forward(const std::string& n)         { Expr d = _args[0]->derivate(n); return is_constant(d, 0) ? d : sum(expand(d, _args[0]->shape())); }
+
+std::vector<ABSExpr*> topological_order(Expr const& root){
+    return topological_order(std::vector<Expr>{root});
+}
+
+std::vector<ABSExpr*> topological_order(std::vector<Expr> const& roots){
+    std::vector<ABSExpr*> order;
+    std::unordered_set<ABSExpr*> seen;
+    std::vector<std::pair<ABSExpr*, bool>> stack;
+
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it){
+        stack.emplace_back(it->get(), false);
+    }
+
+    // Explicit stack, large models are deeper than the call stack allows
+    while (!stack.empty()){
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (expanded){
+            order.push_back(node);
+        } else if (seen.insert(node).second){
+            stack.emplace_back(node, true);
+            for (std::size_t i = node->arity(); i > 0; --i){
+                stack.emplace_back(node->child(i - 1).get(), false);
+            }
+        }
+    }
+    return order;
 }
 
 Expr make_var(const std::string& name)  {   return Placeholder::make(name);   }
 Expr make_val(double v)                 {   return Scalar::make(v);   }
-Expr mult(Expr l , Expr r)              {   return Mult::make(l, r);  }
-Expr add(Expr l , Expr r)               {   return Add::make(l, r);   }
+Expr mult(Expr l , Expr r)              {
+    if (l->shape().scalar() && r->shape().scalar()){
+        return Mult::make(std::move(l), std::move(r));
+    }
+    return TensorMult::make(std::move(l), std::move(r));
+}
+Expr add(Expr l , Expr r)               {
+    if (l->shape().scalar() && r->shape().scalar()){
+        return Add::make(std::move(l), std::move(r));
+    }
+    return TensorAdd::make(std::move(l), std::move(r));
+}
+
+Expr make_tensor_var(const std::string& name, std::size_t rows, std::size_t cols)   {   return TensorPlaceholder::make(name, {rows, cols});   }
+Expr make_tensor(Tensor value)          {   return TensorConstant::make(std::move(value));  }
+Expr matmul(Expr l, Expr r)             {   return MatMul::make(std::move(l), std::move(r));    }
+Expr transpose(Expr e)                  {   return Transpose::make(std::move(e));   }
+Expr sum(Expr e)                        {   return Sum::make(std::move(e));     }
 
 void print(Expr f) { f->gen(std::cout) << std::endl; }
 }
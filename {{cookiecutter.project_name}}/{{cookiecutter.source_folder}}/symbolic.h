@@ -5,23 +5,69 @@
 #include <ostream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "ref.h"
+#include "tensor.h"
 
 namespace sym
 {
 
 class ABSExpr;
-using Expr = std::shared_ptr<ABSExpr>;
+using Expr = Ref<ABSExpr>;
 using Context = std::unordered_map<std::string, Expr>;
+using SymbolId = std::uint32_t;
+
+class PersistentContext;
+
+// Concrete type of a node, used by passes that need to inspect the graph
+enum class NodeKind{
+    Placeholder,
+    Scalar,
+    Add,
+    Mult,
+    TensorPlaceholder,
+    TensorConstant,
+    TensorAdd,
+    TensorMult,
+    MatMul,
+    Transpose,
+    Sum
+};
 
-class ABSExpr
+const char* to_string(NodeKind kind);
+
+class ABSExpr: public RefCounted
 {
 public:
+    virtual NodeKind kind() const = 0;
+
+    // Sub expressions, used by passes that walk the graph
+    virtual std::size_t arity() const { return 0; }
+    virtual Expr const& child(std::size_t i) const;
+
+    // Shape of the value, scalar expressions are 1 x 1
+    virtual Shape shape() const { return {}; }
+
+    // Value as a tensor, scalar expressions return their full_eval as a 1 x 1 tensor
+    virtual Tensor tensor_eval(const Context&);
+    virtual Tensor tensor_eval(const PersistentContext&);
+
     virtual double full_eval(const Context&) = 0;
     virtual Expr partial_eval(const Context&) = 0;
+    virtual double full_eval(const PersistentContext&) = 0;
+    virtual Expr partial_eval(const PersistentContext&) = 0;
     virtual Expr derivate(const std::string&) = 0;
     virtual std::ostream& gen(std::ostream&) = 0;
 
     virtual ~ABSExpr(){}
+
+#if SYM_PROFILE
+    // Node allocations are reported to the active sym::Profiler
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr);
+#endif
 };
 
 
@@ -32,20 +78,26 @@ public:
 class Placeholder: public ABSExpr
 {
 public:
-    Placeholder(const std::string& name) noexcept:
-        _name(name)
-    {}
+    Placeholder(const std::string& name);
 
     double full_eval(const Context&) override;
     Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
     std::ostream& gen(std::ostream&) override;
     Expr derivate(const std::string&) override;
 
     static Expr make(const std::string& name){
-        return std::make_shared<Placeholder>(name);
+        return make_ref<Placeholder>(name);
     }
+
+    NodeKind kind() const override     { return NodeKind::Placeholder; }
+    const std::string& name() const    { return _name; }
+    SymbolId id() const                { return _id; }
+
 private:
     std::string _name;
+    SymbolId _id;
 };
 
 class Scalar: public ABSExpr
@@ -57,12 +109,18 @@ public:
 
     double full_eval(const Context&) override;
     Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
     std::ostream& gen(std::ostream&) override;
     Expr derivate(const std::string&) override;
 
     static Expr make(double v){
-        return std::make_shared<Scalar>(v);
+        return make_ref<Scalar>(v);
     }
+
+    NodeKind kind() const override     { return NodeKind::Scalar; }
+    double value() const               { return _value; }
+
 private:
     double _value;
 };
@@ -76,18 +134,27 @@ class Add: public ABSExpr
 {
 public:
     Add(Expr a, Expr b) noexcept:
-        _lhs(a), _rhs(b)
+        _lhs(std::move(a)), _rhs(std::move(b))
     {}
 
     double full_eval(const Context&) override;
     Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
     std::ostream& gen(std::ostream&) override;
     Expr derivate(const std::string&) override;
 
     static Expr make(Expr a, Expr b){
-        return std::make_shared<Add>(a, b);
+        return make_ref<Add>(std::move(a), std::move(b));
     }
 
+    NodeKind kind() const override     { return NodeKind::Add; }
+    Expr const& lhs() const            { return _lhs; }
+    Expr const& rhs() const            { return _rhs; }
+
+    std::size_t arity() const override { return 2; }
+    Expr const& child(std::size_t i) const override { return i == 0 ? _lhs : _rhs; }
+
 private:
     Expr _lhs;
     Expr _rhs;
@@ -97,28 +164,242 @@ class Mult: public ABSExpr
 {
 public:
     Mult( Expr a,  Expr b) noexcept:
-        _lhs(a), _rhs(b)
+        _lhs(std::move(a)), _rhs(std::move(b))
     {}
 
     double full_eval(const Context&) override;
     Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
     std::ostream& gen(std::ostream&) override;
     Expr derivate(const std::string&) override;
 
     static Expr make(Expr a, Expr b){
-        return std::make_shared<Mult>(a, b);
+        return make_ref<Mult>(std::move(a), std::move(b));
     }
 
+    NodeKind kind() const override     { return NodeKind::Mult; }
+    Expr const& lhs() const            { return _lhs; }
+    Expr const& rhs() const            { return _rhs; }
+
+    std::size_t arity() const override { return 2; }
+    Expr const& child(std::size_t i) const override { return i == 0 ? _lhs : _rhs; }
+
 private:
     Expr _lhs;
     Expr _rhs;
 };
 
 
+/*!
+ * \brief Matrix or vector placeholder, bound in the context to an expression
+ * of the same shape (usually a TensorConstant).
+ */
+class TensorPlaceholder: public ABSExpr
+{
+public:
+    TensorPlaceholder(const std::string& name, Shape shape);
+
+    double full_eval(const Context&) override;
+    Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
+    Tensor tensor_eval(const Context&) override;
+    Tensor tensor_eval(const PersistentContext&) override;
+    std::ostream& gen(std::ostream&) override;
+    Expr derivate(const std::string&) override;
+
+    static Expr make(const std::string& name, Shape shape){
+        return make_ref<TensorPlaceholder>(name, shape);
+    }
+
+    NodeKind kind() const override     { return NodeKind::TensorPlaceholder; }
+    Shape shape() const override       { return _shape; }
+    const std::string& name() const    { return _name; }
+    SymbolId id() const                { return _id; }
+
+private:
+    std::string _name;
+    SymbolId _id;
+    Shape _shape;
+};
+
+class TensorConstant: public ABSExpr
+{
+public:
+    TensorConstant(Tensor v) noexcept:
+        _value(std::move(v))
+    {}
+
+    double full_eval(const Context&) override;
+    Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
+    Tensor tensor_eval(const Context&) override;
+    Tensor tensor_eval(const PersistentContext&) override;
+    std::ostream& gen(std::ostream&) override;
+    Expr derivate(const std::string&) override;
+
+    static Expr make(Tensor v){
+        return make_ref<TensorConstant>(std::move(v));
+    }
+
+    NodeKind kind() const override     { return NodeKind::TensorConstant; }
+    Shape shape() const override       { return _value.shape(); }
+    Tensor const& value() const        { return _value; }
+
+private:
+    Tensor _value;
+};
+
+/*!
+ * \brief Base of the tensor operations.
+ *
+ * Values are computed a whole tensor at a time by the kernels of tensor.h, full_eval is
+ * only defined when the result is 1 x 1. Elementwise operations broadcast 1 x 1 operands.
+ *
+ * derivate with respect to a scalar (or 1 x 1) placeholder is elementwise, the result has
+ * the shape of the expression. derivate of a 1 x 1 expression with respect to a matrix or
+ * vector placeholder is its gradient, with the shape of the placeholder.
+ */
+class TensorExpr: public ABSExpr
+{
+public:
+    double full_eval(const Context&) override;
+    Expr partial_eval(const Context&) override;
+    double full_eval(const PersistentContext&) override;
+    Expr partial_eval(const PersistentContext&) override;
+    Tensor tensor_eval(const Context&) override;
+    Tensor tensor_eval(const PersistentContext&) override;
+    std::ostream& gen(std::ostream&) override;
+    Expr derivate(const std::string&) override;
+
+    Shape shape() const override       { return _shape; }
+
+    std::size_t arity() const override { return _args.size(); }
+    Expr const& child(std::size_t i) const override;
+
+protected:
+    TensorExpr(Shape shape, std::vector<Expr> args):
+        _shape(shape), _args(std::move(args))
+    {}
+
+    // Kernel applied to the values of the arguments, which can be reused as storage
+    virtual Tensor apply(std::vector<Tensor>& args) const = 0;
+
+    // Same operation on other arguments
+    virtual Expr rebuild(std::vector<Expr> args) const = 0;
+
+    // Elementwise derivative with respect to a scalar placeholder
+    virtual Expr forward(const std::string& name) = 0;
+
+    Shape _shape;
+    std::vector<Expr> _args;
+};
+
+class TensorAdd: public TensorExpr
+{
+public:
+    TensorAdd(Expr a, Expr b);
+
+    static Expr make(Expr a, Expr b){
+        return make_ref<TensorAdd>(std::move(a), std::move(b));
+    }
+
+    NodeKind kind() const override     { return NodeKind::TensorAdd; }
+
+protected:
+    Tensor apply(std::vector<Tensor>& args) const override;
+    Expr rebuild(std::vector<Expr> args) const override;
+    Expr forward(const std::string& name) override;
+};
+
+// Elementwise (Hadamard) product
+class TensorMult: public TensorExpr
+{
+public:
+    TensorMult(Expr a, Expr b);
+
+    static Expr make(Expr a, Expr b){
+        return make_ref<TensorMult>(std::move(a), std::move(b));
+    }
+
+    NodeKind kind() const override     { return NodeKind::TensorMult; }
+
+protected:
+    Tensor apply(std::vector<Tensor>& args) const override;
+    Expr rebuild(std::vector<Expr> args) const override;
+    Expr forward(const std::string& name) override;
+};
+
+class MatMul: public TensorExpr
+{
+public:
+    MatMul(Expr a, Expr b);
+
+    static Expr make(Expr a, Expr b){
+        return make_ref<MatMul>(std::move(a), std::move(b));
+    }
+
+    NodeKind kind() const override     { return NodeKind::MatMul; }
+
+protected:
+    Tensor apply(std::vector<Tensor>& args) const override;
+    Expr rebuild(std::vector<Expr> args) const override;
+    Expr forward(const std::string& name) override;
+};
+
+class Transpose: public TensorExpr
+{
+public:
+    Transpose(Expr a);
+
+    static Expr make(Expr a){
+        return make_ref<Transpose>(std::move(a));
+    }
+
+    NodeKind kind() const override     { return NodeKind::Transpose; }
+
+protected:
+    Tensor apply(std::vector<Tensor>& args) const override;
+    Expr rebuild(std::vector<Expr> args) const override;
+    Expr forward(const std::string& name) override;
+};
+
+// Sum of every element, the result is 1 x 1
+class Sum: public TensorExpr
+{
+public:
+    Sum(Expr a);
+
+    static Expr make(Expr a){
+        return make_ref<Sum>(std::move(a));
+    }
+
+    NodeKind kind() const override     { return NodeKind::Sum; }
+
+protected:
+    Tensor apply(std::vector<Tensor>& args) const override;
+    Expr rebuild(std::vector<Expr> args) const override;
+    Expr forward(const std::string& name) override;
+};
+
+
+// Unique nodes of the DAG, every node appears after its children
+std::vector<ABSExpr*> topological_order(Expr const& root);
+std::vector<ABSExpr*> topological_order(std::vector<Expr> const& roots);
+
 Expr make_var(const std::string& name);
 Expr make_val(double v);
 Expr mult(Expr l, Expr r);
 Expr add(Expr l, Expr r);
+
+// add and mult are elementwise when an operand is a tensor
+Expr make_tensor_var(const std::string& name, std::size_t rows, std::size_t cols = 1);
+Expr make_tensor(Tensor value);
+Expr matmul(Expr l, Expr r);
+Expr transpose(Expr e);
+Expr sum(Expr e);
 void print(Expr f);
 
 }
@@ -0,0 +1,196 @@
+#include "tensor.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace sym{
+
+std::string to_string(Shape shape){
+    return std::to_string(shape.rows) + "x" + std::to_string(shape.cols);
+}
+
+Shape broadcast(Shape a, Shape b){
+    if (a == b || b.scalar()){
+        return a;
+    }
+    if (a.scalar()){
+        return b;
+    }
+    throw std::invalid_argument("shapes " + to_string(a) + " and " + to_string(b) + " do not match");
+}
+
+Shape matmul(Shape a, Shape b){
+    if (a.cols == b.rows){
+        return {a.rows, b.cols};
+    }
+    if (a.scalar() || b.scalar()){
+        return a.scalar() ? b : a;
+    }
+    throw std::invalid_argument("cannot multiply " + to_string(a) + " by " + to_string(b));
+}
+
+Tensor::Tensor(std::size_t rows, std::size_t cols, double fill):
+    _shape{rows, cols}, _data(rows * cols, fill)
+{}
+
+Tensor::Tensor(std::size_t rows, std::size_t cols, std::vector<double> data):
+    _shape{rows, cols}, _data(std::move(data))
+{
+    if (_data.size() != rows * cols){
+        throw std::invalid_argument("tensor of shape " + to_string(_shape) + " needs " +
+                                    std::to_string(rows * cols) + " values");
+    }
+}
+
+double Tensor::scalar() const {
+    if (!_shape.scalar()){
+        throw std::invalid_argument("tensor of shape " + to_string(_shape) + " is not a scalar");
+    }
+    return _data[0];
+}
+
+// Elementwise
+// --------------------------------------------
+template<typename Op>
+static Tensor elementwise(Tensor a, Tensor b, Op op){
+    Shape shape = broadcast(a.shape(), b.shape());
+    if (a.shape() != shape){
+        std::swap(a, b);    // op is commutative
+    }
+
+    double* out = a.data();
+    const std::size_t n = a.size();
+
+    if (b.shape() == shape){
+        const double* in = b.data();
+        for (std::size_t i = 0; i < n; ++i){
+            out[i] = op(out[i], in[i]);
+        }
+    } else {
+        const double v = b.data()[0];
+        for (std::size_t i = 0; i < n; ++i){
+            out[i] = op(out[i], v);
+        }
+    }
+    return a;
+}
+
+Tensor elementwise_add(Tensor a, Tensor b){
+    return elementwise(std::move(a), std::move(b), [](double x, double y){ return x + y; });
+}
+
+Tensor elementwise_mult(Tensor a, Tensor b){
+    return elementwise(std::move(a), std::move(b), [](double x, double y){ return x * y; });
+}
+
+double sum(Tensor const& a){
+    // Independent accumulators so the loop vectorizes without reassociating
+    constexpr std::size_t lanes = 8;
+    double acc[lanes] = {0};
+
+    const double* in = a.data();
+    const std::size_t n = a.size();
+    std::size_t i = 0;
+
+    for (; i + lanes <= n; i += lanes){
+        for (std::size_t l = 0; l < lanes; ++l){
+            acc[l] += in[i + l];
+        }
+    }
+    for (; i < n; ++i){
+        acc[0] += in[i];
+    }
+
+    double total = 0;
+    for (double v: acc){
+        total += v;
+    }
+    return total;
+}
+
+Tensor transpose(Tensor const& a){
+    constexpr std::size_t tile = 32;
+    Tensor t(a.cols(), a.rows());
+
+    for (std::size_t ii = 0; ii < a.rows(); ii += tile){
+        for (std::size_t jj = 0; jj < a.cols(); jj += tile){
+            std::size_t ie = std::min(ii + tile, a.rows());
+            std::size_t je = std::min(jj + tile, a.cols());
+
+            for (std::size_t i = ii; i < ie; ++i){
+                for (std::size_t j = jj; j < je; ++j){
+                    t(j, i) = a(i, j);
+                }
+            }
+        }
+    }
+    return t;
+}
+
+// Matrix product
+// --------------------------------------------
+// Blocks of b (kc x nc) stay in L2 while mc rows of a stream through them,
+// the rows of c touched by the micro kernel stay in L1
+static constexpr std::size_t mc = 64;
+static constexpr std::size_t kc = 128;
+static constexpr std::size_t nc = 256;
+
+// c[0..r)[j0..j1) += a[0..r)[k0..k1) * b[k0..k1)[j0..j1) for r rows at once,
+// every row of b loaded is used r times
+template<std::size_t r>
+static void micro_kernel(const double* __restrict a, const double* __restrict b, double* __restrict c,
+                         std::size_t k, std::size_t n,
+                         std::size_t k0, std::size_t k1, std::size_t j0, std::size_t j1)
+{
+    for (std::size_t p = k0; p < k1; ++p){
+        double ap[r];
+        for (std::size_t i = 0; i < r; ++i){
+            ap[i] = a[i * k + p];
+        }
+
+        const double* bp = b + p * n;
+        for (std::size_t i = 0; i < r; ++i){
+            double* ci = c + i * n;
+            for (std::size_t j = j0; j < j1; ++j){
+                ci[j] += ap[i] * bp[j];
+            }
+        }
+    }
+}
+
+void gemm(const double* a, const double* b, double* c, std::size_t m, std::size_t k, std::size_t n){
+    for (std::size_t jj = 0; jj < n; jj += nc){
+        std::size_t je = std::min(jj + nc, n);
+
+        for (std::size_t kk = 0; kk < k; kk += kc){
+            std::size_t ke = std::min(kk + kc, k);
+
+            for (std::size_t ii = 0; ii < m; ii += mc){
+                std::size_t ie = std::min(ii + mc, m);
+                std::size_t i = ii;
+
+                for (; i + 4 <= ie; i += 4){
+                    micro_kernel<4>(a + i * k, b, c + i * n, k, n, kk, ke, jj, je);
+                }
+                for (; i < ie; ++i){
+                    micro_kernel<1>(a + i * k, b, c + i * n, k, n, kk, ke, jj, je);
+                }
+            }
+        }
+    }
+}
+
+Tensor matmul(Tensor const& a, Tensor const& b){
+    Shape shape = matmul(a.shape(), b.shape());
+
+    if (a.cols() != b.rows()){
+        // One of the operands is a 1 x 1 scale
+        return elementwise_mult(a, b);
+    }
+
+    Tensor c(shape.rows, shape.cols);
+    gemm(a.data(), b.data(), c.data(), a.rows(), a.cols(), b.cols());
+    return c;
+}
+}
@@ -0,0 +1,83 @@
+#ifndef PROJECT_TEST_SRC_TENSOR_HEADER
+#define PROJECT_TEST_SRC_TENSOR_HEADER
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sym
+{
+
+struct Shape{
+    std::size_t rows = 1;
+    std::size_t cols = 1;
+
+    std::size_t size() const    { return rows * cols; }
+    bool scalar() const         { return rows == 1 && cols == 1; }
+
+    bool operator==(Shape const& s) const { return rows == s.rows && cols == s.cols; }
+    bool operator!=(Shape const& s) const { return !(*this == s); }
+};
+
+std::string to_string(Shape shape);
+
+// Shape of an elementwise operation, 1 x 1 operands are broadcast.
+// Throws std::invalid_argument if the shapes do not match
+Shape broadcast(Shape a, Shape b);
+
+// Shape of a matrix product, a 1 x 1 operand scales the other one.
+// Throws std::invalid_argument if the inner dimensions do not match
+Shape matmul(Shape a, Shape b);
+
+/*!
+ * \brief Dense row major matrix, vectors are columns (n x 1) and scalars are 1 x 1.
+ */
+class Tensor
+{
+public:
+    Tensor() = default;
+    Tensor(std::size_t rows, std::size_t cols, double fill = 0);
+
+    // Throws std::invalid_argument if `data` does not hold rows x cols values
+    Tensor(std::size_t rows, std::size_t cols, std::vector<double> data);
+
+    explicit Tensor(double value):
+        Tensor(1, 1, value)
+    {}
+
+    Shape shape() const             { return _shape; }
+    std::size_t rows() const        { return _shape.rows; }
+    std::size_t cols() const        { return _shape.cols; }
+    std::size_t size() const        { return _data.size(); }
+
+    double* data()                  { return _data.data(); }
+    const double* data() const      { return _data.data(); }
+
+    double& operator()(std::size_t i, std::size_t j)        { return _data[i * _shape.cols + j]; }
+    double operator()(std::size_t i, std::size_t j) const   { return _data[i * _shape.cols + j]; }
+
+    // Value of a 1 x 1 tensor, throws std::invalid_argument otherwise
+    double scalar() const;
+
+private:
+    Shape _shape = {0, 0};
+    std::vector<double> _data;
+};
+
+// Kernels
+// --------------------------------------------
+// Elementwise operations reuse the storage of the larger operand
+Tensor elementwise_add(Tensor a, Tensor b);
+Tensor elementwise_mult(Tensor a, Tensor b);
+
+Tensor matmul(Tensor const& a, Tensor const& b);
+Tensor transpose(Tensor const& a);
+double sum(Tensor const& a);
+
+// c += a * b with a (m x k), b (k x n) and c (m x n) row major, c must not alias a or b.
+// Cache blocked, the inner loop runs over contiguous rows of b and c so it vectorizes
+void gemm(const double* a, const double* b, double* c, std::size_t m, std::size_t k, std::size_t n);
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "thread_pool.h"
+#include "crash_handler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace sym{
+
+ThreadPool::ThreadPool(std::size_t threads){
+    threads = std::max<std::size_t>(threads, 1);
+    for (std::size_t i = 0; i < threads; ++i){
+        _workers.emplace_back([this](){ run(); });
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+    _wake.notify_all();
+
+    for (auto& worker: _workers){
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _tasks.push_back(std::move(task));
+    }
+    _wake.notify_one();
+}
+
+void ThreadPool::run(){
+    // A stack overflow in a task is reported by the crash handler
+    enable_crash_stack();
+
+    for (;;){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _wake.wait(guard, [this](){ return _stop || !_tasks.empty(); });
+
+            if (_tasks.empty()){
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+// State shared between the caller and the helpers, helpers can outlive the call
+struct ParallelFor{
+    std::function<void(std::size_t, std::size_t)> const* fn;
+    std::size_t n;
+    std::size_t grain;
+    std::size_t chunks;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+
+    std::mutex lock;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    // Take chunks until none is left
+    void work(){
+        for (;;){
+            std::size_t chunk = next.fetch_add(1);
+            if (chunk >= chunks){
+                return;
+            }
+
+            std::size_t begin = chunk * grain;
+            std::size_t end = std::min(n, begin + grain);
+
+            try {
+                (*fn)(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (!error){
+                    error = std::current_exception();
+                }
+            }
+
+            if (done.fetch_add(1) + 1 == chunks){
+                std::lock_guard<std::mutex> guard(lock);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+void ThreadPool::parallel_for(std::size_t n, std::size_t grain, std::function<void(std::size_t, std::size_t)> const& fn){
+    if (n == 0){
+        return;
+    }
+
+    auto state = std::make_shared<ParallelFor>();
+    state->fn = &fn;
+    state->n = n;
+    state->grain = std::max<std::size_t>(grain, 1);
+    state->chunks = (n + state->grain - 1) / state->grain;
+
+    std::size_t helpers = std::min(size(), state->chunks - 1);
+    for (std::size_t i = 0; i < helpers; ++i){
+        submit([state](){ state->work(); });
+    }
+
+    state->work();
+
+    // Only wait for chunks that were taken, helpers that did not start yet will find nothing to do
+    std::unique_lock<std::mutex> guard(state->lock);
+    state->finished.wait(guard, [&](){ return state->done.load() == state->chunks; });
+
+    if (state->error){
+        std::rethrow_exception(state->error);
+    }
+}
+
+ThreadPool& ThreadPool::global(){
+    static ThreadPool pool;
+    return pool;
+}
+}
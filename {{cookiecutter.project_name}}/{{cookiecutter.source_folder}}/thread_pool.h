@@ -0,0 +1,53 @@
+#ifndef PROJECT_TEST_SRC_THREAD_POOL_HEADER
+#define PROJECT_TEST_SRC_THREAD_POOL_HEADER
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sym
+{
+
+/*!
+ * \brief Fixed size pool of worker threads.
+ *
+ * parallel_for can be called from a task running on the pool, the calling thread
+ * takes part in the work so nested loops cannot deadlock.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Run fn(begin, end) over [0, n) in chunks of `grain` items, blocks until done.
+    // The first exception thrown by `fn` is rethrown in the calling thread
+    void parallel_for(std::size_t n, std::size_t grain, std::function<void(std::size_t, std::size_t)> const& fn);
+
+    std::size_t size() const { return _workers.size(); }
+
+    // Pool shared by the library when the caller does not provide one
+    static ThreadPool& global();
+
+private:
+    void run();
+
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    bool _stop = false;
+};
+
+}
+
+#endif